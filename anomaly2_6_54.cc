@@ -28,6 +28,10 @@
 #include "ns3/rng-seed-manager.h"
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/ipv4-flow-classifier.h"
+#include "fingerprint-simulator-impl.h"
+#include "object-census.h"
+#include "shared-delivery-yans-wifi-phy.h"
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
 
 #include <iostream>
 #include <vector>
@@ -132,6 +136,19 @@ SimulationHelper::PopulateArpCache ()
 
 /* ===== main function ===== */
 
+// Fold every received packet and MAC drop into the determinism fingerprint
+void
+FingerprintSinkRx (Ptr<const Packet> packet, const Address &from)
+{
+  fingerprint::AddTraceValue ("sinkRx", packet->GetSize ());
+}
+
+void
+FingerprintMacTxDrop (Ptr<const Packet> packet)
+{
+  fingerprint::AddTraceValue ("macTxDrop", packet->GetSize ());
+}
+
 int main (int argc, char *argv[])
 {
   const uint32_t nSTA = 1;
@@ -149,6 +166,9 @@ int main (int argc, char *argv[])
   bool BK = true;
   double Mbps = 10;    //z takim datarate wysylam
   uint32_t seed = 1;
+  std::string censusFile = "";
+  double censusInterval = 1;
+  bool sharedDelivery = false;
 
 
 /* ===== Command Line parameters ===== */
@@ -168,7 +188,13 @@ int main (int argc, char *argv[])
   cmd.AddValue ("BK",         "run BK traffic?",                               BK);
   cmd.AddValue ("Mbps",       "traffic generated per queue [Mbps]",            Mbps);
   cmd.AddValue ("seed",       "Seed",                                          seed);
+  cmd.AddValue ("census",     "write a live object census to this file",        censusFile);
+  cmd.AddValue ("censusInterval", "time between census samples [s]",           censusInterval);
+  cmd.AddValue ("sharedDelivery", "deliver frames as one shared PPDU",         sharedDelivery);
+  // Determinism check: --SimulatorImplementationType=ns3::FingerprintSimulatorImpl
+  Config::SetDefault ("ns3::FingerprintSimulatorImpl::Scenario", StringValue ("anomaly2_6_54"));
   cmd.Parse (argc, argv);
+  fingerprint::SetCommandLine (argc, argv);
 
   Time simulationTime = Seconds (simTime);
   ns3::RngSeedManager::SetSeed (seed);
@@ -220,7 +246,7 @@ int main (int argc, char *argv[])
 
 /* ===== MAC and PHY configuration ===== */
 
-  YansWifiPhyHelper phy;
+  SharedDeliveryPhyHelper phy (sharedDelivery); //YansWifiPhyHelper unless sharedDelivery
   phy.SetChannel (channel.Create ());
 
   WifiHelper wifiAP;
@@ -496,7 +522,27 @@ int main (int argc, char *argv[])
   monitor->SetAttribute ("JitterBinWidth", DoubleValue (0.001));
   monitor->SetAttribute ("PacketSizeBinWidth", DoubleValue (20));
 
+  if (fingerprint::IsEnabled ())
+    {
+      Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback (&FingerprintSinkRx));
+      Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/MacTxDrop", MakeCallback (&FingerprintMacTxDrop));
+    }
+
+  ObjectCensus census;
+  if (!censusFile.empty ())
+    {
+      census.Start (censusFile, Seconds (censusInterval));
+    }
+
   Simulator::Run ();
+  if (!censusFile.empty ())
+    {
+      census.Finish ();
+    }
+  if (sharedDelivery)
+    {
+      shareddelivery::PrintStatistics (std::cout);
+    }
   Simulator::Destroy ();
 
 
@@ -632,6 +678,9 @@ int main (int argc, char *argv[])
        std::cout << "  Mean jitter:\t---"   << std::endl;
      }
 
-
+  if (fingerprint::Failed ())
+    {
+      return 1;
+    }
   return 0;
 }
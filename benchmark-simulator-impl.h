@@ -0,0 +1,156 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BENCHMARK_SIMULATOR_IMPL_H
+#define BENCHMARK_SIMULATOR_IMPL_H
+
+// Default simulator that reports the run-time figures of a scenario, for
+// the cross-scenario benchmark suite (perf-bench --bench=suite).
+//
+// Usage:
+//   --SimulatorImplementationType=ns3::BenchmarkSimulatorImpl
+//   --ns3::BenchmarkSimulatorImpl::Scenario=ms-lab4
+//   --ns3::BenchmarkSimulatorImpl::ReportFile=report.txt
+//
+// Every Simulator::Run appends one line of "key=value" fields to the
+// report file (std::clog if it is empty):
+//
+//   setup      wall time [s] from the program start, or from the end of
+//              the previous Run, to the start of this Run
+//   run        wall time [s] of Simulator::Run
+//   events     events executed
+//   simulated  simulated time [s] reached
+//   peakRss    peak resident set size [kB] of the process so far
+//
+// Events are not wrapped, so the figures are those of the default
+// simulator.
+
+#include "ns3/default-simulator-impl.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/abort.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace ns3 {
+
+namespace benchmark {
+
+/// Time at which the program was loaded (static initialization)
+const std::chrono::steady_clock::time_point LOAD_TIME = std::chrono::steady_clock::now ();
+
+/// \returns the time at which the setup of the next Run started
+inline std::chrono::steady_clock::time_point &
+GetSetupStart (void)
+{
+  static std::chrono::steady_clock::time_point start = LOAD_TIME;
+  return start;
+}
+
+/// \returns the peak resident set size of the process, in kB
+inline uint64_t
+GetPeakRssKb (void)
+{
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+  return usage.ru_maxrss;
+}
+
+} // namespace benchmark
+
+class BenchmarkSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BenchmarkSimulatorImpl ();
+  virtual ~BenchmarkSimulatorImpl ();
+
+  // Inherited from SimulatorImpl
+  virtual void Run (void);
+
+private:
+  std::string m_scenario;
+  std::string m_reportFile;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (BenchmarkSimulatorImpl);
+
+inline TypeId
+BenchmarkSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BenchmarkSimulatorImpl")
+    .SetParent<DefaultSimulatorImpl> ()
+    .AddConstructor<BenchmarkSimulatorImpl> ()
+    .AddAttribute ("Scenario",
+                   "Scenario name written in the report.",
+                   StringValue ("scenario"),
+                   MakeStringAccessor (&BenchmarkSimulatorImpl::m_scenario),
+                   MakeStringChecker ())
+    .AddAttribute ("ReportFile",
+                   "File the report lines are appended to; empty for std::clog.",
+                   StringValue (""),
+                   MakeStringAccessor (&BenchmarkSimulatorImpl::m_reportFile),
+                   MakeStringChecker ())
+  ;
+  return tid;
+}
+
+inline
+BenchmarkSimulatorImpl::BenchmarkSimulatorImpl ()
+{
+}
+
+inline
+BenchmarkSimulatorImpl::~BenchmarkSimulatorImpl ()
+{
+}
+
+inline void
+BenchmarkSimulatorImpl::Run (void)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  uint64_t events = GetEventCount ();
+  DefaultSimulatorImpl::Run ();
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now ();
+
+  std::chrono::duration<double> setup = start - benchmark::GetSetupStart ();
+  std::chrono::duration<double> run = end - start;
+  benchmark::GetSetupStart () = end;
+
+  std::ofstream file;
+  if (!m_reportFile.empty ())
+    {
+      file.open (m_reportFile.c_str (), std::ofstream::out | std::ofstream::app);
+      NS_ABORT_MSG_UNLESS (file.is_open (), "Cannot open " << m_reportFile);
+    }
+  std::ostream &os = m_reportFile.empty () ? std::clog : file;
+  os << "scenario=" << m_scenario << " setup=" << setup.count () << " run=" << run.count ()
+     << " events=" << GetEventCount () - events << " simulated=" << Now ().GetSeconds ()
+     << " peakRss=" << benchmark::GetPeakRssKb () << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* BENCHMARK_SIMULATOR_IMPL_H */
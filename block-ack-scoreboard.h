@@ -0,0 +1,438 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BLOCK_ACK_SCOREBOARD_H
+#define BLOCK_ACK_SCOREBOARD_H
+
+// Block Ack scoreboards on fixed-size bitsets.
+//
+// The Block Ack window of the Wi-Fi MAC is a circular vector<bool>: moving
+// the window start clears it one bit at a time, and a Block Ack is applied
+// by testing its bitmap bit by bit, so the cost of each Block Ack grows with
+// the number of MPDUs of the A-MPDU (up to 256 with 802.11ax, as with the
+// 1 MB A-MPDUs of ms-lab7-maxthr, and 1024 with 802.11be windows).
+//
+// Here the window is a ScoreboardBitmap of up to 1024 bits, bit 0 being
+// the window start.  The window moves by shifting the words, a Block Ack
+// bitmap is merged with word-wide ORs, the new window start is found with
+// a count of trailing ones, and the MPDUs to retransmit are enumerated
+// with a count of trailing zeros per set bit.  Every operation works on at
+// most 16 words, whatever the size of the A-MPDU.
+//
+//   OriginatorScoreboard  the MPDUs sent and acknowledged; the window
+//                         starts at the oldest MPDU not acknowledged,
+//   RecipientScoreboard   the MPDUs received; the window starts at the
+//                         oldest MPDU not received, and moves forward when
+//                         an MPDU beyond its end is received.
+//
+// Sequence numbers are modulo 4096; a sequence number less than 2048 ahead
+// of the window start is ahead of it, otherwise it is behind.
+//
+// "perf-bench --bench=blockack" compares them with bit by bit windows.
+
+#include "ns3/assert.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+namespace blockackscoreboard {
+
+const uint16_t SEQNO_SPACE = 4096;
+const uint16_t HALF_SEQNO_SPACE = 2048;
+const uint32_t MAX_WINDOW = 1024;
+const uint32_t WORDS = MAX_WINDOW / 64;
+
+/// \returns how far seq is ahead of start, modulo 4096
+inline uint16_t
+GetDistance (uint16_t seq, uint16_t start)
+{
+  return (seq - start + SEQNO_SPACE) % SEQNO_SPACE;
+}
+
+} // namespace blockackscoreboard
+
+/**
+ * Bitset of blockackscoreboard::MAX_WINDOW bits
+ */
+class ScoreboardBitmap
+{
+public:
+  ScoreboardBitmap ();
+
+  void Reset (void);
+  void Set (uint32_t bit);
+  bool Get (uint32_t bit) const;
+  /// Drop the n lowest bits, shifting the others down
+  void ShiftDown (uint32_t n);
+  /// OR bits [0, nBits) of src into this bitset, from bit offset on
+  void OrShiftedUp (const uint64_t *src, uint32_t nBits, uint32_t offset);
+  /// OR bits [drop, nBits) of src into this bitset, from bit 0 on
+  void OrShiftedDown (const uint64_t *src, uint32_t nBits, uint32_t drop);
+  /// \returns the number of consecutive set bits from bit 0, at most limit
+  uint32_t CountLeadingSet (uint32_t limit) const;
+  /// Copy bits [0, nBits) to dst, whose remaining bits are cleared
+  void CopyTo (uint64_t *dst, uint32_t nBits) const;
+  /// \returns the bits of this bitset and not of other, word by word
+  uint64_t GetWordAndNot (const ScoreboardBitmap &other, uint32_t word) const;
+
+private:
+  uint64_t m_words[blockackscoreboard::WORDS];
+};
+
+inline
+ScoreboardBitmap::ScoreboardBitmap ()
+{
+  Reset ();
+}
+
+inline void
+ScoreboardBitmap::Reset (void)
+{
+  for (uint32_t i = 0; i < blockackscoreboard::WORDS; i++)
+    {
+      m_words[i] = 0;
+    }
+}
+
+inline void
+ScoreboardBitmap::Set (uint32_t bit)
+{
+  NS_ASSERT (bit < blockackscoreboard::MAX_WINDOW);
+  m_words[bit / 64] |= uint64_t (1) << (bit % 64);
+}
+
+inline bool
+ScoreboardBitmap::Get (uint32_t bit) const
+{
+  NS_ASSERT (bit < blockackscoreboard::MAX_WINDOW);
+  return (m_words[bit / 64] >> (bit % 64)) & 1;
+}
+
+inline void
+ScoreboardBitmap::ShiftDown (uint32_t n)
+{
+  const uint32_t words = n / 64;
+  const uint32_t bits = n % 64;
+  for (uint32_t i = 0; i < blockackscoreboard::WORDS; i++)
+    {
+      uint64_t low = i + words < blockackscoreboard::WORDS ? m_words[i + words] : 0;
+      uint64_t high = i + words + 1 < blockackscoreboard::WORDS ? m_words[i + words + 1] : 0;
+      m_words[i] = bits == 0 ? low : (low >> bits) | (high << (64 - bits));
+    }
+}
+
+inline void
+ScoreboardBitmap::OrShiftedUp (const uint64_t *src, uint32_t nBits, uint32_t offset)
+{
+  const uint32_t words = offset / 64;
+  const uint32_t bits = offset % 64;
+  const uint32_t srcWords = (nBits + 63) / 64;
+  for (uint32_t i = 0; i < srcWords && i + words < blockackscoreboard::WORDS; i++)
+    {
+      uint64_t word = src[i];
+      if ((i + 1) * 64 > nBits)
+        {
+          word &= (uint64_t (1) << (nBits % 64)) - 1;
+        }
+      m_words[i + words] |= word << bits;
+      if (bits != 0 && i + words + 1 < blockackscoreboard::WORDS)
+        {
+          m_words[i + words + 1] |= word >> (64 - bits);
+        }
+    }
+}
+
+inline void
+ScoreboardBitmap::OrShiftedDown (const uint64_t *src, uint32_t nBits, uint32_t drop)
+{
+  if (drop >= nBits)
+    {
+      return;
+    }
+  const uint32_t words = drop / 64;
+  const uint32_t bits = drop % 64;
+  const uint32_t srcWords = (nBits + 63) / 64;
+  for (uint32_t i = 0; i + words < srcWords && i < blockackscoreboard::WORDS; i++)
+    {
+      uint64_t low = src[i + words];
+      uint64_t high = i + words + 1 < srcWords ? src[i + words + 1] : 0;
+      uint64_t word = bits == 0 ? low : (low >> bits) | (high << (64 - bits));
+      // Bits at or beyond nBits - drop come from beyond the bitmap
+      uint32_t valid = nBits - drop;
+      if ((i + 1) * 64 > valid)
+        {
+          word &= (uint64_t (1) << (valid % 64)) - 1;
+        }
+      m_words[i] |= word;
+    }
+}
+
+inline uint32_t
+ScoreboardBitmap::CountLeadingSet (uint32_t limit) const
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < blockackscoreboard::WORDS && count < limit; i++)
+    {
+      if (m_words[i] == ~uint64_t (0))
+        {
+          count += 64;
+          continue;
+        }
+      count += __builtin_ctzll (~m_words[i]);
+      break;
+    }
+  return count < limit ? count : limit;
+}
+
+inline void
+ScoreboardBitmap::CopyTo (uint64_t *dst, uint32_t nBits) const
+{
+  const uint32_t dstWords = (nBits + 63) / 64;
+  for (uint32_t i = 0; i < dstWords; i++)
+    {
+      dst[i] = m_words[i];
+    }
+  if (nBits % 64 != 0)
+    {
+      dst[dstWords - 1] &= (uint64_t (1) << (nBits % 64)) - 1;
+    }
+}
+
+inline uint64_t
+ScoreboardBitmap::GetWordAndNot (const ScoreboardBitmap &other, uint32_t word) const
+{
+  return m_words[word] & ~other.m_words[word];
+}
+
+/**
+ * Originator side of a Block Ack agreement
+ */
+class OriginatorScoreboard
+{
+public:
+  /**
+   * \param winSize the window size, at most blockackscoreboard::MAX_WINDOW
+   * \param winStart the starting sequence number
+   */
+  OriginatorScoreboard (uint16_t winSize, uint16_t winStart);
+
+  uint16_t GetWinStart (void) const;
+  uint16_t GetWinSize (void) const;
+  /// \returns true if seq can be sent without moving the window
+  bool IsInWindow (uint16_t seq) const;
+
+  /// Record that the MPDU seq, in the window, was sent
+  void NotifySent (uint16_t seq);
+  /**
+   * Apply a Block Ack, and move the window start to the oldest MPDU not
+   * acknowledged.  The MPDUs before startingSeq count as acknowledged, as
+   * the recipient no longer waits for them.
+   *
+   * \param startingSeq the starting sequence number of the Block Ack
+   * \param bitmap the Block Ack bitmap, bit i for startingSeq + i
+   * \param nBits the bitmap size
+   */
+  void NotifyBlockAck (uint16_t startingSeq, const uint64_t *bitmap, uint32_t nBits);
+  /// Replace seqs with the MPDUs sent and not acknowledged, oldest first
+  void GetRetransmissions (std::vector<uint16_t> &seqs) const;
+
+private:
+  void Advance (uint32_t n);
+
+  uint16_t m_winSize;
+  uint16_t m_winStart;
+  ScoreboardBitmap m_sent;
+  ScoreboardBitmap m_acked;
+};
+
+inline
+OriginatorScoreboard::OriginatorScoreboard (uint16_t winSize, uint16_t winStart)
+  : m_winSize (winSize),
+    m_winStart (winStart % blockackscoreboard::SEQNO_SPACE)
+{
+  NS_ASSERT (winSize > 0 && winSize <= blockackscoreboard::MAX_WINDOW);
+}
+
+inline uint16_t
+OriginatorScoreboard::GetWinStart (void) const
+{
+  return m_winStart;
+}
+
+inline uint16_t
+OriginatorScoreboard::GetWinSize (void) const
+{
+  return m_winSize;
+}
+
+inline bool
+OriginatorScoreboard::IsInWindow (uint16_t seq) const
+{
+  return blockackscoreboard::GetDistance (seq, m_winStart) < m_winSize;
+}
+
+inline void
+OriginatorScoreboard::NotifySent (uint16_t seq)
+{
+  NS_ASSERT (IsInWindow (seq));
+  m_sent.Set (blockackscoreboard::GetDistance (seq, m_winStart));
+}
+
+inline void
+OriginatorScoreboard::Advance (uint32_t n)
+{
+  m_sent.ShiftDown (n);
+  m_acked.ShiftDown (n);
+  m_winStart = (m_winStart + n) % blockackscoreboard::SEQNO_SPACE;
+}
+
+inline void
+OriginatorScoreboard::NotifyBlockAck (uint16_t startingSeq, const uint64_t *bitmap, uint32_t nBits)
+{
+  uint16_t ahead = blockackscoreboard::GetDistance (startingSeq, m_winStart);
+  if (ahead < blockackscoreboard::HALF_SEQNO_SPACE)
+    {
+      // The recipient no longer waits for the MPDUs before startingSeq
+      Advance (ahead < m_winSize ? ahead : m_winSize);
+      if (ahead > m_winSize)
+        {
+          m_winStart = startingSeq;
+        }
+      m_acked.OrShiftedUp (bitmap, nBits < m_winSize ? nBits : m_winSize, 0);
+    }
+  else
+    {
+      uint32_t behind = blockackscoreboard::SEQNO_SPACE - ahead;
+      m_acked.OrShiftedDown (bitmap, nBits < behind + m_winSize ? nBits : behind + m_winSize, behind);
+    }
+  Advance (m_acked.CountLeadingSet (m_winSize));
+}
+
+inline void
+OriginatorScoreboard::GetRetransmissions (std::vector<uint16_t> &seqs) const
+{
+  seqs.clear ();
+  for (uint32_t w = 0; w * 64 < m_winSize; w++)
+    {
+      uint64_t pending = m_sent.GetWordAndNot (m_acked, w);
+      while (pending != 0)
+        {
+          uint32_t bit = w * 64 + __builtin_ctzll (pending);
+          seqs.push_back ((m_winStart + bit) % blockackscoreboard::SEQNO_SPACE);
+          pending &= pending - 1;
+        }
+    }
+}
+
+/**
+ * Recipient side of a Block Ack agreement
+ */
+class RecipientScoreboard
+{
+public:
+  RecipientScoreboard (uint16_t winSize, uint16_t winStart);
+
+  uint16_t GetWinStart (void) const;
+  /// Record the reception of the MPDU seq, moving the window if needed
+  void NotifyReceived (uint16_t seq);
+  /// Move the window start to startingSeq, if it is ahead (Block Ack Request)
+  void NotifyBlockAckRequest (uint16_t startingSeq);
+  /**
+   * Fill the bitmap of a Block Ack, whose starting sequence number is
+   * GetWinStart ()
+   *
+   * \param bitmap (nBits + 63) / 64 words
+   * \param nBits the bitmap size
+   */
+  void FillBitmap (uint64_t *bitmap, uint32_t nBits) const;
+
+private:
+  void Advance (uint32_t n);
+
+  uint16_t m_winSize;
+  uint16_t m_winStart;
+  ScoreboardBitmap m_received;
+};
+
+inline
+RecipientScoreboard::RecipientScoreboard (uint16_t winSize, uint16_t winStart)
+  : m_winSize (winSize),
+    m_winStart (winStart % blockackscoreboard::SEQNO_SPACE)
+{
+  NS_ASSERT (winSize > 0 && winSize <= blockackscoreboard::MAX_WINDOW);
+}
+
+inline uint16_t
+RecipientScoreboard::GetWinStart (void) const
+{
+  return m_winStart;
+}
+
+inline void
+RecipientScoreboard::Advance (uint32_t n)
+{
+  if (n >= m_winSize)
+    {
+      m_received.Reset ();
+    }
+  else
+    {
+      m_received.ShiftDown (n);
+    }
+  m_winStart = (m_winStart + n) % blockackscoreboard::SEQNO_SPACE;
+}
+
+inline void
+RecipientScoreboard::NotifyReceived (uint16_t seq)
+{
+  uint16_t ahead = blockackscoreboard::GetDistance (seq, m_winStart);
+  if (ahead >= blockackscoreboard::HALF_SEQNO_SPACE)
+    {
+      return;                       // old MPDU
+    }
+  if (ahead >= m_winSize)
+    {
+      // Make seq the end of the window
+      Advance (ahead - m_winSize + 1);
+      ahead = m_winSize - 1;
+    }
+  m_received.Set (ahead);
+  Advance (m_received.CountLeadingSet (m_winSize));
+}
+
+inline void
+RecipientScoreboard::NotifyBlockAckRequest (uint16_t startingSeq)
+{
+  uint16_t ahead = blockackscoreboard::GetDistance (startingSeq, m_winStart);
+  if (ahead < blockackscoreboard::HALF_SEQNO_SPACE)
+    {
+      Advance (ahead);
+      Advance (m_received.CountLeadingSet (m_winSize));
+    }
+}
+
+inline void
+RecipientScoreboard::FillBitmap (uint64_t *bitmap, uint32_t nBits) const
+{
+  NS_ASSERT (nBits <= blockackscoreboard::MAX_WINDOW);
+  m_received.CopyTo (bitmap, nBits);
+}
+
+} // namespace ns3
+
+#endif /* BLOCK_ACK_SCOREBOARD_H */
@@ -0,0 +1,383 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FINGERPRINT_SIMULATOR_IMPL_H
+#define FINGERPRINT_SIMULATOR_IMPL_H
+
+// Determinism fingerprint: checks that an optimization leaves the executed
+// event sequence and the traced values of a scenario unchanged.
+//
+// Usage:
+//   --SimulatorImplementationType=ns3::FingerprintSimulatorImpl
+//   --ns3::FingerprintSimulatorImpl::GoldenFile=fingerprints.golden
+//   --ns3::FingerprintSimulatorImpl::UpdateGolden=1    (store the values)
+//
+// Every executed event is folded into a rolling FNV-1a hash of its
+// identity: its timestamp, its node context, and its rank among the
+// events scheduled into that context, in scheduling order.  The identity
+// does not depend on the build, so fingerprints can be compared across
+// compilers.  Scenarios add the values of their key traces with
+// fingerprint::AddTraceValue, each trace into its own hash.  When
+// Simulator::Run returns, the hashes are printed to std::clog and their
+// combination is compared with the golden value stored for the scenario,
+// the seed, the run number and the command-line arguments that scenarios
+// pass to fingerprint::SetCommandLine, so that every configuration has
+// its own golden value.  fingerprint::Failed () tells whether it
+// differed, so that scenarios can return a non-zero exit status.
+
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/simulator.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/hash.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+namespace fingerprint {
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/// Fold the 8 bytes of value into the FNV-1a hash h
+inline uint64_t
+Mix (uint64_t h, uint64_t value)
+{
+  for (int i = 0; i < 8; i++)
+    {
+      h ^= (value >> (8 * i)) & 0xff;
+      h *= FNV_PRIME;
+    }
+  return h;
+}
+
+struct TraceHash
+{
+  uint64_t hash = FNV_OFFSET;
+  uint64_t count = 0;
+};
+
+struct State
+{
+  bool enabled = false;
+  bool failed = false;
+  std::map<std::string, TraceHash> traces;
+  std::string commandLine;          //!< part of the golden key
+};
+
+inline State &
+GetState (void)
+{
+  static State state;
+  return state;
+}
+
+/// \returns true when the FingerprintSimulatorImpl is in use
+inline bool
+IsEnabled (void)
+{
+  // The implementation is only created by the first Simulator call
+  Simulator::GetImplementation ();
+  return GetState ().enabled;
+}
+
+/// \returns true if the last fingerprint differed from its golden value
+inline bool
+Failed (void)
+{
+  return GetState ().failed;
+}
+
+/**
+ * Make the command-line arguments part of the golden key, except those
+ * selecting the fingerprint and the seed and run number, which are
+ * already in it.  To be called by scenarios from main ().
+ */
+inline void
+SetCommandLine (int argc, char *argv[])
+{
+  const char *skipped[] = { "--SimulatorImplementationType=", "--ns3::FingerprintSimulatorImpl::",
+                            "--RngSeed=", "--RngRun=" };
+  std::vector<std::string> arguments;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string argument = argv[i];
+      bool skip = false;
+      for (const char *prefix : skipped)
+        {
+          skip = skip || argument.compare (0, std::strlen (prefix), prefix) == 0;
+        }
+      if (!skip)
+        {
+          // The golden file is read word by word
+          std::replace (argument.begin (), argument.end (), ' ', '_');
+          arguments.push_back (argument);
+        }
+    }
+  std::sort (arguments.begin (), arguments.end ());
+  std::string &commandLine = GetState ().commandLine;
+  commandLine.clear ();
+  for (const std::string &argument : arguments)
+    {
+      commandLine += "/" + argument;
+    }
+}
+
+/// Fold the current time and value into the hash of trace
+template <typename T>
+void
+AddTraceValue (const std::string &trace, T value)
+{
+  uint64_t bits = 0;
+  if (std::is_floating_point<T>::value)
+    {
+      double d = static_cast<double> (value);
+      std::memcpy (&bits, &d, sizeof (bits));
+    }
+  else
+    {
+      bits = static_cast<uint64_t> (value);
+    }
+  TraceHash &t = GetState ().traces[trace];
+  t.hash = Mix (Mix (t.hash, Simulator::Now ().GetTimeStep ()), bits);
+  t.count++;
+}
+
+} // namespace fingerprint
+
+class FingerprintSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  FingerprintSimulatorImpl ();
+  virtual ~FingerprintSimulatorImpl ();
+
+  // Inherited from SimulatorImpl
+  virtual void Run (void);
+  virtual EventId Schedule (const Time &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+
+private:
+  /// Runs the wrapped event and folds it into the fingerprint
+  class FingerprintedEvent : public EventImpl
+  {
+  public:
+    FingerprintedEvent (FingerprintSimulatorImpl *impl, EventImpl *event, uint64_t rank)
+      : m_impl (impl),
+        m_event (event, false),
+        m_rank (rank)
+    {
+    }
+
+  private:
+    virtual void Notify (void)
+    {
+      m_impl->Record (m_rank);
+      m_event->Invoke ();
+    }
+
+    FingerprintSimulatorImpl *m_impl;
+    Ptr<EventImpl> m_event;
+    uint64_t m_rank;                //!< rank among the events of its context
+  };
+
+  /// Wrap an event scheduled into context
+  EventImpl *Wrap (uint32_t context, EventImpl *event);
+  void Record (uint64_t rank);
+  std::string GetKey (void) const;
+  void Check (const std::string &key, uint64_t value);
+
+  std::string m_scenario;
+  std::string m_goldenFile;
+  bool m_updateGolden;
+
+  uint64_t m_hash;
+  uint64_t m_events;
+  std::unordered_map<uint32_t, uint64_t> m_scheduled;   //!< events scheduled, by context
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FingerprintSimulatorImpl);
+
+inline TypeId
+FingerprintSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FingerprintSimulatorImpl")
+    .SetParent<DefaultSimulatorImpl> ()
+    .AddConstructor<FingerprintSimulatorImpl> ()
+    .AddAttribute ("Scenario",
+                   "Scenario name, part of the golden file key with the seed, run number and command line.",
+                   StringValue ("scenario"),
+                   MakeStringAccessor (&FingerprintSimulatorImpl::m_scenario),
+                   MakeStringChecker ())
+    .AddAttribute ("GoldenFile",
+                   "File holding the golden fingerprints; empty to only print them.",
+                   StringValue ("fingerprints.golden"),
+                   MakeStringAccessor (&FingerprintSimulatorImpl::m_goldenFile),
+                   MakeStringChecker ())
+    .AddAttribute ("UpdateGolden",
+                   "Store the fingerprint in the golden file instead of checking it.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&FingerprintSimulatorImpl::m_updateGolden),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+inline
+FingerprintSimulatorImpl::FingerprintSimulatorImpl ()
+  : m_updateGolden (false),
+    m_hash (fingerprint::FNV_OFFSET),
+    m_events (0)
+{
+  fingerprint::GetState ().enabled = true;
+}
+
+inline
+FingerprintSimulatorImpl::~FingerprintSimulatorImpl ()
+{
+  fingerprint::GetState ().enabled = false;
+}
+
+inline EventImpl *
+FingerprintSimulatorImpl::Wrap (uint32_t context, EventImpl *event)
+{
+  return new FingerprintedEvent (this, event, m_scheduled[context]++);
+}
+
+inline EventId
+FingerprintSimulatorImpl::Schedule (const Time &delay, EventImpl *event)
+{
+  return DefaultSimulatorImpl::Schedule (delay, Wrap (GetContext (), event));
+}
+
+inline void
+FingerprintSimulatorImpl::ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event)
+{
+  DefaultSimulatorImpl::ScheduleWithContext (context, delay, Wrap (context, event));
+}
+
+inline EventId
+FingerprintSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  return DefaultSimulatorImpl::ScheduleNow (Wrap (GetContext (), event));
+}
+
+inline void
+FingerprintSimulatorImpl::Record (uint64_t rank)
+{
+  m_hash = fingerprint::Mix (m_hash, Now ().GetTimeStep ());
+  m_hash = fingerprint::Mix (m_hash, GetContext ());
+  m_hash = fingerprint::Mix (m_hash, rank);
+  m_events++;
+}
+
+inline std::string
+FingerprintSimulatorImpl::GetKey (void) const
+{
+  std::ostringstream oss;
+  oss << m_scenario << "/seed=" << RngSeedManager::GetSeed () << "/run=" << RngSeedManager::GetRun ()
+      << fingerprint::GetState ().commandLine;
+  return oss.str ();
+}
+
+inline void
+FingerprintSimulatorImpl::Run (void)
+{
+  DefaultSimulatorImpl::Run ();
+
+  uint64_t combined = fingerprint::Mix (fingerprint::FNV_OFFSET, m_hash);
+  std::ostringstream details;
+  details << std::hex << std::setfill ('0');
+  details << "  events: " << std::dec << m_events << " 0x" << std::hex << std::setw (16) << m_hash << std::endl;
+  for (const auto &trace : fingerprint::GetState ().traces)
+    {
+      combined = fingerprint::Mix (fingerprint::Mix (combined, Hash64 (trace.first)), trace.second.hash);
+      details << "  " << trace.first << ": " << std::dec << trace.second.count
+              << " 0x" << std::hex << std::setw (16) << trace.second.hash << std::endl;
+    }
+
+  std::string key = GetKey ();
+  std::clog << "Fingerprint " << key << ": 0x" << std::hex << std::setfill ('0') << std::setw (16)
+            << combined << std::dec << std::setfill (' ') << std::endl << details.str ();
+  if (!m_goldenFile.empty ())
+    {
+      Check (key, combined);
+    }
+}
+
+inline void
+FingerprintSimulatorImpl::Check (const std::string &key, uint64_t value)
+{
+  std::map<std::string, uint64_t> golden;
+  std::ifstream in (m_goldenFile.c_str ());
+  std::string k;
+  std::string v;
+  while (in >> k >> v)
+    {
+      golden[k] = std::stoull (v, 0, 16);
+    }
+  in.close ();
+
+  if (m_updateGolden)
+    {
+      golden[key] = value;
+      std::ofstream out (m_goldenFile.c_str (), std::ofstream::out | std::ofstream::trunc);
+      NS_ABORT_MSG_UNLESS (out.is_open (), "Cannot write " << m_goldenFile);
+      for (const auto &entry : golden)
+        {
+          out << entry.first << " " << std::hex << std::setfill ('0') << std::setw (16)
+              << entry.second << std::dec << std::endl;
+        }
+      std::clog << "  golden: stored in " << m_goldenFile << std::endl;
+      return;
+    }
+
+  std::map<std::string, uint64_t>::const_iterator i = golden.find (key);
+  if (i == golden.end ())
+    {
+      std::clog << "  golden: none in " << m_goldenFile << std::endl;
+    }
+  else if (i->second == value)
+    {
+      std::clog << "  golden: match" << std::endl;
+    }
+  else
+    {
+      std::clog << "  golden: MISMATCH, expected 0x" << std::hex << std::setfill ('0') << std::setw (16)
+                << i->second << std::dec << std::setfill (' ') << std::endl;
+      fingerprint::GetState ().failed = true;
+    }
+}
+
+} // namespace ns3
+
+#endif /* FINGERPRINT_SIMULATOR_IMPL_H */
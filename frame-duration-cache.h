@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FRAME_DURATION_CACHE_H
+#define FRAME_DURATION_CACHE_H
+
+// Memoized Wi-Fi frame durations.
+//
+// WifiPhy::CalculateTxDuration and
+// WifiPhy::CalculatePhyPreambleAndHeaderDuration recompute the preamble,
+// the symbol count and the payload duration from the TXVECTOR on every
+// call.  With a ConstantRateWifiManager only a handful of (PSDU size,
+// TXVECTOR) combinations ever occur: the data frames, ACKs, RTS and CTS
+// at the data and control modes.  FrameDurationCache returns the same
+// values from a hash table keyed by the PSDU size, mode, channel width,
+// guard interval, NSS, NESS, STBC, preamble type and band.  The durations
+// do not depend on the PHY, so a single per-thread table serves all of
+// them.  HE MU PPDUs, whose duration depends on the other users, are not
+// cached.
+//
+// GetStatistics counts the hits and misses, to check that a frame mix
+// repeats enough for the cache to pay off; "perf-bench --bench=duration"
+// measures the cost of a lookup against the computation.
+
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-tx-vector.h"
+#include "ns3/nstime.h"
+
+#include <cstddef>
+#include <ostream>
+#include <unordered_map>
+
+namespace ns3 {
+
+namespace framedurations {
+
+struct Statistics
+{
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t uncached = 0;            //!< HE MU PPDUs, always computed
+};
+
+} // namespace framedurations
+
+class FrameDurationCache
+{
+public:
+  /// \returns the cache of the calling thread
+  static FrameDurationCache &Get (void);
+
+  /// \returns WifiPhy::CalculateTxDuration (size, txVector, band)
+  Time GetTxDuration (uint32_t size, const WifiTxVector &txVector, WifiPhyBand band);
+  /// \returns WifiPhy::CalculatePhyPreambleAndHeaderDuration (txVector)
+  Time GetPreambleAndHeaderDuration (const WifiTxVector &txVector);
+
+  const framedurations::Statistics &GetStatistics (void) const;
+  void PrintStatistics (std::ostream &os) const;
+  /// Forget the durations and reset the statistics
+  void Clear (void);
+
+private:
+  struct Key
+  {
+    uint64_t sizeAndMode;
+    uint64_t parameters;
+
+    bool operator == (const Key &other) const
+    {
+      return sizeAndMode == other.sizeAndMode && parameters == other.parameters;
+    }
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator () (const Key &key) const
+    {
+      return key.sizeAndMode * 0x9e3779b97f4a7c15ULL ^ key.parameters;
+    }
+  };
+
+  static Key MakeKey (uint32_t size, const WifiTxVector &txVector, WifiPhyBand band);
+
+  std::unordered_map<Key, Time, KeyHash> m_txDurations;
+  std::unordered_map<Key, Time, KeyHash> m_preambleDurations;
+  framedurations::Statistics m_stats;
+};
+
+inline FrameDurationCache &
+FrameDurationCache::Get (void)
+{
+  static thread_local FrameDurationCache cache;
+  return cache;
+}
+
+inline FrameDurationCache::Key
+FrameDurationCache::MakeKey (uint32_t size, const WifiTxVector &txVector, WifiPhyBand band)
+{
+  Key key;
+  key.sizeAndMode = (static_cast<uint64_t> (size) << 32) | txVector.GetMode ().GetUid ();
+  key.parameters = static_cast<uint64_t> (txVector.GetChannelWidth ())
+    | static_cast<uint64_t> (txVector.GetGuardInterval ()) << 16
+    | static_cast<uint64_t> (txVector.GetNss ()) << 32
+    | static_cast<uint64_t> (txVector.GetNess ()) << 40
+    | static_cast<uint64_t> (txVector.IsStbc ()) << 48
+    | static_cast<uint64_t> (txVector.GetPreambleType ()) << 49
+    | static_cast<uint64_t> (band) << 56;
+  return key;
+}
+
+inline Time
+FrameDurationCache::GetTxDuration (uint32_t size, const WifiTxVector &txVector, WifiPhyBand band)
+{
+  if (txVector.GetPreambleType () == WIFI_PREAMBLE_HE_MU)
+    {
+      m_stats.uncached++;
+      return WifiPhy::CalculateTxDuration (size, txVector, band);
+    }
+  Key key = MakeKey (size, txVector, band);
+  std::unordered_map<Key, Time, KeyHash>::const_iterator i = m_txDurations.find (key);
+  if (i != m_txDurations.end ())
+    {
+      m_stats.hits++;
+      return i->second;
+    }
+  m_stats.misses++;
+  Time duration = WifiPhy::CalculateTxDuration (size, txVector, band);
+  m_txDurations.insert (std::make_pair (key, duration));
+  return duration;
+}
+
+inline Time
+FrameDurationCache::GetPreambleAndHeaderDuration (const WifiTxVector &txVector)
+{
+  if (txVector.GetPreambleType () == WIFI_PREAMBLE_HE_MU)
+    {
+      m_stats.uncached++;
+      return WifiPhy::CalculatePhyPreambleAndHeaderDuration (txVector);
+    }
+  // The preamble does not depend on the size nor on the band
+  Key key = MakeKey (0, txVector, static_cast<WifiPhyBand> (0));
+  std::unordered_map<Key, Time, KeyHash>::const_iterator i = m_preambleDurations.find (key);
+  if (i != m_preambleDurations.end ())
+    {
+      m_stats.hits++;
+      return i->second;
+    }
+  m_stats.misses++;
+  Time duration = WifiPhy::CalculatePhyPreambleAndHeaderDuration (txVector);
+  m_preambleDurations.insert (std::make_pair (key, duration));
+  return duration;
+}
+
+inline const framedurations::Statistics &
+FrameDurationCache::GetStatistics (void) const
+{
+  return m_stats;
+}
+
+inline void
+FrameDurationCache::PrintStatistics (std::ostream &os) const
+{
+  uint64_t lookups = m_stats.hits + m_stats.misses;
+  os << "Frame duration cache: " << lookups << " lookups, " << m_stats.hits << " hits ("
+     << (lookups > 0 ? 100.0 * m_stats.hits / lookups : 0) << "%), "
+     << m_txDurations.size () + m_preambleDurations.size () << " entries, "
+     << m_stats.uncached << " uncached HE MU" << std::endl;
+}
+
+inline void
+FrameDurationCache::Clear (void)
+{
+  m_txDurations.clear ();
+  m_preambleDurations.clear ();
+  m_stats = framedurations::Statistics ();
+}
+
+} // namespace ns3
+
+#endif /* FRAME_DURATION_CACHE_H */
@@ -0,0 +1,494 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef HASHED_IPV4_END_POINT_DEMUX_H
+#define HASHED_IPV4_END_POINT_DEMUX_H
+
+// IPv4 end point demultiplexer backed by hash tables.
+//
+// Ipv4EndPointDemux keeps the end points of UDP and TCP in one list, and
+// Lookup walks all of it for every received segment or datagram.  The AP
+// of ms-lab4, ms-lab6 and ms-lab7-outdoor has one PacketSink socket per
+// flow, on ports 9, 10, 11 and so on, so its receive cost grows with the
+// number of flows.
+//
+// HashedIpv4EndPointDemux has the interface and the semantics of
+// Ipv4EndPointDemux, with two indexes:
+//
+//   - by local port: Lookup examines only the end points of the
+//     destination port, with the same wildcard rules and precedence as
+//     Ipv4EndPointDemux (exact 4-tuple, then wildcard local address, then
+//     wildcard peer, then both wildcards),
+//   - by 4-tuple, for the end points allocated with their peer (the
+//     connections accepted by a TCP listener, all on the port of the
+//     listener): an exact match is found without walking the port.
+//
+// An end point can be changed after its allocation (Ipv4EndPoint::SetPeer
+// when a UDP socket connects, SetLocalAddress), so a 4-tuple hit is only
+// used if the end point still has that 4-tuple; otherwise the port is
+// examined, where every end point is kept.  Local ports never change.
+//
+// "perf-bench --bench=demux" compares it with Ipv4EndPointDemux.
+
+#include "ns3/ipv4-end-point.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/net-device.h"
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <list>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+namespace hasheddemux {
+
+const uint16_t EPHEMERAL_PORT_START = 49152;
+const uint16_t EPHEMERAL_PORT_END = 65535;
+
+struct Statistics
+{
+  uint64_t lookups = 0;
+  uint64_t tupleHits = 0;           //!< lookups answered by the 4-tuple index
+  uint64_t examined = 0;            //!< end points examined by the other lookups
+};
+
+struct TupleKey
+{
+  uint64_t local;                   //!< address << 16 | port
+  uint64_t peer;
+
+  TupleKey (Ipv4Address localAddress, uint16_t localPort, Ipv4Address peerAddress, uint16_t peerPort)
+    : local ((uint64_t (localAddress.Get ()) << 16) | localPort),
+      peer ((uint64_t (peerAddress.Get ()) << 16) | peerPort)
+  {
+  }
+  bool operator == (const TupleKey &other) const
+  {
+    return local == other.local && peer == other.peer;
+  }
+};
+
+struct TupleKeyHash
+{
+  std::size_t operator () (const TupleKey &key) const
+  {
+    return static_cast<std::size_t> ((key.local * 0x9e3779b97f4a7c15ULL) ^ key.peer);
+  }
+};
+
+inline TupleKey
+GetTupleKey (Ipv4EndPoint *endPoint)
+{
+  return TupleKey (endPoint->GetLocalAddress (), endPoint->GetLocalPort (),
+                   endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+}
+
+} // namespace hasheddemux
+
+class HashedIpv4EndPointDemux
+{
+public:
+  typedef std::list<Ipv4EndPoint *> EndPoints;
+
+  HashedIpv4EndPointDemux ();
+  ~HashedIpv4EndPointDemux ();
+
+  EndPoints GetAllEndPoints (void);
+  bool LookupPortLocal (uint16_t port);
+  bool LookupLocal (Ptr<NetDevice> boundNetDevice, Ipv4Address addr, uint16_t port);
+  /// \returns the most specific end points for the packet, see Ipv4EndPointDemux::Lookup
+  EndPoints Lookup (Ipv4Address daddr, uint16_t dport, Ipv4Address saddr, uint16_t sport,
+                    Ptr<Ipv4Interface> incomingInterface);
+  /// \returns the exact or the least generic end point, see Ipv4EndPointDemux::SimpleLookup
+  Ipv4EndPoint *SimpleLookup (Ipv4Address daddr, uint16_t dport, Ipv4Address saddr, uint16_t sport);
+
+  Ipv4EndPoint *Allocate (void);
+  Ipv4EndPoint *Allocate (Ipv4Address address);
+  Ipv4EndPoint *Allocate (Ptr<NetDevice> boundNetDevice, uint16_t port);
+  Ipv4EndPoint *Allocate (Ptr<NetDevice> boundNetDevice, Ipv4Address address, uint16_t port);
+  Ipv4EndPoint *Allocate (Ptr<NetDevice> boundNetDevice, Ipv4Address localAddress, uint16_t localPort,
+                          Ipv4Address peerAddress, uint16_t peerPort);
+  void DeAllocate (Ipv4EndPoint *endPoint);
+
+  const hasheddemux::Statistics &GetStatistics (void) const;
+  void PrintStatistics (std::ostream &os) const;
+
+private:
+  typedef std::unordered_map<hasheddemux::TupleKey, Ipv4EndPoint *, hasheddemux::TupleKeyHash> TupleIndex;
+
+  uint16_t AllocateEphemeralPort (void);
+  void Insert (Ipv4EndPoint *endPoint);
+
+  std::unordered_map<uint16_t, std::vector<Ipv4EndPoint *> > m_ports;
+  TupleIndex m_tuples;
+  uint16_t m_ephemeral;
+  uint16_t m_portFirst;
+  uint16_t m_portLast;
+  hasheddemux::Statistics m_stats;
+};
+
+inline
+HashedIpv4EndPointDemux::HashedIpv4EndPointDemux ()
+  : m_ephemeral (hasheddemux::EPHEMERAL_PORT_START),
+    m_portFirst (hasheddemux::EPHEMERAL_PORT_START),
+    m_portLast (hasheddemux::EPHEMERAL_PORT_END)
+{
+}
+
+inline
+HashedIpv4EndPointDemux::~HashedIpv4EndPointDemux ()
+{
+  for (auto &port : m_ports)
+    {
+      for (Ipv4EndPoint *endPoint : port.second)
+        {
+          delete endPoint;
+        }
+    }
+}
+
+inline HashedIpv4EndPointDemux::EndPoints
+HashedIpv4EndPointDemux::GetAllEndPoints (void)
+{
+  EndPoints endPoints;
+  for (const auto &port : m_ports)
+    {
+      endPoints.insert (endPoints.end (), port.second.begin (), port.second.end ());
+    }
+  return endPoints;
+}
+
+inline bool
+HashedIpv4EndPointDemux::LookupPortLocal (uint16_t port)
+{
+  return m_ports.find (port) != m_ports.end ();
+}
+
+inline bool
+HashedIpv4EndPointDemux::LookupLocal (Ptr<NetDevice> boundNetDevice, Ipv4Address addr, uint16_t port)
+{
+  auto it = m_ports.find (port);
+  if (it == m_ports.end ())
+    {
+      return false;
+    }
+  for (Ipv4EndPoint *endPoint : it->second)
+    {
+      if (endPoint->GetLocalAddress () == addr && endPoint->GetBoundNetDevice () == boundNetDevice)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+inline void
+HashedIpv4EndPointDemux::Insert (Ipv4EndPoint *endPoint)
+{
+  m_ports[endPoint->GetLocalPort ()].push_back (endPoint);
+}
+
+inline uint16_t
+HashedIpv4EndPointDemux::AllocateEphemeralPort (void)
+{
+  // As Ipv4EndPointDemux: the port after the last one allocated, skipping
+  // the ports in use; 0 if they all are
+  uint16_t port = m_ephemeral;
+  int count = m_portLast - m_portFirst;
+  do
+    {
+      if (count-- < 0)
+        {
+          return 0;
+        }
+      ++port;
+      if (port < m_portFirst || port > m_portLast)
+        {
+          port = m_portFirst;
+        }
+    }
+  while (LookupPortLocal (port));
+  m_ephemeral = port;
+  return port;
+}
+
+inline Ipv4EndPoint *
+HashedIpv4EndPointDemux::Allocate (void)
+{
+  return Allocate (Ipv4Address::GetAny ());
+}
+
+inline Ipv4EndPoint *
+HashedIpv4EndPointDemux::Allocate (Ipv4Address address)
+{
+  uint16_t port = AllocateEphemeralPort ();
+  if (port == 0)
+    {
+      return 0;
+    }
+  Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
+  Insert (endPoint);
+  return endPoint;
+}
+
+inline Ipv4EndPoint *
+HashedIpv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, uint16_t port)
+{
+  return Allocate (boundNetDevice, Ipv4Address::GetAny (), port);
+}
+
+inline Ipv4EndPoint *
+HashedIpv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, Ipv4Address address, uint16_t port)
+{
+  if (LookupLocal (boundNetDevice, address, port) || LookupLocal (0, address, port))
+    {
+      return 0;
+    }
+  Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
+  endPoint->BindToNetDevice (boundNetDevice);
+  Insert (endPoint);
+  return endPoint;
+}
+
+inline Ipv4EndPoint *
+HashedIpv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, Ipv4Address localAddress, uint16_t localPort,
+                                   Ipv4Address peerAddress, uint16_t peerPort)
+{
+  auto it = m_ports.find (localPort);
+  if (it != m_ports.end ())
+    {
+      for (Ipv4EndPoint *endPoint : it->second)
+        {
+          if (endPoint->GetLocalAddress () == localAddress && endPoint->GetPeerPort () == peerPort
+              && endPoint->GetPeerAddress () == peerAddress
+              && (endPoint->GetBoundNetDevice () == boundNetDevice || endPoint->GetBoundNetDevice () == 0))
+            {
+              return 0;
+            }
+        }
+    }
+  Ipv4EndPoint *endPoint = new Ipv4EndPoint (localAddress, localPort);
+  endPoint->SetPeer (peerAddress, peerPort);
+  endPoint->BindToNetDevice (boundNetDevice);
+  Insert (endPoint);
+  m_tuples[hasheddemux::GetTupleKey (endPoint)] = endPoint;
+  return endPoint;
+}
+
+inline void
+HashedIpv4EndPointDemux::DeAllocate (Ipv4EndPoint *endPoint)
+{
+  auto it = m_ports.find (endPoint->GetLocalPort ());
+  NS_ABORT_MSG_IF (it == m_ports.end (), "Unknown end point");
+  std::vector<Ipv4EndPoint *> &endPoints = it->second;
+  std::vector<Ipv4EndPoint *>::iterator found = std::find (endPoints.begin (), endPoints.end (), endPoint);
+  NS_ASSERT_MSG (found != endPoints.end (), "Unknown end point");
+  endPoints.erase (found);
+  if (endPoints.empty ())
+    {
+      m_ports.erase (it);
+    }
+  // The end point may have changed since its allocation: look for it
+  // under its current 4-tuple, then everywhere
+  TupleIndex::iterator tuple = m_tuples.find (hasheddemux::GetTupleKey (endPoint));
+  if (tuple == m_tuples.end () || tuple->second != endPoint)
+    {
+      for (tuple = m_tuples.begin (); tuple != m_tuples.end () && tuple->second != endPoint; ++tuple)
+        {
+        }
+    }
+  if (tuple != m_tuples.end ())
+    {
+      m_tuples.erase (tuple);
+    }
+  delete endPoint;
+}
+
+inline HashedIpv4EndPointDemux::EndPoints
+HashedIpv4EndPointDemux::Lookup (Ipv4Address daddr, uint16_t dport, Ipv4Address saddr, uint16_t sport,
+                                 Ptr<Ipv4Interface> incomingInterface)
+{
+  m_stats.lookups++;
+  EndPoints retval;
+
+  TupleIndex::const_iterator tuple = m_tuples.find (hasheddemux::TupleKey (daddr, dport, saddr, sport));
+  if (tuple != m_tuples.end ())
+    {
+      Ipv4EndPoint *endPoint = tuple->second;
+      if (hasheddemux::GetTupleKey (endPoint) == tuple->first && endPoint->IsRxEnabled ()
+          && (endPoint->GetBoundNetDevice () == 0
+              || (incomingInterface != 0 && endPoint->GetBoundNetDevice () == incomingInterface->GetDevice ())))
+        {
+          // Exact 4-tuple matches take precedence, and there is only one
+          m_stats.tupleHits++;
+          retval.push_back (endPoint);
+          return retval;
+        }
+    }
+
+  auto port = m_ports.find (dport);
+  if (port == m_ports.end ())
+    {
+      return retval;
+    }
+  EndPoints retval1; // Matches exact on local port, wildcards on others
+  EndPoints retval2; // Matches exact on local port/address, wildcards on others
+  EndPoints retval3; // Matches all but local address
+  EndPoints retval4; // Exact match on all 4
+  for (Ipv4EndPoint *endPoint : port->second)
+    {
+      m_stats.examined++;
+      if (!endPoint->IsRxEnabled ())
+        {
+          continue;
+        }
+      if (endPoint->GetBoundNetDevice ()
+          && (incomingInterface == 0 || endPoint->GetBoundNetDevice () != incomingInterface->GetDevice ()))
+        {
+          continue;
+        }
+
+      bool localAddressMatchesExact = endPoint->GetLocalAddress () == daddr;
+      bool localAddressIsAny = !localAddressMatchesExact && endPoint->GetLocalAddress () == Ipv4Address::GetAny ();
+      bool localAddressIsSubnetAny = false;
+      if (!localAddressMatchesExact && !localAddressIsAny && incomingInterface != 0)
+        {
+          // Bound to the network address of the interface, as in
+          // Ipv4EndPointDemux::Lookup
+          for (uint32_t i = 0; i < incomingInterface->GetNAddresses () && !localAddressIsSubnetAny; i++)
+            {
+              Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
+              Ipv4Address addrNetpart = addr.GetLocal ().CombineMask (addr.GetMask ());
+              localAddressIsSubnetAny = endPoint->GetLocalAddress () == addrNetpart;
+            }
+        }
+      if (!localAddressMatchesExact && !localAddressIsAny && !localAddressIsSubnetAny)
+        {
+          continue;
+        }
+
+      bool remotePortMatchesExact = endPoint->GetPeerPort () == sport;
+      bool remotePortMatchesWildCard = endPoint->GetPeerPort () == 0;
+      bool remoteAddressMatchesExact = endPoint->GetPeerAddress () == saddr;
+      bool remoteAddressMatchesWildCard = endPoint->GetPeerAddress () == Ipv4Address::GetAny ();
+      if (!(remotePortMatchesExact || remotePortMatchesWildCard)
+          || !(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+        {
+          continue;
+        }
+
+      bool localAddressMatchesWildCard = localAddressIsAny || localAddressIsSubnetAny;
+      if (localAddressMatchesExact && remoteAddressMatchesExact && remotePortMatchesExact)
+        {
+          retval4.push_back (endPoint);
+        }
+      if (localAddressMatchesWildCard && remoteAddressMatchesExact && remotePortMatchesExact)
+        {
+          retval3.push_back (endPoint);
+        }
+      if (localAddressMatchesExact && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
+        {
+          retval2.push_back (endPoint);
+        }
+      if (localAddressMatchesWildCard && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
+        {
+          retval1.push_back (endPoint);
+        }
+    }
+
+  if (!retval4.empty ())
+    {
+      retval = retval4;
+    }
+  else if (!retval3.empty ())
+    {
+      retval = retval3;
+    }
+  else if (!retval2.empty ())
+    {
+      retval = retval2;
+    }
+  else
+    {
+      retval = retval1;
+    }
+  NS_ABORT_MSG_IF (retval.size () > 1, "Too many endpoints - perhaps you created too many sockets without binding them to different NetDevices.");
+  return retval;
+}
+
+inline Ipv4EndPoint *
+HashedIpv4EndPointDemux::SimpleLookup (Ipv4Address daddr, uint16_t dport, Ipv4Address saddr, uint16_t sport)
+{
+  TupleIndex::const_iterator tuple = m_tuples.find (hasheddemux::TupleKey (daddr, dport, saddr, sport));
+  if (tuple != m_tuples.end () && hasheddemux::GetTupleKey (tuple->second) == tuple->first)
+    {
+      return tuple->second;
+    }
+  auto port = m_ports.find (dport);
+  if (port == m_ports.end ())
+    {
+      return 0;
+    }
+  // Among the others, the end point with the fewest wildcard addresses
+  uint32_t genericity = 3;
+  Ipv4EndPoint *generic = 0;
+  for (Ipv4EndPoint *endPoint : port->second)
+    {
+      if (endPoint->GetLocalAddress () == daddr && endPoint->GetPeerPort () == sport
+          && endPoint->GetPeerAddress () == saddr)
+        {
+          return endPoint;
+        }
+      uint32_t tmp = 0;
+      if (endPoint->GetLocalAddress () == Ipv4Address::GetAny ())
+        {
+          tmp++;
+        }
+      if (endPoint->GetPeerAddress () == Ipv4Address::GetAny ())
+        {
+          tmp++;
+        }
+      if (tmp < genericity)
+        {
+          generic = endPoint;
+          genericity = tmp;
+        }
+    }
+  return generic;
+}
+
+inline const hasheddemux::Statistics &
+HashedIpv4EndPointDemux::GetStatistics (void) const
+{
+  return m_stats;
+}
+
+inline void
+HashedIpv4EndPointDemux::PrintStatistics (std::ostream &os) const
+{
+  os << "Hashed end point demux: " << m_stats.lookups << " lookups, " << m_stats.tupleHits
+     << " by 4-tuple, " << m_stats.examined << " end points examined by the others" << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* HASHED_IPV4_END_POINT_DEMUX_H */
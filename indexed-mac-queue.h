@@ -0,0 +1,359 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INDEXED_MAC_QUEUE_H
+#define INDEXED_MAC_QUEUE_H
+
+// Wi-Fi MAC queue indexed by receiver address and TID.
+//
+// WifiMacQueue is a single list: PeekByTidAndAddress and
+// DequeueByTidAndAddress walk it from the head until they find a QoS data
+// frame for the receiver and TID, and the lifetime check runs on the items
+// they walk over.  On an AP with a deep queue (10,000 packets per AC in
+// anomaly2_6_54, 10 million in ms-lab7-maxthr) serving many stations, the
+// frames of one station are spread over the whole queue.
+//
+// IndexedMacQueue keeps every item on two intrusive lists: the global
+// list, in enqueue order, and the list of its (receiver address, TID)
+// sub-queue, reached through a hash table.  Peek and dequeue by receiver
+// and TID take the head of the sub-queue, and Dequeue the head of the
+// global list, in O(1).  An item expires MaxDelay after its
+// WifiMacQueueItem time stamp, as in WifiMacQueue.  Items are normally
+// enqueued in time stamp order, so the global list is also in expiry
+// order: expired items are removed from its head, in O(expired items).
+// An item that was stamped before the ones ahead of it expires behind the
+// head, and is removed when it reaches the head of the global list or of
+// its sub-queue.  The list nodes are recycled, so enqueueing does not
+// allocate once the queue has been full.
+//
+// The semantics are those of WifiMacQueue with the default DROP_NEWEST
+// drop policy: an item is expired when now > time stamp + MaxDelay,
+// expired items are removed before they are returned, and an item
+// enqueued in a full queue is dropped.  Frames other than QoS data have
+// no TID and are only reached through Peek and Dequeue.
+//
+// "perf-bench --bench=macqueue" compares it with WifiMacQueue.
+
+#include "ns3/wifi-mac-queue-item.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/mac48-address.h"
+#include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/assert.h"
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+namespace indexedmacqueue {
+
+/// TID of the sub-queue of the frames other than QoS data
+const uint8_t NO_TID = 0xff;
+
+struct Statistics
+{
+  uint64_t enqueued = 0;
+  uint64_t dropped = 0;             //!< enqueued in a full queue
+  uint64_t expired = 0;
+  uint64_t maxSubQueues = 0;
+};
+
+} // namespace indexedmacqueue
+
+class IndexedMacQueue
+{
+public:
+  /**
+   * \param maxPackets the queue capacity
+   * \param maxDelay the lifetime of the items
+   */
+  IndexedMacQueue (uint32_t maxPackets, Time maxDelay);
+  ~IndexedMacQueue ();
+
+  // Delete copy constructor and assignment operator to avoid misuse
+  IndexedMacQueue (const IndexedMacQueue &) = delete;
+  IndexedMacQueue &operator= (const IndexedMacQueue &) = delete;
+
+  /// \returns false if the queue is full and the item was dropped
+  bool Enqueue (Ptr<WifiMacQueueItem> item);
+  /// \returns the oldest item, or 0 if the queue is empty
+  Ptr<WifiMacQueueItem> Dequeue (void);
+  /// \returns the oldest item, or 0 if the queue is empty
+  Ptr<const WifiMacQueueItem> Peek (void);
+
+  /// \returns the oldest QoS data frame for dest and tid, or 0
+  Ptr<const WifiMacQueueItem> PeekByTidAndAddress (uint8_t tid, Mac48Address dest);
+  /// \returns the oldest QoS data frame for dest and tid, or 0, removed from the queue
+  Ptr<WifiMacQueueItem> DequeueByTidAndAddress (uint8_t tid, Mac48Address dest);
+  /// \returns the number of QoS data frames queued for dest and tid
+  uint32_t GetNPacketsByTidAndAddress (uint8_t tid, Mac48Address dest);
+
+  uint32_t GetNPackets (void);
+  bool IsEmpty (void);
+  /// Remove all the items
+  void Flush (void);
+
+  const indexedmacqueue::Statistics &GetStatistics (void) const;
+  void PrintStatistics (std::ostream &os) const;
+
+private:
+  struct Node
+  {
+    Ptr<WifiMacQueueItem> item;
+    Time expiry;
+    uint64_t key;
+    Node *prev;                     //!< global list
+    Node *next;
+    Node *subPrev;                  //!< sub-queue list
+    Node *subNext;
+  };
+
+  struct SubQueue
+  {
+    Node *head = 0;
+    Node *tail = 0;
+    uint32_t n = 0;
+  };
+
+  static uint64_t MakeKey (uint8_t tid, Mac48Address dest);
+  static uint64_t MakeKey (const WifiMacHeader &header);
+
+  /// Remove the expired items from the head of the global list
+  void RemoveExpired (void);
+  /// Remove the expired items from the head of the sub-queue of key
+  /// \returns the sub-queue, or 0 if it is empty
+  SubQueue *RemoveExpired (uint64_t key);
+  /// Unlink node from both lists and recycle it
+  Ptr<WifiMacQueueItem> Remove (Node *node);
+
+  uint32_t m_maxPackets;
+  Time m_maxDelay;
+  uint32_t m_nPackets;
+  Node *m_head;
+  Node *m_tail;
+  std::unordered_map<uint64_t, SubQueue> m_subQueues;
+  std::vector<Node *> m_freeNodes;
+  indexedmacqueue::Statistics m_stats;
+};
+
+inline
+IndexedMacQueue::IndexedMacQueue (uint32_t maxPackets, Time maxDelay)
+  : m_maxPackets (maxPackets),
+    m_maxDelay (maxDelay),
+    m_nPackets (0),
+    m_head (0),
+    m_tail (0)
+{
+}
+
+inline
+IndexedMacQueue::~IndexedMacQueue ()
+{
+  Flush ();
+  for (Node *node : m_freeNodes)
+    {
+      delete node;
+    }
+}
+
+inline uint64_t
+IndexedMacQueue::MakeKey (uint8_t tid, Mac48Address dest)
+{
+  uint8_t address[6];
+  dest.CopyTo (address);
+  uint64_t key = tid;
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      key = (key << 8) | address[i];
+    }
+  return key;
+}
+
+inline uint64_t
+IndexedMacQueue::MakeKey (const WifiMacHeader &header)
+{
+  return MakeKey (header.IsQosData () ? header.GetQosTid () : indexedmacqueue::NO_TID, header.GetAddr1 ());
+}
+
+inline void
+IndexedMacQueue::RemoveExpired (void)
+{
+  Time now = Simulator::Now ();
+  while (m_head != 0 && now > m_head->expiry)
+    {
+      Remove (m_head);
+      m_stats.expired++;
+    }
+}
+
+inline IndexedMacQueue::SubQueue *
+IndexedMacQueue::RemoveExpired (uint64_t key)
+{
+  RemoveExpired ();
+  Time now = Simulator::Now ();
+  std::unordered_map<uint64_t, SubQueue>::iterator sub = m_subQueues.find (key);
+  while (sub != m_subQueues.end () && now > sub->second.head->expiry)
+    {
+      Remove (sub->second.head);
+      m_stats.expired++;
+      sub = m_subQueues.find (key);
+    }
+  return sub != m_subQueues.end () ? &sub->second : 0;
+}
+
+inline Ptr<WifiMacQueueItem>
+IndexedMacQueue::Remove (Node *node)
+{
+  (node->prev != 0 ? node->prev->next : m_head) = node->next;
+  (node->next != 0 ? node->next->prev : m_tail) = node->prev;
+
+  std::unordered_map<uint64_t, SubQueue>::iterator sub = m_subQueues.find (node->key);
+  NS_ASSERT (sub != m_subQueues.end ());
+  (node->subPrev != 0 ? node->subPrev->subNext : sub->second.head) = node->subNext;
+  (node->subNext != 0 ? node->subNext->subPrev : sub->second.tail) = node->subPrev;
+  if (--sub->second.n == 0)
+    {
+      m_subQueues.erase (sub);
+    }
+
+  Ptr<WifiMacQueueItem> item = node->item;
+  node->item = 0;
+  m_freeNodes.push_back (node);
+  m_nPackets--;
+  return item;
+}
+
+inline bool
+IndexedMacQueue::Enqueue (Ptr<WifiMacQueueItem> item)
+{
+  RemoveExpired ();
+  if (m_nPackets >= m_maxPackets)
+    {
+      m_stats.dropped++;
+      return false;
+    }
+
+  Node *node;
+  if (m_freeNodes.empty ())
+    {
+      node = new Node;
+    }
+  else
+    {
+      node = m_freeNodes.back ();
+      m_freeNodes.pop_back ();
+    }
+  node->item = item;
+  node->expiry = item->GetTimeStamp () + m_maxDelay;
+  node->key = MakeKey (item->GetHeader ());
+
+  node->prev = m_tail;
+  node->next = 0;
+  (m_tail != 0 ? m_tail->next : m_head) = node;
+  m_tail = node;
+
+  SubQueue &sub = m_subQueues[node->key];
+  node->subPrev = sub.tail;
+  node->subNext = 0;
+  (sub.tail != 0 ? sub.tail->subNext : sub.head) = node;
+  sub.tail = node;
+  sub.n++;
+
+  m_nPackets++;
+  m_stats.enqueued++;
+  if (m_subQueues.size () > m_stats.maxSubQueues)
+    {
+      m_stats.maxSubQueues = m_subQueues.size ();
+    }
+  return true;
+}
+
+inline Ptr<WifiMacQueueItem>
+IndexedMacQueue::Dequeue (void)
+{
+  RemoveExpired ();
+  return m_head != 0 ? Remove (m_head) : 0;
+}
+
+inline Ptr<const WifiMacQueueItem>
+IndexedMacQueue::Peek (void)
+{
+  RemoveExpired ();
+  return m_head != 0 ? m_head->item : 0;
+}
+
+inline Ptr<const WifiMacQueueItem>
+IndexedMacQueue::PeekByTidAndAddress (uint8_t tid, Mac48Address dest)
+{
+  SubQueue *sub = RemoveExpired (MakeKey (tid, dest));
+  return sub != 0 ? sub->head->item : 0;
+}
+
+inline Ptr<WifiMacQueueItem>
+IndexedMacQueue::DequeueByTidAndAddress (uint8_t tid, Mac48Address dest)
+{
+  SubQueue *sub = RemoveExpired (MakeKey (tid, dest));
+  return sub != 0 ? Remove (sub->head) : 0;
+}
+
+inline uint32_t
+IndexedMacQueue::GetNPacketsByTidAndAddress (uint8_t tid, Mac48Address dest)
+{
+  SubQueue *sub = RemoveExpired (MakeKey (tid, dest));
+  return sub != 0 ? sub->n : 0;
+}
+
+inline uint32_t
+IndexedMacQueue::GetNPackets (void)
+{
+  RemoveExpired ();
+  return m_nPackets;
+}
+
+inline bool
+IndexedMacQueue::IsEmpty (void)
+{
+  return GetNPackets () == 0;
+}
+
+inline void
+IndexedMacQueue::Flush (void)
+{
+  while (m_head != 0)
+    {
+      Remove (m_head);
+    }
+}
+
+inline const indexedmacqueue::Statistics &
+IndexedMacQueue::GetStatistics (void) const
+{
+  return m_stats;
+}
+
+inline void
+IndexedMacQueue::PrintStatistics (std::ostream &os) const
+{
+  os << "Indexed MAC queue: " << m_stats.enqueued << " enqueued, " << m_stats.dropped << " dropped, "
+     << m_stats.expired << " expired, at most " << m_stats.maxSubQueues << " receiver/TID sub-queues"
+     << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* INDEXED_MAC_QUEUE_H */
@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef INSTANT_ON_H
+#define INSTANT_ON_H
+
+// Instant-on configuration of an infrastructure BSS.
+//
+// By default a STA scans passively: it waits WaitBeaconTimeout (120 ms)
+// for the beacons of the APs of its SSID, then associates, and its first
+// data frame to each TID triggers an ADDBA handshake.  Meanwhile every AP
+// sends a beacon each 102.4 ms for the whole simulation, which every STA
+// in range receives and compares with its SSID; with the many co-channel
+// APs of ms-lab7-outdoor that is most of the management traffic.
+//
+// InstantOnHelper::Install, called on the devices of one BSS before the
+// simulation starts:
+//
+//   - makes the STAs probe actively, so that they associate as soon as
+//     the probe responses of their AP are in, after ProbeRequestTimeout
+//     (50 ms), instead of after the passive scan,
+//   - sets the beacon interval of the AP to a keep-alive interval, 67 s
+//     by default (the largest the beacon interval field can hold), and
+//     raises MaxMissedBeacons of the STAs so that they stay associated.
+//     The beacon jitter of the APs is kept: the STAs associate from the
+//     probe responses, and without the jitter all the APs would send
+//     their first beacon at the start, on top of one another,
+//   - sends, as soon as a STA is associated, two short frames to its AP
+//     for each of the TIDs given to AddBlockAckTid, so that the Block Ack
+//     agreements of the uplink are set up before the first data frame.
+//     These frames carry the IEEE 802 local experimental EtherType, which
+//     no protocol of the node handles: the AP drops them, and they are
+//     neither seen by FlowMonitor nor by the sinks.
+//
+// StaWifiMac offers no way of starting associated, so the STAs still go
+// through the probe and association exchange; the applications of a
+// scenario can start once it is over, typically after less than 100 ms
+// instead of the usual second.  instanton::PrintStatistics tells when
+// the last STA got associated.  The statistics are updated by the
+// threads of all the partitions of PartitionedSimulatorImpl.
+
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/mac48-address.h"
+#include "ns3/net-device-container.h"
+#include "ns3/packet.h"
+#include "ns3/socket.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/callback.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+namespace instanton {
+
+/// IEEE 802 local experimental EtherType of the Block Ack setup frames
+const uint16_t SETUP_PROTOCOL = 0x88b5;
+/// Setup frames sent per TID; HT originators ask for an agreement only
+/// when more than one frame is queued
+const uint32_t SETUP_FRAMES = 2;
+const uint32_t SETUP_FRAME_SIZE = 1;
+/// Largest beacon interval, in TUs of 1024 us
+const uint64_t MAX_BEACON_INTERVAL_TU = 65535;
+
+// Updated by the threads of all the partitions
+struct Statistics
+{
+  std::atomic<uint32_t> stations {0};        //!< STAs configured by InstantOnHelper
+  std::atomic<uint32_t> associations {0};
+  std::atomic<int64_t> lastAssociation {0};  //!< time step of the last association
+  std::atomic<uint64_t> setupFrames {0};
+};
+
+inline Statistics &
+GetStatistics (void)
+{
+  static Statistics stats;
+  return stats;
+}
+
+inline void
+PrintStatistics (std::ostream &os)
+{
+  const Statistics &stats = GetStatistics ();
+  os << "Instant-on: " << stats.associations.load () << " associations of " << stats.stations.load ()
+     << " stations, the last at " << TimeStep (stats.lastAssociation.load ()).GetSeconds () * 1e3 << " ms, "
+     << stats.setupFrames.load () << " Block Ack setup frames" << std::endl;
+}
+
+/// Count the association of device to bssid, and send the Block Ack
+/// setup frames of tids
+inline void
+NotifyAssociated (Ptr<WifiNetDevice> device, std::vector<uint8_t> tids, Mac48Address bssid)
+{
+  Statistics &stats = GetStatistics ();
+  stats.associations++;
+  // The partitions are not in step: keep the latest time
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  int64_t last = stats.lastAssociation.load ();
+  while (now > last && !stats.lastAssociation.compare_exchange_weak (last, now))
+    {
+    }
+  for (uint8_t tid : tids)
+    {
+      for (uint32_t i = 0; i < SETUP_FRAMES; i++)
+        {
+          Ptr<Packet> packet = Create<Packet> (SETUP_FRAME_SIZE);
+          SocketPriorityTag priority;
+          priority.SetPriority (tid);
+          packet->AddPacketTag (priority);
+          device->Send (packet, bssid, SETUP_PROTOCOL);
+          stats.setupFrames++;
+        }
+    }
+}
+
+} // namespace instanton
+
+class InstantOnHelper
+{
+public:
+  InstantOnHelper ()
+    : m_beaconInterval (MicroSeconds (1024 * instanton::MAX_BEACON_INTERVAL_TU))
+  {
+  }
+
+  /// Set the beacon interval of the APs, a multiple of 1024 us
+  void SetBeaconInterval (Time interval)
+  {
+    m_beaconInterval = interval;
+  }
+
+  /// Set up the uplink Block Ack agreement of tid on association
+  void AddBlockAckTid (uint8_t tid)
+  {
+    m_tids.push_back (tid);
+  }
+
+  /// Configure one BSS: its AP device and the devices of its STAs
+  void Install (Ptr<NetDevice> apDevice, const NetDeviceContainer &staDevices) const
+  {
+    Ptr<WifiMac> apMac = DynamicCast<WifiNetDevice> (apDevice)->GetMac ();
+    apMac->SetAttribute ("BeaconInterval", TimeValue (m_beaconInterval));
+    for (NetDeviceContainer::Iterator i = staDevices.Begin (); i != staDevices.End (); ++i)
+      {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+        Ptr<WifiMac> mac = device->GetMac ();
+        mac->SetAttribute ("ActiveProbing", BooleanValue (true));
+        // The STAs learn the beacon interval from the probe response; keep
+        // them associated even if beacons are lost
+        mac->SetAttribute ("MaxMissedBeacons", UintegerValue (1000));
+        mac->TraceConnectWithoutContext ("Assoc", MakeBoundCallback (&instanton::NotifyAssociated, device, m_tids));
+        instanton::GetStatistics ().stations++;
+      }
+  }
+
+private:
+  Time m_beaconInterval;
+  std::vector<uint8_t> m_tids;
+};
+
+} // namespace ns3
+
+#endif /* INSTANT_ON_H */
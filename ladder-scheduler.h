@@ -0,0 +1,318 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+// Ladder queue event scheduler (W. T. Tang, R. S. M. Goh, I. L.-J. Thng,
+// "Ladder queue: An O(1) priority queue structure for large-scale discrete
+// event simulation", ACM TOMACS 15(3), 2005).
+//
+// Events are kept in three tiers:
+//   - Top: unsorted events beyond the range covered by the rungs,
+//   - Rungs: arrays of buckets, each deeper rung splitting one bucket of
+//     the rung above into finer buckets,
+//   - Bottom: a small sorted list holding the next events to execute.
+// Events are only sorted once they reach Bottom, in buckets of at most
+// Threshold events, so insertion and removal take O(1) amortized time
+// for most event time distributions.  Events earlier than every rung are
+// inserted into Bottom in order; once Bottom holds Threshold events it is
+// spread over a new deepest rung instead, as in the paper, so that it
+// does not turn into a long sorted list (e.g. when Top held only a few
+// events and a far-off Stop, and everything else then falls before it).
+//
+// Select it for a run with --SchedulerType=ns3::LadderScheduler.
+
+#include "ns3/scheduler.h"
+#include "ns3/uinteger.h"
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace ns3 {
+
+class LadderScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LadderScheduler ();
+  virtual ~LadderScheduler ();
+
+  // Inherited from Scheduler
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  struct Rung
+  {
+    uint64_t start;                          //!< timestamp of the first bucket
+    uint64_t width;                          //!< bucket width [time steps]
+    uint32_t current;                        //!< first bucket not yet dequeued
+    std::vector<std::vector<Event> > buckets;
+
+    uint64_t CurrentStart (void) const
+    {
+      return start + current * width;
+    }
+  };
+
+  void RefillBottom (void) const;
+  void AddRung (std::vector<Event> &events, uint64_t start, uint64_t span) const;
+  static void SortIntoBottom (std::vector<Event> &bottom, std::vector<Event> &events);
+  static bool Later (const Event &a, const Event &b);
+
+  uint32_t m_threshold;
+  uint32_t m_maxRungs;
+  uint32_t m_size;
+
+  // Refilling Bottom is deferred until an event is needed, also by PeekNext
+  mutable std::vector<Event> m_top;
+  mutable uint64_t m_topMin;
+  mutable uint64_t m_topMax;
+  mutable uint64_t m_topStart;               //!< events at or after this go to Top
+  mutable std::vector<Rung> m_rungs;         //!< m_rungs.back () is the deepest rung
+  mutable std::vector<Event> m_bottom;       //!< sorted latest first
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LadderScheduler);
+
+inline TypeId
+LadderScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LadderScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<LadderScheduler> ()
+    .AddAttribute ("Threshold",
+                   "Maximum number of events sorted into Bottom at once; "
+                   "larger buckets, and Bottom when it grows beyond it, are split into a new rung.",
+                   UintegerValue (50),
+                   MakeUintegerAccessor (&LadderScheduler::m_threshold),
+                   MakeUintegerChecker<uint32_t> (2))
+    .AddAttribute ("MaxRungs",
+                   "Maximum number of rungs.",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&LadderScheduler::m_maxRungs),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+inline
+LadderScheduler::LadderScheduler ()
+  : m_threshold (50),
+    m_maxRungs (8),
+    m_size (0),
+    m_topMin (std::numeric_limits<uint64_t>::max ()),
+    m_topMax (0),
+    m_topStart (0)
+{
+}
+
+inline
+LadderScheduler::~LadderScheduler ()
+{
+}
+
+inline bool
+LadderScheduler::Later (const Event &a, const Event &b)
+{
+  return b < a;
+}
+
+inline void
+LadderScheduler::SortIntoBottom (std::vector<Event> &bottom, std::vector<Event> &events)
+{
+  NS_ASSERT (bottom.empty ());
+  bottom.swap (events);
+  std::sort (bottom.begin (), bottom.end (), &LadderScheduler::Later);
+}
+
+inline void
+LadderScheduler::AddRung (std::vector<Event> &events, uint64_t start, uint64_t span) const
+{
+  uint64_t nBuckets = std::max<uint64_t> (1, std::min<uint64_t> (events.size (), span));
+  Rung rung;
+  rung.start = start;
+  rung.width = (span + nBuckets - 1) / nBuckets;
+  rung.current = 0;
+  rung.buckets.resize (nBuckets);
+  for (const Event &ev : events)
+    {
+      uint64_t i = std::min<uint64_t> ((ev.key.m_ts - start) / rung.width, nBuckets - 1);
+      rung.buckets[i].push_back (ev);
+    }
+  events.clear ();
+  m_rungs.push_back (rung);
+}
+
+inline void
+LadderScheduler::Insert (const Event &ev)
+{
+  m_size++;
+  uint64_t ts = ev.key.m_ts;
+  if (ts >= m_topStart)
+    {
+      m_top.push_back (ev);
+      m_topMin = std::min (m_topMin, ts);
+      m_topMax = std::max (m_topMax, ts);
+      return;
+    }
+  for (Rung &rung : m_rungs)
+    {
+      if (ts >= rung.CurrentStart ())
+        {
+          uint64_t i = std::min<uint64_t> ((ts - rung.start) / rung.width, rung.buckets.size () - 1);
+          rung.buckets[i].push_back (ev);
+          return;
+        }
+    }
+  if (m_bottom.size () >= m_threshold && m_rungs.size () < m_maxRungs
+      && m_bottom.front ().key.m_ts > m_bottom.back ().key.m_ts)
+    {
+      // Spread Bottom over a new deepest rung reaching up to the tier
+      // above it, then insert the event into the ladder again
+      uint64_t start = m_bottom.back ().key.m_ts;
+      uint64_t end = m_rungs.empty () ? m_topStart : m_rungs.back ().CurrentStart ();
+      AddRung (m_bottom, start, end - start);
+      m_size--;
+      Insert (ev);
+      return;
+    }
+  m_bottom.insert (std::upper_bound (m_bottom.begin (), m_bottom.end (), ev, &LadderScheduler::Later), ev);
+}
+
+inline void
+LadderScheduler::RefillBottom (void) const
+{
+  while (m_bottom.empty ())
+    {
+      if (m_rungs.empty ())
+        {
+          NS_ASSERT_MSG (!m_top.empty (), "LadderScheduler: no more events");
+          // Everything in Top becomes the first rung; later events that
+          // fall within its range are inserted directly into the rungs
+          uint64_t span = m_topMax - m_topMin + 1;
+          m_topStart = m_topMax + 1;
+          if (m_top.size () <= m_threshold || span == 1)
+            {
+              SortIntoBottom (m_bottom, m_top);
+            }
+          else
+            {
+              AddRung (m_top, m_topMin, span);
+            }
+          m_topMin = std::numeric_limits<uint64_t>::max ();
+          m_topMax = 0;
+          continue;
+        }
+
+      Rung &rung = m_rungs.back ();
+      while (rung.current < rung.buckets.size () && rung.buckets[rung.current].empty ())
+        {
+          rung.current++;
+        }
+      if (rung.current == rung.buckets.size ())
+        {
+          m_rungs.pop_back ();
+          continue;
+        }
+      std::vector<Event> bucket;
+      bucket.swap (rung.buckets[rung.current]);
+      uint64_t bucketStart = rung.CurrentStart ();
+      uint64_t width = rung.width;
+      rung.current++;
+      if (bucket.size () > m_threshold && width > 1 && m_rungs.size () < m_maxRungs)
+        {
+          AddRung (bucket, bucketStart, width);
+        }
+      else
+        {
+          SortIntoBottom (m_bottom, bucket);
+        }
+    }
+}
+
+inline bool
+LadderScheduler::IsEmpty (void) const
+{
+  return m_size == 0;
+}
+
+inline Scheduler::Event
+LadderScheduler::PeekNext (void) const
+{
+  NS_ASSERT (!IsEmpty ());
+  RefillBottom ();
+  return m_bottom.back ();
+}
+
+inline Scheduler::Event
+LadderScheduler::RemoveNext (void)
+{
+  NS_ASSERT (!IsEmpty ());
+  RefillBottom ();
+  Event ev = m_bottom.back ();
+  m_bottom.pop_back ();
+  m_size--;
+  return ev;
+}
+
+inline void
+LadderScheduler::Remove (const Event &ev)
+{
+  uint64_t ts = ev.key.m_ts;
+  std::vector<Event> *list = 0;
+  if (!m_bottom.empty () && !Later (ev, m_bottom.front ()))
+    {
+      list = &m_bottom;
+    }
+  else if (ts >= m_topStart)
+    {
+      list = &m_top;
+    }
+  else
+    {
+      for (Rung &rung : m_rungs)
+        {
+          if (ts >= rung.CurrentStart ())
+            {
+              list = &rung.buckets[std::min<uint64_t> ((ts - rung.start) / rung.width, rung.buckets.size () - 1)];
+              break;
+            }
+        }
+    }
+  NS_ASSERT (list != 0);
+  for (std::vector<Event>::iterator i = list->begin (); i != list->end (); i++)
+    {
+      if (i->key.m_uid == ev.key.m_uid)
+        {
+          list->erase (i);
+          m_size--;
+          return;
+        }
+    }
+  NS_ASSERT_MSG (false, "LadderScheduler: event not found");
+}
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
@@ -39,6 +39,7 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/packet-sink.h"
 #include "ns3/yans-wifi-channel.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
 #include <chrono>  // For high resolution clock
 
 // Course: Simulation Methods (Metody symulacyjne)
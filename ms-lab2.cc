@@ -44,6 +44,7 @@
 #include "ns3/propagation-delay-model.h"
 #include "ns3/abort.h"
 #include "ns3/global-value.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
 
 // Course: Simulation Methods (Metody symulacyjne)
 // Lab exercise: 2
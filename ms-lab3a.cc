@@ -45,6 +45,8 @@
 #include "ns3/propagation-delay-model.h"
 #include "ns3/abort.h"
 #include "ns3/mobility-model.h"
+#include "pooled-event.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
 
 // Course: Simulation Methods (Metody symulacyjne)
 // Lab exercise: 3a
@@ -89,7 +91,7 @@ void AdvancePosition (Ptr<Node> nodeSta, Ptr<Node> nodeAp,int stepsSize, int ste
   mobility->SetPosition (pos);
 
   //Schedule next "advance position" event
-  Simulator::Schedule (Seconds (stepsTime), &AdvancePosition, nodeSta, nodeAp, stepsSize, stepsTime);
+  SchedulePooled (Seconds (stepsTime), &AdvancePosition, nodeSta, nodeAp, stepsSize, stepsTime);
 }
 
 int main (int argc, char *argv[])
@@ -105,6 +107,7 @@ int main (int argc, char *argv[])
   int steps = 10;
   int stepsSize = 1;
   int stepsTime = 1;
+  bool eventPoolStats = false;
 
   // Parse command line arguments
   CommandLine cmd;
@@ -114,6 +117,7 @@ int main (int argc, char *argv[])
   cmd.AddValue ("steps", "Number of steps that the station should make", steps);    
   cmd.AddValue ("stepsSize", "Size of the steps [m]", stepsSize);      
   cmd.AddValue ("stepsTime", "Time to spend at each step [s]", stepsTime);        
+  cmd.AddValue ("eventPoolStats", "Print the heap allocations avoided by pooled events", eventPoolStats);
   cmd.Parse (argc,argv);
 
   double simulationTime = steps * stepsTime + 1; // Simulation time [s]
@@ -214,7 +218,7 @@ int main (int argc, char *argv[])
   mobility.Install (wifiStaNode);
 
   //Move the STA by stepsSize meters every stepsTime seconds
-  Simulator::Schedule (Seconds (1+stepsTime), &AdvancePosition, wifiStaNode.Get (0), wifiApNode.Get (0), stepsSize, stepsTime);
+  SchedulePooled (Seconds (1+stepsTime), &AdvancePosition, wifiStaNode.Get (0), wifiApNode.Get (0), stepsSize, stepsTime);
 
   // Install an Internet stack
   InternetStackHelper stack;
@@ -273,6 +277,10 @@ int main (int argc, char *argv[])
   std::clog << ("done!") << std::endl;  
   std::chrono::duration<double> elapsed = finish - start;
   std::cout << "Elapsed time: " << elapsed.count() << " s\n\n";
+  if (eventPoolStats)
+    {
+      eventpool::PrintStatistics (std::cout);
+    }
   
   // Calculate throughput
   double throughput = 0;
@@ -45,6 +45,7 @@
 #include "ns3/abort.h"
 #include "ns3/mobility-model.h"
 #include "ns3/flow-monitor-module.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
 
 // Course: Simulation Methods (Metody symulacyjne)
 // Lab exercise: 3b
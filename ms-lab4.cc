@@ -45,6 +45,10 @@
 #include "ns3/abort.h"
 #include "ns3/mobility-model.h"
 #include "ns3/flow-monitor-module.h"
+#include "shared-delivery-yans-wifi-phy.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
+#include "multi-port-sink.h"
 
 // Course: Simulation Methods (Metody symulacyjne)
 // Lab exercise: 4
@@ -77,6 +81,8 @@ int main (int argc, char *argv[])
   std::string positioning = "disc"; //Position allocator
   double simulationTime = 10; // Simulation time [s]
   double radius = 10; // Radius of node placement disc [m]
+  bool sharedDelivery = false; // Shared PPDU and batch loss, see shared-delivery-yans-wifi-phy.h
+  bool multiPortSink = false; // One sink application for all flows, see multi-port-sink.h
   
   // Parse command line arguments
   CommandLine cmd;
@@ -86,6 +92,8 @@ int main (int argc, char *argv[])
   cmd.AddValue ("nWifi", "Number of station", nWifi);  
   cmd.AddValue ("positioning", "Position allocator (grid, rectangle, disc)", positioning);     
   cmd.AddValue ("radius", "Radius of disc within which stations are randomly distributed", radius);  
+  cmd.AddValue ("sharedDelivery", "Deliver frames as one shared PPDU with a batch loss computation", sharedDelivery);
+  cmd.AddValue ("multiPortSink", "Receive all flows with one sink application on the AP", multiPortSink);
   cmd.Parse (argc,argv);
 
   // Print simulation settings to screen
@@ -108,7 +116,7 @@ int main (int argc, char *argv[])
   wifiStaNodes.Create (nWifi);
 
   // Configure wireless channel
-  YansWifiPhyHelper phy;
+  SharedDeliveryPhyHelper phy (sharedDelivery);
   Ptr<YansWifiChannel> channel;
   YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
 
@@ -242,13 +250,22 @@ int main (int argc, char *argv[])
     {
       auto ipv4 = wifiApNode.Get (0)->GetObject<Ipv4> (); //Get destination's IP interface
       const auto address = ipv4->GetAddress (1, 0).GetLocal (); //Get destination's IP address
-      InetSocketAddress sinkSocket (address, portNumber++); //Configure destination socket
+      InetSocketAddress sinkSocket (address, multiPortSink ? 9 : portNumber++); //Configure destination socket (all flows on port 9 with one sink)
       OnOffHelper onOffHelper ("ns3::UdpSocketFactory", sinkSocket); //Configure traffic generator: UDP, destination socket
       onOffHelper.SetConstantRate (DataRate (150e6 / nWifi), 1000);  //Set data rate (150 Mb/s divided by no. of transmitting stations) and packet size [B]
+      if (multiPortSink) onOffHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true)); //Timestamp packets for the delays of the sink
       sourceApplications.Add (onOffHelper.Install (wifiStaNodes.Get (index))); //Install traffic generator on station
-      PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket); //Configure traffic sink
-      sinkApplications.Add (packetSinkHelper.Install (wifiApNode.Get (0))); //Install traffic sink on AP
+      if (!multiPortSink) {
+        PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket); //Configure traffic sink
+        sinkApplications.Add (packetSinkHelper.Install (wifiApNode.Get (0))); //Install traffic sink on AP
+      }
     }
+  if (multiPortSink) { //One sink on the AP for all flows, on port 9
+    const auto address = wifiApNode.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+    MultiPortSinkHelper multiPortSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (address, 9), 1);
+    multiPortSinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+    sinkApplications.Add (multiPortSinkHelper.Install (wifiApNode.Get (0)));
+  }
 
   // Configure application start/stop times
   // Note: 
@@ -285,6 +302,8 @@ int main (int argc, char *argv[])
   // Calculate per-flow throughput and print results
   double flowThr=0;
   double totalThr=0;
+  Time delaySum;
+  uint64_t rxPackets=0;
 	Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
 	std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
   std::cout << "Results: " << std::endl;
@@ -295,10 +314,20 @@ int main (int argc, char *argv[])
     if (i->second.rxBytes!=0) {
       totalThr += flowThr;
     }
+    delaySum += i->second.delaySum;
+    rxPackets += i->second.rxPackets;
 	}
-  std::cout << std::endl << "Total throughput: " << totalThr << " Mb/s" << std::endl << std::endl;  
+  std::cout << std::endl << "Total throughput: " << totalThr << " Mb/s" << std::endl;
+  if (rxPackets > 0) {
+    std::cout << "Mean delay: " << delaySum.GetSeconds () * 1000 / rxPackets << " ms" << std::endl;
+  }
+  std::cout << std::endl;
 
   //Clean-up
+  if (sharedDelivery)
+    {
+      shareddelivery::PrintStatistics (std::cout);
+    }
   Simulator::Destroy ();
 
   return 0;
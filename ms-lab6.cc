@@ -45,6 +45,10 @@
 #include "ns3/abort.h"
 #include "ns3/mobility-model.h"
 #include "ns3/flow-monitor-module.h"
+#include "shared-delivery-yans-wifi-phy.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
+#include "multi-port-sink.h"
 #include <fstream>
 #include <iostream>
 #include <ctime>
@@ -100,6 +104,8 @@ int main (int argc, char *argv[])
   std::string positioning = "disc"; //Position allocator
   double simulationTime = 10; // Simulation time [s]
   double radius = 10; // Radius of node placement disc [m]
+  bool sharedDelivery = false; // Shared PPDU and batch loss, see shared-delivery-yans-wifi-phy.h
+  bool multiPortSink = false; // One sink application for all flows, see multi-port-sink.h
   bool pcap = false; // Generate a PCAP file from the AP
   bool useCsv = true; // Flag for saving output to CSV file
   bool useTcp = false;
@@ -113,6 +119,8 @@ int main (int argc, char *argv[])
   cmd.AddValue ("nWifi", "Number of station", nWifi);  
   cmd.AddValue ("positioning", "Position allocator (grid, rectangle, disc)", positioning);     
   cmd.AddValue ("radius", "Radius of disc within which stations are randomly distributed", radius);  
+  cmd.AddValue ("sharedDelivery", "Deliver frames as one shared PPDU with a batch loss computation", sharedDelivery);
+  cmd.AddValue ("multiPortSink", "Receive all flows with one sink application on the AP", multiPortSink);
   cmd.AddValue ("pcap", "Generate a PCAP file from the AP", pcap);
   cmd.AddValue ("useCsv", "Flag for saving output to CSV file", useCsv);  
   cmd.AddValue ("useTcp", "Flag for switching to TCP traffic", useTcp);  
@@ -140,7 +148,7 @@ int main (int argc, char *argv[])
   wifiStaNodes.Create (nWifi);
 
   // Configure wireless channel
-  YansWifiPhyHelper phy;
+  SharedDeliveryPhyHelper phy (sharedDelivery);
   Ptr<YansWifiChannel> channel;
   YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
 
@@ -277,13 +285,22 @@ int main (int argc, char *argv[])
     {
       auto ipv4 = wifiApNode.Get (0)->GetObject<Ipv4> (); //Get destination's IP interface
       const auto address = ipv4->GetAddress (1, 0).GetLocal (); //Get destination's IP address
-      InetSocketAddress sinkSocket (address, portNumber++); //Configure destination socket
+      InetSocketAddress sinkSocket (address, multiPortSink ? 9 : portNumber++); //Configure destination socket (all flows on port 9 with one sink)
       OnOffHelper onOffHelper (socketFactory, sinkSocket); //Configure traffic generator, destination socket
       onOffHelper.SetConstantRate (DataRate (dataRate * 1e6 / nWifi), 1000);  //Set data rate (150 Mb/s divided by no. of transmitting stations) and packet size [B]
+      if (multiPortSink && !useTcp) onOffHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true)); //Timestamp packets for the delays of the sink (UDP only)
       sourceApplications.Add (onOffHelper.Install (wifiStaNodes.Get (index))); //Install traffic generator on station
-      PacketSinkHelper packetSinkHelper (socketFactory, sinkSocket); //Configure traffic sink
-      sinkApplications.Add (packetSinkHelper.Install (wifiApNode.Get (0))); //Install traffic sink on AP
+      if (!multiPortSink) {
+        PacketSinkHelper packetSinkHelper (socketFactory, sinkSocket); //Configure traffic sink
+        sinkApplications.Add (packetSinkHelper.Install (wifiApNode.Get (0))); //Install traffic sink on AP
+      }
     }
+  if (multiPortSink) { //One sink on the AP for all flows, on port 9
+    const auto address = wifiApNode.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+    MultiPortSinkHelper multiPortSinkHelper (socketFactory, InetSocketAddress (address, 9), 1);
+    multiPortSinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (!useTcp));
+    sinkApplications.Add (multiPortSinkHelper.Install (wifiApNode.Get (0)));
+  }
 
   // Configure application start/stop times
   // Note: 
@@ -345,16 +362,35 @@ int main (int argc, char *argv[])
   double throughput = 0;
   for (uint32_t index = 0; index < sinkApplications.GetN (); ++index) //Loop over all traffic sinks
   {
-    uint64_t totalBytesThrough = DynamicCast<PacketSink> (sinkApplications.Get (index))->GetTotalRx (); //Get amount of bytes received
+    uint64_t totalBytesThrough; //Get amount of bytes received
+    if (multiPortSink) totalBytesThrough = DynamicCast<MultiPortSink> (sinkApplications.Get (index))->GetTotalRx ();
+    else totalBytesThrough = DynamicCast<PacketSink> (sinkApplications.Get (index))->GetTotalRx ();
     // std::cout << "Bytes received: " << totalBytesThrough << std::endl;
     throughput += ((totalBytesThrough * 8) / (simulationTime * 1000000.0)); //Mbit/s 
   }
 
+  // Calculate the mean delay of all flows
+  Time delaySum;
+  uint64_t rxPackets = 0;
+  std::map<FlowId, FlowMonitor::FlowStats> flowStats = monitor->GetFlowStats ();
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = flowStats.begin (); i != flowStats.end (); ++i)
+  {
+    delaySum += i->second.delaySum;
+    rxPackets += i->second.rxPackets;
+  }
+
   //Print results
   std::cout << "Results: " << std::endl;
   std::cout << "- network throughput: " << throughput << " Mbit/s" << std::endl;
+  if (rxPackets > 0) {
+    std::cout << "- mean delay: " << delaySum.GetSeconds () * 1000 / rxPackets << " ms" << std::endl;
+  }
 
   //Clean-up
+  if (sharedDelivery)
+    {
+      shareddelivery::PrintStatistics (std::cout);
+    }
   Simulator::Destroy ();
 
   return 0;
@@ -42,6 +42,8 @@
 #include <chrono>  // For high resolution clock
 #include "ns3/config-store.h"
 #include "ns3/traffic-control-module.h"
+#include "object-census.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
 
 // Course: Simulation Methods (Metody symulacyjne)
 // Lab exercise: 7
@@ -75,6 +77,8 @@ int main (int argc, char *argv[])
   int gi = 800; //Default guard interval [ns]
   int antennas = 2;
   uint32_t offeredLoad = 150;
+  std::string censusFile = ""; //Live object census report, disabled if empty
+  double censusInterval = 1; //Time between census samples [s]
 
   // Parse command line arguments
   CommandLine cmd;
@@ -83,6 +87,8 @@ int main (int argc, char *argv[])
   cmd.AddValue ("channelWidth", "channel width [MHz]", channelWidth);
   cmd.AddValue ("antennas", "no. of tx/rx antennas", antennas);
   cmd.AddValue ("offeredLoad", "offered load of traffic generator [Mb/s]", offeredLoad);
+  cmd.AddValue ("census", "write a live object census to this file", censusFile);
+  cmd.AddValue ("censusInterval", "time between census samples [s]", censusInterval);
   cmd.Parse (argc,argv);
 
   // Print simulation settings to screen
@@ -206,6 +212,13 @@ int main (int argc, char *argv[])
   Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/$ns3::StaWifiMac/BE_MaxAmpduSize", UintegerValue (1048545));
   Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/$ns3::StaWifiMac/BE_MaxAmsduSize", UintegerValue (7935));
 
+  // Sample the live objects at the end of setup and during the run
+  ObjectCensus census;
+  if (!censusFile.empty ())
+    {
+      census.Start (censusFile, Seconds (censusInterval));
+    }
+
   // Print information that the simulation will be executed
   std::clog << std::endl << "Starting simulation... ";
   // Record start time
@@ -219,6 +232,10 @@ int main (int argc, char *argv[])
   std::clog << ("done!") << std::endl;  
   std::chrono::duration<double> elapsed = finish - start;
   std::cout << "Elapsed time: " << elapsed.count() << " s\n\n";
+  if (!censusFile.empty ())
+    {
+      census.Finish ();
+    }
   
   // Calculate throughput
   double throughput = 0;
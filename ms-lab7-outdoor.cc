@@ -34,9 +34,21 @@
 #include "ns3/csma-module.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/ipv4-address.h"
+#include "partitioned-simulator-impl.h"
+// Selectable with --SchedulerType=ns3::LadderScheduler; the event times of a
+// run are recorded with --SchedulerType=ns3::RecordingScheduler
+#include "ladder-scheduler.h"
+#include "recording-scheduler.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
+#include "shared-delivery-yans-wifi-phy.h"
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
+#include "instant-on.h"
+#include "multi-port-sink.h"
 
 #include <iostream>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <math.h>
 #include <string>
 #include <fstream>
@@ -44,6 +56,7 @@
 #include <ctime>
 #include <iomanip>
 #include <sys/stat.h>
+#include <chrono>
 
 // This is an implementation of the TGax (HEW) outdoor scenario.
 using namespace std;
@@ -57,9 +70,11 @@ int countAPs(int layers); // Count the number of APs per layer
 double **calculateAPpositions(int h, int layers); // Calculate the positions of AP
 void placeNodes(double **xy,NodeContainer &Nodes); // Place each node in 2D plane (X,Y)
 double **calculateSTApositions(double x_ap, double y_ap, int h, int n_stations); //calculate positions of the stations
-void installTrafficGenerator(Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, int port, std::string offeredLoad, int packetSize, int simulationTime, int warmupTime);
+void installTrafficGenerator(Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, int port, std::string offeredLoad, int packetSize, int simulationTime, double warmupTime, bool installSink);
 void showPosition(NodeContainer &Nodes); // Show AP's positions (only in debug mode)
-void PopulateARPcache ();
+void PopulateARPcache (Ptr<PartitionedSimulatorImpl> impl); // One cache per partition when impl is set
+uint32_t cellPartition(double x, double y, int partitions); // Partition of the hex cell centred at (x,y)
+void setPartitionLookaheads(NodeContainer &Nodes, Ptr<PartitionedSimulatorImpl> impl, double range, Time preamble); // Lookahead of each pair of partitions
 
 bool fileExists(const std::string& filename)
 {
@@ -89,9 +104,13 @@ int main (int argc, char *argv[])
     string mcs;
     std::string offeredLoad = "1"; //Mbps
     int simulationTime = 10;
-    int warmupTime = 1;
+    double warmupTime = -1; // [s], 1 by default, 0.1 with --instantOn
     int packetSize = 1472;
     std::string outputCsv = "ms-lab7-outdoor.csv";
+    int partitions = 0; // Spatial partitions of the hex grid (0 = default simulator)
+    bool sharedDelivery = false; // Deliver one shared PPDU per frame, see shared-delivery-yans-wifi-phy.h
+    bool instantOn = false; // Active probing, keep-alive beacons and Block Ack set up on association, see instant-on.h
+    bool multiPortSink = false; // One sink application per AP for all its flows, see multi-port-sink.h
     /* Command line parameters */
 
     CommandLine cmd;
@@ -105,9 +124,23 @@ int main (int argc, char *argv[])
     cmd.AddValue ("pcap", "Enable PCAP generation", pcap);
     cmd.AddValue ("offeredLoad", "Offered Load [Mbps]", offeredLoad);
     cmd.AddValue ("packetSize", "Packet size [s]", packetSize);
-    cmd.AddValue ("warmupTime", "Warm-up time [s]", warmupTime);
+    cmd.AddValue ("warmupTime", "Warm-up time [s] (default: 1, or 0.1 with --instantOn)", warmupTime);
+    cmd.AddValue ("partitions", "Number of spatial partitions of the hex grid, each on its own thread if the network module is thread-safe (0 = off)", partitions);
+    cmd.AddValue ("sharedDelivery", "Deliver frames as one shared PPDU, skipping receivers below sensitivity", sharedDelivery);
+    cmd.AddValue ("multiPortSink", "Receive the flows of each AP with one sink application", multiPortSink);
+    cmd.AddValue ("instantOn", "Associate and set up Block Ack within the first 100 ms, with keep-alive beacons; the applications then start after 0.1 s", instantOn);
     cmd.Parse (argc,argv);
 
+    if (warmupTime < 0) { // The STAs are associated after 1 s, or 0.1 s with instant-on
+	warmupTime = instantOn ? 0.1 : 1;
+    }
+
+    /* Select the partitioned simulator before any event is scheduled */
+
+    if (partitions > 0) {
+	GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::PartitionedSimulatorImpl"));
+    }
+
     int APs =  countAPs(layers);
 
     /* Enable or disable RTS/CTS */
@@ -167,11 +200,26 @@ int main (int argc, char *argv[])
 	}
     }
 
+    /* Assign each hex cell (AP and its stations) to a partition */
+
+    Ptr<PartitionedSimulatorImpl> partitionedImpl;
+    if (partitions > 0)
+    {
+	partitionedImpl = DynamicCast<PartitionedSimulatorImpl> (Simulator::GetImplementation ());
+	for(int APindex = 0; APindex < APs; ++APindex)
+	{
+	    uint32_t partition = cellPartition(APpositions[0][APindex], APpositions[1][APindex], partitions);
+	    partitionedImpl->SetPartition (wifiApNodes.Get(APindex)->GetId (), partition);
+	    for(int j = 0; j < stations; ++j)
+		partitionedImpl->SetPartition (wifiStaNodes[APindex].Get(j)->GetId (), partition);
+	}
+    }
+
     /* Configure propagation model */
 
     WifiMacHelper wifiMac;
     WifiHelper wifiHelper;
-    YansWifiPhyHelper wifiPhy;
+    SharedDeliveryPhyHelper wifiPhy (sharedDelivery || partitions > 0); // Partitions need SharedDeliveryYansWifiPhy
 
     if (phy == "ac"){
 	if(highMcs == 1)
@@ -274,6 +322,14 @@ int main (int argc, char *argv[])
 	staDevices[i].Add(staDevice);
     }
 
+    if (instantOn) {
+	InstantOnHelper instantOnHelper;
+	instantOnHelper.AddBlockAckTid (0x70 >> 5); // ToS of installTrafficGenerator, AC_BE
+	for(int i = 0; i < APs; ++i) {
+	    instantOnHelper.Install (apDevices.Get(i), staDevices[i]);
+	}
+    }
+
     /* Configure Internet stack */
 
     InternetStackHelper stack;
@@ -313,14 +369,25 @@ int main (int argc, char *argv[])
 
     /* PopulateArpCache  */
 
-    PopulateARPcache ();
+    PopulateARPcache (partitionedImpl);
 
     /* Configure applications */
 
     int port=9;
     for(int i = 0; i < APs; ++i){
 	for(int j = 0; j < stations; ++j)
-	    installTrafficGenerator(wifiStaNodes[i].Get(j),wifiApNodes.Get(i), port++, offeredLoad, packetSize, simulationTime, warmupTime);
+	    installTrafficGenerator(wifiStaNodes[i].Get(j),wifiApNodes.Get(i), multiPortSink ? 9 : port++, offeredLoad, packetSize, simulationTime, warmupTime, !multiPortSink);
+    }
+
+    if (multiPortSink) { // One sink per AP for the flows of all its stations, on port 9
+	for(int i = 0; i < APs; ++i) {
+	    Ipv4Address addr = wifiApNodes.Get(i)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+	    MultiPortSinkHelper multiPortSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (addr, 9), 1);
+	    multiPortSinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+	    ApplicationContainer sinkApplications = multiPortSinkHelper.Install (wifiApNodes.Get(i));
+	    sinkApplications.Start (Seconds (warmupTime));
+	    sinkApplications.Stop (Seconds (simulationTime));
+	}
     }
 
 
@@ -336,13 +403,89 @@ int main (int argc, char *argv[])
 	}
     }
 
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
+    // One monitor per partition, as the monitors are not thread-safe; the
+    // flows of a BSS all stay in its partition
+    int monitors = partitionedImpl ? partitionedImpl->GetNPartitions () : 1;
+    std::vector<FlowMonitorHelper> flowmon (monitors);
+    std::vector<Ptr<FlowMonitor> > monitor (monitors);
+    for(int m = 0; m < monitors; ++m)
+    {
+	NodeContainer monitored;
+	for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
+	    if (!partitionedImpl || partitionedImpl->GetPartition ((*i)->GetId ()) == static_cast<uint32_t> (m))
+		monitored.Add (*i);
+	flowmon[m].Install (monitored);
+	monitor[m] = flowmon[m].GetMonitor ();
+    }
+
+    /* Derive the lookaheads from the node placement */
+
+    if (partitions > 1)
+    {
+	// Frames reach other partitions one preamble and header late (see
+	// shared-delivery-yans-wifi-phy.h); the shortest is that of the
+	// non-HT frames sent at the basic rate
+	WifiTxVector txVector;
+	txVector.SetMode (WifiMode (mcs));
+	txVector.SetChannelWidth (channelWidth);
+	txVector.SetNss (1);
+	txVector.SetPreambleType (phy == "ax" ? WIFI_PREAMBLE_HE_SU : (phy == "ac" ? WIFI_PREAMBLE_VHT_SU : WIFI_PREAMBLE_HT_MF));
+	WifiTxVector basicTxVector;
+	basicTxVector.SetMode (WifiPhy::GetOfdmRate6Mbps ());
+	basicTxVector.SetChannelWidth (20);
+	basicTxVector.SetNss (1);
+	basicTxVector.SetPreambleType (WIFI_PREAMBLE_LONG);
+	Time preamble = std::min (WifiPhy::CalculatePhyPreambleAndHeaderDuration (txVector),
+				  WifiPhy::CalculatePhyPreambleAndHeaderDuration (basicTxVector));
+
+	NodeContainer allNodes = NodeContainer::GetGlobal ();
+	setPartitionLookaheads(allNodes, partitionedImpl, h, preamble);
+	SharedDeliveryPhyHelper::SetPartitions (partitionedImpl);
+    }
 
     /* Run simulation */
 
     Simulator::Stop(Seconds(simulationTime));
+    auto start = std::chrono::high_resolution_clock::now();
     Simulator::Run ();
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    if (partitionedImpl)
+    {
+	std::cout << "Elapsed time: " << elapsed.count() << " s on "
+		  << (partitionedImpl->IsThreaded () ? partitionedImpl->GetNPartitions () : 1) << " thread(s)" << std::endl;
+	if (partitions > 1) {
+	    // Not comparable with --partitions=1, which hears every frame on time
+	    std::cout << "Frames reach other partitions one preamble and header duration late, so this is a different simulation from --partitions=1" << std::endl
+		      << "Speedup: " << partitionedImpl->GetSpeedup () << " over the same partitioned run on one thread"
+		      << " (estimated from the busy time of the threads; measure it with --ns3::PartitionedSimulatorImpl::Threaded=0)" << std::endl;
+	}
+	partitionedImpl->PrintStatistics (std::cout);
+	if (debug)
+	{
+	    for(uint32_t p = 0; p < partitionedImpl->GetNPartitions (); ++p)
+		for(uint32_t q = 0; q < partitionedImpl->GetNPartitions (); ++q)
+		    if (p != q)
+			std::cout << "  lookahead " << p << " -> " << q << ": "
+				  << partitionedImpl->GetLookahead (p, q).GetSeconds () * 1e6 << " us" << std::endl;
+	}
+    }
+
+    if (sharedDelivery || partitions > 0)
+    {
+	shareddelivery::PrintStatistics (std::cout);
+    }
+
+    if (instantOn)
+    {
+	instanton::PrintStatistics (std::cout);
+	const instanton::Statistics &instantOnStats = instanton::GetStatistics ();
+	if (instantOnStats.associations < instantOnStats.stations
+	    || TimeStep (instantOnStats.lastAssociation.load ()) > Seconds (warmupTime)) {
+	    std::cout << "Warning: not all the stations were associated when the applications started, increase --warmupTime" << std::endl;
+	}
+    }
 
     /* Calculate results */
     double flowThr;
@@ -360,8 +503,9 @@ int main (int argc, char *argv[])
 
     double totalThr=0;
 
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+    for(int m = 0; m < monitors; ++m) {
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon[m].GetClassifier ());
+    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor[m]->GetFlowStats ();
     for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i) {
 	auto time = std::time(nullptr); //Get timestamp
 	auto tm = *std::localtime(&time);
@@ -373,6 +517,7 @@ int main (int argc, char *argv[])
 	myfile << std::endl;
 	totalThr += flowThr;
     }
+    }
     myfile.close();
 
     //Print results
@@ -583,9 +728,66 @@ double **calculateSTApositions(double x_ap, double y_ap, int h, int n_stations)
     return sta_co;
 }
 
-void PopulateARPcache () {
-    Ptr<ArpCache> arp = CreateObject<ArpCache> ();
-    arp->SetAliveTimeout (Seconds (3600 * 24 * 365) );
+uint32_t cellPartition(double x, double y, int partitions) {
+    // Cells are grouped into angular sectors around the grid centre, so
+    // that neighbouring cells mostly share a partition
+    if (partitions <= 1 || (x == 0 && y == 0))
+	return 0;
+    double angle = atan2(y, x);
+    if (angle < 0)
+	angle += 2 * M_PI;
+    return std::min (static_cast<int> (angle / (2 * M_PI / partitions)), partitions - 1);
+}
+
+void setPartitionLookaheads(NodeContainer &Nodes, Ptr<PartitionedSimulatorImpl> impl, double range, Time preamble) {
+    // A frame reaches another partition after the propagation delay plus
+    // the preamble and header.  The nodes are hashed into squares of side
+    // range, and only the nodes of neighbouring squares are compared:
+    // partitions with no nodes in neighbouring squares are at least range
+    // apart.
+    DoubleValue speed;
+    CreateObject<ConstantSpeedPropagationDelayModel> ()->GetAttribute ("Speed", speed);
+    std::map<std::pair<int, int>, std::vector<uint32_t> > squares;
+    for(uint32_t i = 0; i < Nodes.GetN (); ++i)
+    {
+	Vector position = Nodes.Get(i)->GetObject<MobilityModel> ()->GetPosition ();
+	squares[std::make_pair (static_cast<int> (floor (position.x / range)), static_cast<int> (floor (position.y / range)))].push_back (i);
+    }
+    uint32_t n = impl->GetNPartitions ();
+    std::vector<double> minDistance (n * n, range);
+    for (const auto &square : squares)
+	for(int dx = -1; dx <= 1; ++dx)
+	    for(int dy = -1; dy <= 1; ++dy)
+	    {
+		auto neighbour = squares.find (std::make_pair (square.first.first + dx, square.first.second + dy));
+		if (neighbour == squares.end ())
+		    continue;
+		for (uint32_t i : square.second)
+		{
+		    uint32_t p = impl->GetPartition (Nodes.Get(i)->GetId ());
+		    Ptr<MobilityModel> a = Nodes.Get(i)->GetObject<MobilityModel> ();
+		    for (uint32_t j : neighbour->second)
+		    {
+			uint32_t q = impl->GetPartition (Nodes.Get(j)->GetId ());
+			if (p != q)
+			    minDistance[p * n + q] = std::min (minDistance[p * n + q], a->GetDistanceFrom (Nodes.Get(j)->GetObject<MobilityModel> ()));
+		    }
+		}
+	    }
+    for(uint32_t p = 0; p < n; ++p)
+	for(uint32_t q = 0; q < n; ++q)
+	    if (p != q)
+		impl->SetLookahead (p, q, Seconds (minDistance[p * n + q] / speed.Get ()) + preamble);
+}
+
+void PopulateARPcache (Ptr<PartitionedSimulatorImpl> impl) {
+    // The partitions may run on their own threads, so they cannot share a cache
+    std::vector<Ptr<ArpCache> > arps (impl ? impl->GetNPartitions () : 1);
+    for (Ptr<ArpCache> &arp : arps)
+    {
+	arp = CreateObject<ArpCache> ();
+	arp->SetAliveTimeout (Seconds (3600 * 24 * 365) );
+    }
 
     for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
     {
@@ -608,12 +810,15 @@ void PopulateARPcache () {
 		if (ipAddr == Ipv4Address::GetLoopback ())
 		    continue;
 
-		ArpCache::Entry *entry = arp->Add (ipAddr);
-		Ipv4Header ipv4Hdr;
-		ipv4Hdr.SetDestination (ipAddr);
-		Ptr<Packet> p = Create<Packet> (100);
-		entry->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (p, ipv4Hdr));
-		entry->MarkAlive (addr);
+		for (Ptr<ArpCache> &arp : arps)
+		{
+		    ArpCache::Entry *entry = arp->Add (ipAddr);
+		    Ipv4Header ipv4Hdr;
+		    ipv4Hdr.SetDestination (ipAddr);
+		    Ptr<Packet> p = Create<Packet> (100);
+		    entry->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (p, ipv4Hdr));
+		    entry->MarkAlive (addr);
+		}
 	    }
 	}
     }
@@ -628,12 +833,12 @@ void PopulateARPcache () {
 	for (ObjectVectorValue::Iterator j = interfaces.Begin (); j != interfaces.End (); j ++)
 	{
 	    Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
-	    ipIface->SetAttribute ("ArpCache", PointerValue (arp) );
+	    ipIface->SetAttribute ("ArpCache", PointerValue (arps[impl ? impl->GetPartition ((*i)->GetId ()) : 0]) );
 	}
     }
 }
 
-void installTrafficGenerator(Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, int port, std::string offeredLoad, int packetSize, int simulationTime, int warmupTime ) {
+void installTrafficGenerator(Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, int port, std::string offeredLoad, int packetSize, int simulationTime, double warmupTime, bool installSink ) {
 
     Ptr<Ipv4> ipv4 = toNode->GetObject<Ipv4> (); // Get Ipv4 instance of the node
     Ipv4Address addr = ipv4->GetAddress (1, 0).GetLocal (); // Get Ipv4InterfaceAddress of xth interface.
@@ -653,9 +858,14 @@ void installTrafficGenerator(Ptr<ns3::Node> fromNode, Ptr<ns3::Node> toNode, int
     sinkSocket.SetTos (tosValue);
     OnOffHelper onOffHelper ("ns3::UdpSocketFactory", sinkSocket);
     onOffHelper.SetConstantRate (DataRate (offeredLoad + "Mbps"), packetSize);
+    if (!installSink) { // Timestamp the packets for the delays of the shared sink
+	onOffHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+    }
     sourceApplications.Add (onOffHelper.Install (fromNode)); //fromNode
-    PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket);
-    sinkApplications.Add (packetSinkHelper.Install (toNode)); //toNode
+    if (installSink) {
+	PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkSocket);
+	sinkApplications.Add (packetSinkHelper.Install (toNode)); //toNode
+    }
 
     sinkApplications.Start (Seconds (warmupTime));
     sinkApplications.Stop (Seconds (simulationTime));
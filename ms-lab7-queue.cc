@@ -30,6 +30,14 @@
 #include "ns3/flow-monitor-module.h"
 #include "ns3/config-store.h"
 
+// Selectable with --SchedulerType=ns3::LadderScheduler; the event times of a
+// run are recorded with --SchedulerType=ns3::RecordingScheduler
+#include "ladder-scheduler.h"
+#include "recording-scheduler.h"
+#include "pooled-event.h"
+#include "profiling-simulator-impl.h" // Per-event profile: --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("MS-LAB7-QUEUE");
@@ -50,7 +58,7 @@ static void GenerateTraffic (Ptr<Socket> socket, Ptr<ExponentialRandomVariable>
     socket->Send (Create<Packet> (pktSize));
 
     Time pktInterval = Seconds(randomTime->GetValue ()); //Get random value for next packet generation time 
-    Simulator::Schedule (pktInterval, &GenerateTraffic, socket, randomSize, randomTime); //Schedule next packet generation
+    SchedulePooled (pktInterval, &GenerateTraffic, socket, randomSize, randomTime); //Schedule next packet generation (pooled event, see pooled-event.h)
 }
 
 int main (int argc, char *argv[])
@@ -59,12 +67,14 @@ int main (int argc, char *argv[])
     double mu = 330;
     double lambda = 300;
     uint32_t queueSize = 1000;
+    bool eventPoolStats = false;
 
     CommandLine cmd;
     cmd.AddValue ("simulationTime", "Simulation time [s]", simulationTime);
     cmd.AddValue ("queueSize", "Size of queue [no. of packets]", queueSize);
     cmd.AddValue ("lambda", "Arrival rate [packets/s]", lambda);
     cmd.AddValue ("mu", "Service rate [packets/s]", mu);
+    cmd.AddValue ("eventPoolStats", "Print the heap allocations avoided by pooled events", eventPoolStats);
     cmd.Parse (argc, argv);
 
     NS_ASSERT_MSG (queueSize > 1, "This implementation does not support a queue size than 2.");
@@ -121,7 +131,7 @@ int main (int argc, char *argv[])
     Ptr<ExponentialRandomVariable> randomSize = CreateObject<ExponentialRandomVariable> ();
     randomSize->SetAttribute ("Mean", DoubleValue (mean));
 
-    Simulator::ScheduleWithContext (source->GetNode ()->GetId (), Seconds (1.0), &GenerateTraffic, source, randomSize, randomTime);
+    SchedulePooledWithContext (source->GetNode ()->GetId (), Seconds (1.0), &GenerateTraffic, source, randomSize, randomTime);
 
     FlowMonitorHelper flowmon;
     Ptr<FlowMonitor> monitor = flowmon.InstallAll();
@@ -162,6 +172,11 @@ int main (int argc, char *argv[])
     std::cout << "  Queue blocking probability:\t" << (float) packetsDroppedByQueueDisc/stats[1].txPackets << std::endl;
     std::cout << "  Throughput: " << stats[1].rxBytes * 8.0 / (stats[1].timeLastRxPacket.GetSeconds () - stats[1].timeFirstRxPacket.GetSeconds ()) / 1000000 << " Mbps" << std::endl;
     /* End of statistics calculation */
+
+    if (eventPoolStats)
+    {
+	eventpool::PrintStatistics (std::cout);
+    }
     
     Simulator::Destroy ();
 
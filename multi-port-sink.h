@@ -0,0 +1,370 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MULTI_PORT_SINK_H
+#define MULTI_PORT_SINK_H
+
+// Sink application for all the flows of a node.
+//
+// ms-lab4, ms-lab6 and ms-lab7-outdoor install one PacketSink per flow on
+// the AP, each listening on its own port (9, 10, 11 and so on), so the AP
+// gets as many applications, Rx trace sources and per-application
+// counters as there are stations.  MultiPortSink listens on Ports
+// consecutive ports from the port of Local, with one socket per port,
+// all reading into one application.  The sockets are needed because an
+// ns-3 socket binds a single port.  Flows may also share a port, Ports
+// being then 1: the scenarios send all their flows to port 9 of the AP,
+// which tells them apart by their source address, and enable
+// EnableSeqTsSizeHeader on the sources and on the sink.
+//
+// Its counters are kept per flow, a flow being a source address and port
+// and the local port it was sent to, in a flat table in the order of the
+// first packet of each flow: received bytes and packets, first and last
+// reception time and, with EnableSeqTsSizeHeader set on the sink and on
+// the sources (OnOffApplication has the same attribute), the sum of the
+// delays.  Delays are only measured for UDP, where every packet starts
+// with the header.  GetTotalRx gives the total, like PacketSink, and
+// GetFlow the counters of one flow.
+//
+// Scenarios install it with MultiPortSinkHelper instead of one
+// PacketSinkHelper per flow.
+
+#include "ns3/application.h"
+#include "ns3/application-container.h"
+#include "ns3/node.h"
+#include "ns3/node-container.h"
+#include "ns3/socket.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/address.h"
+#include "ns3/packet.h"
+#include "ns3/object-factory.h"
+#include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
+#include "ns3/type-id.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/traced-callback.h"
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+
+#include <stdint.h>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+namespace multiportsink {
+
+struct FlowStats
+{
+  InetSocketAddress source = InetSocketAddress (Ipv4Address::GetAny (), 0);
+  uint16_t localPort = 0;
+  uint64_t rxBytes = 0;
+  uint64_t rxPackets = 0;
+  Time timeFirstRx;
+  Time timeLastRx;
+  Time delaySum;                    //!< with EnableSeqTsSizeHeader
+  uint64_t delayedPackets = 0;      //!< packets with a delay in delaySum
+};
+
+/// \returns the key of a flow in the index of the table
+inline uint64_t
+GetFlowKey (const InetSocketAddress &source, uint16_t localPort)
+{
+  return (uint64_t (source.GetIpv4 ().Get ()) << 32) | (uint64_t (source.GetPort ()) << 16) | localPort;
+}
+
+} // namespace multiportsink
+
+class MultiPortSink : public Application
+{
+public:
+  static TypeId GetTypeId (void);
+
+  MultiPortSink ();
+  virtual ~MultiPortSink ();
+
+  /// \returns the bytes received by all the flows
+  uint64_t GetTotalRx (void) const;
+  uint32_t GetNFlows (void) const;
+  /// \returns the counters of the i-th flow, in the order of their first packet
+  const multiportsink::FlowStats &GetFlow (uint32_t i) const;
+  /// \returns the counters of the flow, or 0 if it has not been received
+  const multiportsink::FlowStats *FindFlow (const InetSocketAddress &source, uint16_t localPort) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void HandleRead (Ptr<Socket> socket);
+  void HandleAccept (Ptr<Socket> socket, const Address &from);
+  void HandlePeerClose (Ptr<Socket> socket);
+  void HandlePeerError (Ptr<Socket> socket);
+  void Receive (Ptr<const Packet> packet, const InetSocketAddress &source, uint16_t localPort);
+
+  TypeId m_tid;                     //!< protocol of the sockets
+  Address m_local;                  //!< address and first port
+  uint32_t m_nPorts;
+  bool m_enableSeqTsSizeHeader;
+  std::vector<Ptr<Socket> > m_sockets;          //!< listening sockets
+  std::list<Ptr<Socket> > m_acceptedSockets;
+  std::vector<multiportsink::FlowStats> m_flows;
+  std::unordered_map<uint64_t, uint32_t> m_index;
+  uint64_t m_totalRx;
+
+  TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (MultiPortSink);
+
+inline TypeId
+MultiPortSink::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MultiPortSink")
+    .SetParent<Application> ()
+    .AddConstructor<MultiPortSink> ()
+    .AddAttribute ("Local",
+                   "The address on which to bind the sockets, with the first port",
+                   AddressValue (),
+                   MakeAddressAccessor (&MultiPortSink::m_local),
+                   MakeAddressChecker ())
+    .AddAttribute ("Ports",
+                   "The number of consecutive ports to listen on",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&MultiPortSink::m_nPorts),
+                   MakeUintegerChecker<uint32_t> (1, 65535))
+    .AddAttribute ("Protocol",
+                   "The type id of the protocol to use for the rx sockets",
+                   TypeIdValue (UdpSocketFactory::GetTypeId ()),
+                   MakeTypeIdAccessor (&MultiPortSink::m_tid),
+                   MakeTypeIdChecker ())
+    .AddAttribute ("EnableSeqTsSizeHeader",
+                   "Measure the delays from the SeqTsSizeHeader of the packets (UDP only)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MultiPortSink::m_enableSeqTsSizeHeader),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("Rx",
+                     "A packet has been received",
+                     MakeTraceSourceAccessor (&MultiPortSink::m_rxTrace),
+                     "ns3::Packet::AddressTracedCallback")
+  ;
+  return tid;
+}
+
+inline
+MultiPortSink::MultiPortSink ()
+  : m_nPorts (1),
+    m_enableSeqTsSizeHeader (false),
+    m_totalRx (0)
+{
+}
+
+inline
+MultiPortSink::~MultiPortSink ()
+{
+}
+
+inline void
+MultiPortSink::DoDispose (void)
+{
+  m_sockets.clear ();
+  m_acceptedSockets.clear ();
+  Application::DoDispose ();
+}
+
+inline uint64_t
+MultiPortSink::GetTotalRx (void) const
+{
+  return m_totalRx;
+}
+
+inline uint32_t
+MultiPortSink::GetNFlows (void) const
+{
+  return m_flows.size ();
+}
+
+inline const multiportsink::FlowStats &
+MultiPortSink::GetFlow (uint32_t i) const
+{
+  NS_ASSERT (i < m_flows.size ());
+  return m_flows[i];
+}
+
+inline const multiportsink::FlowStats *
+MultiPortSink::FindFlow (const InetSocketAddress &source, uint16_t localPort) const
+{
+  auto it = m_index.find (multiportsink::GetFlowKey (source, localPort));
+  return it != m_index.end () ? &m_flows[it->second] : 0;
+}
+
+inline void
+MultiPortSink::StartApplication (void)
+{
+  NS_ABORT_MSG_UNLESS (InetSocketAddress::IsMatchingType (m_local), "MultiPortSink listens on IPv4 addresses only");
+  NS_ABORT_MSG_IF (m_enableSeqTsSizeHeader && m_tid != UdpSocketFactory::GetTypeId (),
+                   "Delays are only measured for UDP");
+  InetSocketAddress local = InetSocketAddress::ConvertFrom (m_local);
+  NS_ABORT_MSG_IF (local.GetPort () + m_nPorts > 65536, "The ports go beyond 65535");
+  if (m_sockets.empty ())
+    {
+      for (uint32_t i = 0; i < m_nPorts; i++)
+        {
+          Ptr<Socket> socket = Socket::CreateSocket (GetNode (), m_tid);
+          if (socket->Bind (InetSocketAddress (local.GetIpv4 (), local.GetPort () + i)) == -1)
+            {
+              NS_FATAL_ERROR ("Failed to bind socket to port " << local.GetPort () + i);
+            }
+          socket->Listen ();
+          socket->ShutdownSend ();
+          m_sockets.push_back (socket);
+        }
+    }
+  for (Ptr<Socket> socket : m_sockets)
+    {
+      socket->SetRecvCallback (MakeCallback (&MultiPortSink::HandleRead, this));
+      socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                 MakeCallback (&MultiPortSink::HandleAccept, this));
+      socket->SetCloseCallbacks (MakeCallback (&MultiPortSink::HandlePeerClose, this),
+                                 MakeCallback (&MultiPortSink::HandlePeerError, this));
+    }
+}
+
+inline void
+MultiPortSink::StopApplication (void)
+{
+  while (!m_acceptedSockets.empty ())
+    {
+      Ptr<Socket> socket = m_acceptedSockets.front ();
+      m_acceptedSockets.pop_front ();
+      socket->Close ();
+    }
+  for (Ptr<Socket> socket : m_sockets)
+    {
+      socket->Close ();
+      socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+    }
+}
+
+inline void
+MultiPortSink::HandleRead (Ptr<Socket> socket)
+{
+  Address localAddress;
+  socket->GetSockName (localAddress);
+  uint16_t localPort = InetSocketAddress::ConvertFrom (localAddress).GetPort ();
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      if (packet->GetSize () == 0)
+        {
+          // EOF
+          break;
+        }
+      Receive (packet, InetSocketAddress::ConvertFrom (from), localPort);
+      m_rxTrace (packet, from);
+    }
+}
+
+inline void
+MultiPortSink::Receive (Ptr<const Packet> packet, const InetSocketAddress &source, uint16_t localPort)
+{
+  uint64_t key = multiportsink::GetFlowKey (source, localPort);
+  auto it = m_index.find (key);
+  if (it == m_index.end ())
+    {
+      it = m_index.insert (std::make_pair (key, m_flows.size ())).first;
+      m_flows.push_back (multiportsink::FlowStats ());
+      m_flows.back ().source = source;
+      m_flows.back ().localPort = localPort;
+      m_flows.back ().timeFirstRx = Simulator::Now ();
+    }
+  multiportsink::FlowStats &flow = m_flows[it->second];
+  flow.rxBytes += packet->GetSize ();
+  flow.rxPackets++;
+  flow.timeLastRx = Simulator::Now ();
+  m_totalRx += packet->GetSize ();
+
+  SeqTsSizeHeader header;
+  if (m_enableSeqTsSizeHeader && packet->GetSize () >= header.GetSerializedSize ())
+    {
+      packet->PeekHeader (header);
+      flow.delaySum += Simulator::Now () - header.GetTs ();
+      flow.delayedPackets++;
+    }
+}
+
+inline void
+MultiPortSink::HandleAccept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&MultiPortSink::HandleRead, this));
+  m_acceptedSockets.push_back (socket);
+}
+
+inline void
+MultiPortSink::HandlePeerClose (Ptr<Socket> socket)
+{
+}
+
+inline void
+MultiPortSink::HandlePeerError (Ptr<Socket> socket)
+{
+}
+
+class MultiPortSinkHelper
+{
+public:
+  /**
+   * \param protocol the type id of the socket factory, as for PacketSinkHelper
+   * \param local the address to listen on, with the first port
+   * \param nPorts the number of consecutive ports
+   */
+  MultiPortSinkHelper (std::string protocol, Address local, uint32_t nPorts)
+  {
+    m_factory.SetTypeId ("ns3::MultiPortSink");
+    m_factory.Set ("Protocol", StringValue (protocol));
+    m_factory.Set ("Local", AddressValue (local));
+    m_factory.Set ("Ports", UintegerValue (nPorts));
+  }
+
+  void SetAttribute (std::string name, const AttributeValue &value)
+  {
+    m_factory.Set (name, value);
+  }
+
+  ApplicationContainer Install (Ptr<Node> node) const
+  {
+    Ptr<Application> sink = m_factory.Create<Application> ();
+    node->AddApplication (sink);
+    return ApplicationContainer (sink);
+  }
+
+private:
+  ObjectFactory m_factory;
+};
+
+} // namespace ns3
+
+#endif /* MULTI_PORT_SINK_H */
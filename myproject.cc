@@ -38,6 +38,7 @@
 #include "ns3/qos-txop.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/rng-seed-manager.h"
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -0,0 +1,297 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OBJECT_CENSUS_H
+#define OBJECT_CENSUS_H
+
+// Live object census: which objects hold the memory of a simulation.
+//
+// A census walks every Object reachable from the NodeList and the
+// ChannelList, through aggregation and through Pointer and ObjectVector/
+// ObjectMap attributes (the same graph the Config paths use), and counts
+// the objects by TypeId.  Object bytes are sizeof the registered type;
+// the buffers, metadata and tags an object owns are not included, except
+// for packets in queues: every QueueBase found adds its packets, with
+// their bytes plus PACKET_OVERHEAD bytes per packet for the Packet,
+// queue item, buffer header and tag list.
+//
+// ObjectCensus::Start samples once at the end of setup, then every
+// interval during Simulator::Run, and once more after Run; each sample
+// records the resident set size read from /proc/self/status.  The sample
+// taken at the highest RSS is kept.  The report (top-N types per sample)
+// is written to the given file.  The periodic samples keep an event
+// pending, so the scenario must end with Simulator::Stop.
+
+#include "ns3/object.h"
+#include "ns3/node-list.h"
+#include "ns3/channel-list.h"
+#include "ns3/node.h"
+#include "ns3/channel.h"
+#include "ns3/pointer.h"
+#include "ns3/object-ptr-container.h"
+#include "ns3/queue.h"
+#include "ns3/simulator.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+namespace census {
+
+/// Approximate bytes besides the payload of a queued packet
+const uint64_t PACKET_OVERHEAD = 256;
+
+struct TypeCount
+{
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+};
+
+struct Sample
+{
+  std::string label;
+  Time time;
+  uint64_t rssKb = 0;
+  uint64_t objects = 0;
+  uint64_t objectBytes = 0;
+  uint64_t queuedPackets = 0;
+  uint64_t queuedBytes = 0;         //!< payload and PACKET_OVERHEAD
+  std::map<std::string, TypeCount> types;
+};
+
+/// \returns sizeof the type, 0 if it was not registered with its size
+inline uint64_t
+GetTypeSize (TypeId tid)
+{
+  std::size_t size = tid.GetSize ();
+  return size == static_cast<std::size_t> (-1) ? 0 : size;
+}
+
+/// \returns the value of field (in kB) in /proc/self/status, 0 if unknown
+inline uint64_t
+ReadStatusKb (const std::string &field)
+{
+  std::ifstream status ("/proc/self/status");
+  std::string line;
+  while (std::getline (status, line))
+    {
+      if (line.compare (0, field.size (), field) == 0 && line[field.size ()] == ':')
+        {
+          std::istringstream iss (line.substr (field.size () + 1));
+          uint64_t kb = 0;
+          iss >> kb;
+          return kb;
+        }
+    }
+  return 0;
+}
+
+} // namespace census
+
+class ObjectCensus
+{
+public:
+  ObjectCensus ();
+
+  /// Take the setup sample now and schedule the periodic ones
+  void Start (const std::string &fileName, Time interval, uint32_t topN = 10);
+  /// Take the final sample and write the report
+  void Finish (void);
+  /// \returns a census of the live objects
+  census::Sample Take (const std::string &label);
+
+private:
+  void Visit (Ptr<Object> object, census::Sample &sample);
+  void Periodic (void);
+  void Keep (const census::Sample &sample);
+  void Write (std::ostream &os, const census::Sample &sample) const;
+
+  std::string m_fileName;
+  Time m_interval;
+  uint32_t m_topN;
+  std::set<const Object *> m_seen;
+  std::vector<census::Sample> m_samples;
+  census::Sample m_peak;
+  EventId m_event;
+};
+
+inline
+ObjectCensus::ObjectCensus ()
+  : m_topN (10)
+{
+}
+
+inline void
+ObjectCensus::Visit (Ptr<Object> object, census::Sample &sample)
+{
+  if (object == 0 || !m_seen.insert (PeekPointer (object)).second)
+    {
+      return;
+    }
+
+  TypeId tid = object->GetInstanceTypeId ();
+  census::TypeCount &count = sample.types[tid.GetName ()];
+  count.count++;
+  uint64_t size = census::GetTypeSize (tid);
+  count.bytes += size;
+  sample.objects++;
+  sample.objectBytes += size;
+
+  Ptr<QueueBase> queue = DynamicCast<QueueBase> (object);
+  if (queue != 0)
+    {
+      sample.queuedPackets += queue->GetNPackets ();
+      sample.queuedBytes += queue->GetNBytes () + queue->GetNPackets () * census::PACKET_OVERHEAD;
+    }
+
+  Object::AggregateIterator aggregates = object->GetAggregateIterator ();
+  while (aggregates.HasNext ())
+    {
+      Visit (ConstCast<Object> (aggregates.Next ()), sample);
+    }
+
+  for (TypeId t = tid; ; t = t.GetParent ())
+    {
+      for (uint32_t i = 0; i < t.GetAttributeN (); i++)
+        {
+          struct TypeId::AttributeInformation info = t.GetAttribute (i);
+          if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter ())
+            {
+              continue;
+            }
+          if (dynamic_cast<const PointerChecker *> (PeekPointer (info.checker)) != 0)
+            {
+              PointerValue value;
+              if (object->GetAttributeFailSafe (info.name, value))
+                {
+                  Visit (value.Get<Object> (), sample);
+                }
+            }
+          else if (dynamic_cast<const ObjectPtrContainerChecker *> (PeekPointer (info.checker)) != 0)
+            {
+              ObjectPtrContainerValue value;
+              if (object->GetAttributeFailSafe (info.name, value))
+                {
+                  for (ObjectPtrContainerValue::Iterator j = value.Begin (); j != value.End (); j++)
+                    {
+                      Visit (j->second, sample);
+                    }
+                }
+            }
+        }
+      if (t == t.GetParent ())
+        {
+          break;
+        }
+    }
+}
+
+inline census::Sample
+ObjectCensus::Take (const std::string &label)
+{
+  census::Sample sample;
+  sample.label = label;
+  sample.time = Simulator::Now ();
+  sample.rssKb = census::ReadStatusKb ("VmRSS");
+  m_seen.clear ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); i++)
+    {
+      Visit (*i, sample);
+    }
+  for (ChannelList::Iterator i = ChannelList::Begin (); i != ChannelList::End (); i++)
+    {
+      Visit (*i, sample);
+    }
+  m_seen.clear ();
+  return sample;
+}
+
+inline void
+ObjectCensus::Keep (const census::Sample &sample)
+{
+  m_samples.push_back (sample);
+  if (sample.rssKb >= m_peak.rssKb)
+    {
+      m_peak = sample;
+    }
+}
+
+inline void
+ObjectCensus::Start (const std::string &fileName, Time interval, uint32_t topN)
+{
+  m_fileName = fileName;
+  m_interval = interval;
+  m_topN = topN;
+  Keep (Take ("setup"));
+  if (m_interval.IsStrictlyPositive ())
+    {
+      m_event = Simulator::Schedule (m_interval, &ObjectCensus::Periodic, this);
+    }
+}
+
+inline void
+ObjectCensus::Periodic (void)
+{
+  Keep (Take ("run"));
+  m_event = Simulator::Schedule (m_interval, &ObjectCensus::Periodic, this);
+}
+
+inline void
+ObjectCensus::Write (std::ostream &os, const census::Sample &sample) const
+{
+  os << sample.label << " t=" << sample.time.GetSeconds () << "s rss=" << sample.rssKb << "kB objects="
+     << sample.objects << " (" << sample.objectBytes / 1024 << "kB) queued packets=" << sample.queuedPackets
+     << " (~" << sample.queuedBytes / 1024 << "kB)" << std::endl;
+
+  std::vector<std::pair<std::string, census::TypeCount> > types (sample.types.begin (), sample.types.end ());
+  std::sort (types.begin (), types.end (),
+             [] (const std::pair<std::string, census::TypeCount> &a, const std::pair<std::string, census::TypeCount> &b)
+             { return a.second.bytes > b.second.bytes; });
+  for (std::size_t i = 0; i < types.size () && i < m_topN; i++)
+    {
+      os << "  " << std::setw (10) << types[i].second.count << std::setw (10) << types[i].second.bytes / 1024
+         << "kB  " << types[i].first << std::endl;
+    }
+}
+
+inline void
+ObjectCensus::Finish (void)
+{
+  m_event.Cancel ();
+  Keep (Take ("end"));
+
+  std::ofstream os (m_fileName.c_str (), std::ofstream::out);
+  NS_ABORT_MSG_UNLESS (os.is_open (), "Cannot open " << m_fileName);
+  os << "# object census: peak rss " << census::ReadStatusKb ("VmHWM") << "kB" << std::endl;
+  for (const census::Sample &sample : m_samples)
+    {
+      Write (os, sample);
+    }
+  os << "# sample at the highest rss" << std::endl;
+  Write (os, m_peak);
+}
+
+} // namespace ns3
+
+#endif /* OBJECT_CENSUS_H */
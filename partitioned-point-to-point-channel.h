@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PARTITIONED_POINT_TO_POINT_CHANNEL_H
+#define PARTITIONED_POINT_TO_POINT_CHANNEL_H
+
+// Point-to-point channel between two partitions of
+// PartitionedSimulatorImpl.
+//
+// PointToPointChannel hands the receiving device a copy of the packet,
+// which shares its buffer with the packet of the sender, in an event that
+// holds a reference to the device.  Neither is thread-safe once the two
+// devices run on different threads.  When its two ends are in different
+// partitions, PartitionedPointToPointChannel serializes the packet, tags
+// and metadata included, into the reception event instead, and the
+// receiving partition rebuilds it, as the MPI PointToPointRemoteChannel
+// does between ranks.  The event holds no reference counted object, and
+// is scheduled at the same time and in the same order as the one of
+// PointToPointChannel.  Between two nodes of one partition the channel
+// behaves as PointToPointChannel.
+//
+// Install replaces the channel of a link made by PointToPointHelper; it
+// must be called once the nodes are assigned to their partitions and
+// before the routing tables are populated.
+
+#include "ns3/point-to-point-channel.h"
+#include "ns3/point-to-point-net-device.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/abort.h"
+#include "partitioned-simulator-impl.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+class PartitionedPointToPointChannel : public PointToPointChannel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  PartitionedPointToPointChannel ();
+
+  /**
+   * Attach the two devices of a point-to-point link to a new
+   * PartitionedPointToPointChannel with the delay of their channel.
+   * \param link the devices made by PointToPointHelper::Install
+   */
+  static void Install (const NetDeviceContainer &link);
+
+  // Inherited from PointToPointChannel
+  virtual bool TransmitStart (Ptr<const Packet> p, Ptr<PointToPointNetDevice> src, Time txTime);
+
+private:
+  /// Rebuild the packet in the partition of the receiving device
+  void Deliver (uint32_t device, std::vector<uint8_t> bytes);
+
+  // Looked up at installation, so that transmissions touch no reference
+  // count of the other partition
+  PointToPointNetDevice *m_devices[2];
+  uint32_t m_nodes[2];
+  bool m_cross;                     //!< whether the two ends are in different partitions
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PartitionedPointToPointChannel);
+
+inline TypeId
+PartitionedPointToPointChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PartitionedPointToPointChannel")
+    .SetParent<PointToPointChannel> ()
+    .AddConstructor<PartitionedPointToPointChannel> ()
+  ;
+  return tid;
+}
+
+inline
+PartitionedPointToPointChannel::PartitionedPointToPointChannel ()
+  : m_devices {0, 0},
+    m_nodes {0, 0},
+    m_cross (false)
+{
+}
+
+inline void
+PartitionedPointToPointChannel::Install (const NetDeviceContainer &link)
+{
+  NS_ABORT_MSG_UNLESS (link.GetN () == 2, "A point-to-point link has two devices");
+  TimeValue delay;
+  link.Get (0)->GetChannel ()->GetAttribute ("Delay", delay);
+  Ptr<PartitionedPointToPointChannel> channel = CreateObject<PartitionedPointToPointChannel> ();
+  channel->SetAttribute ("Delay", delay);
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<PointToPointNetDevice> device = DynamicCast<PointToPointNetDevice> (link.Get (i));
+      NS_ABORT_MSG_UNLESS (device != 0, "Not a point-to-point device");
+      device->Attach (channel);
+      channel->m_devices[i] = PeekPointer (device);
+      channel->m_nodes[i] = device->GetNode ()->GetId ();
+    }
+  Ptr<PartitionedSimulatorImpl> impl = DynamicCast<PartitionedSimulatorImpl> (Simulator::GetImplementation ());
+  channel->m_cross = impl != 0 && impl->GetPartition (channel->m_nodes[0]) != impl->GetPartition (channel->m_nodes[1]);
+}
+
+inline bool
+PartitionedPointToPointChannel::TransmitStart (Ptr<const Packet> p, Ptr<PointToPointNetDevice> src, Time txTime)
+{
+  if (!m_cross)
+    {
+      return PointToPointChannel::TransmitStart (p, src, txTime);
+    }
+  uint32_t receiver = (PeekPointer (src) == m_devices[0]) ? 1 : 0;
+  std::vector<uint8_t> bytes (p->GetSerializedSize ());
+  NS_ABORT_MSG_UNLESS (p->Serialize (bytes.data (), bytes.size ()), "Cannot serialize the packet");
+  Simulator::ScheduleWithContext (m_nodes[receiver], txTime + GetDelay (),
+                                  &PartitionedPointToPointChannel::Deliver, this, receiver, bytes);
+  return true;
+}
+
+inline void
+PartitionedPointToPointChannel::Deliver (uint32_t device, std::vector<uint8_t> bytes)
+{
+  Ptr<Packet> packet = Create<Packet> (bytes.data (), bytes.size (), true);
+  m_devices[device]->Receive (packet);
+}
+
+} // namespace ns3
+
+#endif /* PARTITIONED_POINT_TO_POINT_CHANNEL_H */
@@ -0,0 +1,1111 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PARTITIONED_SIMULATOR_IMPL_H
+#define PARTITIONED_SIMULATOR_IMPL_H
+
+// Conservative, window-synchronized multithreaded simulator implementation
+// for scenarios that split into partitions of nodes connected only by
+// links with a known minimum delay (the lookahead).
+//
+// Every node is assigned to a partition; events scheduled without a node
+// context (NO_CONTEXT, e.g. periodic samplers scheduled from main ()) form
+// the global partition.  An event of partition q can only schedule an
+// event in partition p one lookahead L(q, p) after its own time, so p can
+// execute its events up to the earliest next event of any other partition
+// q plus L(q, p) without hearing from the others.  The simulation
+// advances in such windows.  Every partition runs its windows on its own
+// thread, partition 0 on the thread that called Simulator::Run, and the
+// threads meet at a barrier at the end of every window; without a
+// thread-safe network module (see below) the partitions run their windows
+// one after the other on the calling thread instead.  The events
+// scheduled from one partition into another during a window are queued by
+// the sending thread and handed over at the barrier.  Windows are cut
+// short at the next global event, which runs on the calling thread while
+// the others wait, together with every partition event of the same
+// timestamp, in key order.
+//
+// Events are ordered by (timestamp, scheduling timestamp, scheduling
+// context, per-context sequence number) rather than by a global uid, so
+// the execution order depends neither on how the nodes are partitioned
+// nor on the timing of the threads: a run with one partition, which is a
+// sequential run on one thread, and a run with several execute the same
+// events in the same order on every node, and give bit-identical results.
+// Packet uids are the exception: they come from a global counter, which
+// the threads advance in any order.
+//
+// The reference sequential run is therefore this simulator with a single
+// partition, not DefaultSimulatorImpl.  The default simulator breaks
+// timestamp ties by global scheduling order: two events of the same time
+// scheduled from different nodes run in the order their scheduling events
+// ran, which for scheduling events of the same time in two partitions
+// depends in turn on the order of their own scheduling events, and so on
+// back through the history of both partitions.  No partition can know
+// that order without waiting for the others, which would remove the
+// parallelism, so the results can differ from those of a run on the
+// default simulator wherever such ties occur.
+//
+// Partitions must not share objects: whatever goes from one partition to
+// another, packets included, has to be carried by an event scheduled with
+// ScheduleWithContext and not be used by the sender afterwards.  Ptr
+// reference counts and packet buffers are not thread-safe, so links
+// between partitions serialize their packets (see
+// partitioned-point-to-point-channel.h).
+//
+// Every packet operation of every partition also touches globals of the
+// network module, whatever crosses partitions: the free lists of Buffer
+// (BUFFER_FREE_LIST, always defined by buffer.h), PacketMetadata and
+// ByteTagList, and the uid counter Packet::m_globalUid.  Stock ns-3
+// updates them without synchronization, and the simulator cannot tell
+// from the outside whether they are safe.  The partitions therefore only
+// run on their own threads when the scenario is built with
+// PARTITIONED_THREAD_SAFE_NETWORK defined, which asserts that src/network
+// was patched to make the free lists thread_local and the uid counter
+// atomic.  Otherwise the windows run on one thread, with the same results
+// and no speedup; PrintStatistics tells which.  Setting the Threaded
+// attribute to false also runs them on one thread, which gives the
+// reference time of a partitioned run that is not equivalent to a run
+// with one partition (see shared-delivery-yans-wifi-phy.h).
+//
+// A Stop from a node event stops its partition at once, and the others at
+// the end of the window, which may be up to one lookahead later.
+//
+// Usage:
+//
+//   GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::PartitionedSimulatorImpl"));
+//   Ptr<PartitionedSimulatorImpl> impl = DynamicCast<PartitionedSimulatorImpl> (Simulator::GetImplementation ());
+//   impl->SetPartition (node->GetId (), 1);
+//   impl->SetLookahead (linkDelay);
+//
+// Nodes that are not assigned explicitly belong to partition 0.
+
+#include "ns3/simulator.h"
+#include "ns3/simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/event-id.h"
+#include "ns3/make-event.h"
+#include "ns3/nstime.h"
+#include "ns3/boolean.h"
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+namespace partitioned {
+
+/// Timestamp of an empty event queue
+const uint64_t NO_TS = std::numeric_limits<uint64_t>::max ();
+/// Partition index of the events without a node context
+const uint32_t GLOBAL = std::numeric_limits<uint32_t>::max ();
+
+/// Whether the network module may be used from several threads
+#ifdef PARTITIONED_THREAD_SAFE_NETWORK
+const bool THREAD_SAFE_NETWORK = true;
+#else
+const bool THREAD_SAFE_NETWORK = false;
+#endif
+
+/// \returns ts + delay, or NO_TS if it does not fit
+inline uint64_t
+AddTs (uint64_t ts, uint64_t delay)
+{
+  return (ts == NO_TS || delay == NO_TS || ts > NO_TS - delay) ? NO_TS : ts + delay;
+}
+
+} // namespace partitioned
+
+class PartitionedSimulatorImpl : public SimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  PartitionedSimulatorImpl ();
+  virtual ~PartitionedSimulatorImpl ();
+
+  /**
+   * Assign a node to a partition.  Must be called before Simulator::Run.
+   * \param nodeId the node id (event context)
+   * \param partition the partition index
+   */
+  void SetPartition (uint32_t nodeId, uint32_t partition);
+  /**
+   * \param lookahead minimum delay of any event scheduled from one
+   * partition into another, for the pairs of partitions not given to the
+   * other overload
+   */
+  void SetLookahead (Time lookahead);
+  /**
+   * \param from the partition scheduling the events
+   * \param to the partition of the events
+   * \param lookahead minimum delay of any event scheduled from one into the other
+   */
+  void SetLookahead (uint32_t from, uint32_t to, Time lookahead);
+  /// \returns the smallest lookahead between two partitions
+  Time GetLookahead (void) const;
+  /// \returns the lookahead from one partition to another
+  Time GetLookahead (uint32_t from, uint32_t to) const;
+  /**
+   * \param nodeId the node id
+   * \returns the partition the node is assigned to
+   */
+  uint32_t GetPartition (uint32_t nodeId) const;
+  /// \returns the number of partitions
+  uint32_t GetNPartitions (void) const;
+  /// \returns the number of events scheduled across partitions
+  uint64_t GetCrossPartitionEvents (void) const;
+  /// \returns true if the partitions run on their own threads
+  bool IsThreaded (void) const;
+  /// \returns the busy time of all the partitions, that is the time one
+  /// thread would have taken for the same windows, over the wall-clock time
+  double GetSpeedup (void) const;
+  /// Print the window, wait and speedup statistics of the last run
+  void PrintStatistics (std::ostream &os) const;
+
+  // Inherited from SimulatorImpl
+  virtual void Destroy ();
+  virtual bool IsFinished (void) const;
+  virtual void Stop (void);
+  virtual void Stop (const Time &delay);
+  virtual EventId Schedule (const Time &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+  virtual void Remove (const EventId &id);
+  virtual void Cancel (const EventId &id);
+  virtual bool IsExpired (const EventId &id) const;
+  virtual void Run (void);
+  virtual Time Now (void) const;
+  virtual Time GetDelayLeft (const EventId &id) const;
+  virtual Time GetMaximumSimulationTime (void) const;
+  virtual void SetScheduler (ObjectFactory schedulerFactory);
+  virtual uint32_t GetSystemId (void) const;
+  virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+
+private:
+  virtual void DoDispose (void);
+
+  /// Partition-independent event ordering key
+  struct Key
+  {
+    uint64_t ts;
+    uint64_t schedTs;
+    uint32_t schedContext;
+    uint64_t seq;
+
+    bool operator > (const Key &o) const
+    {
+      if (ts != o.ts)
+        {
+          return ts > o.ts;
+        }
+      if (schedTs != o.schedTs)
+        {
+          return schedTs > o.schedTs;
+        }
+      if (schedContext != o.schedContext)
+        {
+          return schedContext > o.schedContext;
+        }
+      return seq > o.seq;
+    }
+  };
+
+  struct Event
+  {
+    Key key;
+    EventImpl *impl;
+    uint32_t context;
+    uint32_t uid;
+
+    bool operator > (const Event &o) const
+    {
+      return key > o.key;
+    }
+  };
+
+  typedef std::priority_queue<Event, std::vector<Event>, std::greater<Event> > EventQueue;
+
+  /// State of a partition, only touched by its thread during a window
+  struct Partition
+  {
+    EventQueue events;
+    std::vector<Event> outbox;                  //!< events for other partitions
+    std::unordered_set<uint32_t> pending;       //!< uids of the events with an EventId
+    std::vector<uint64_t> contextSeq;           //!< next sequence number, by context
+    uint64_t globalSeq = 0;                     //!< next sequence number of NO_CONTEXT
+    uint64_t currentTs = 0;
+    bool stopped = false;
+    std::atomic<uint64_t> executed {0};
+    uint64_t idleWindows = 0;
+    uint64_t waits = 0;                         //!< windows it waited for the others
+    double busyNs = 0;
+    double waitNs = 0;
+    std::chrono::steady_clock::time_point finished;
+  };
+
+  /// What the calling thread is executing
+  struct Current
+  {
+    uint32_t partition = partitioned::GLOBAL;
+    uint32_t context = Simulator::NO_CONTEXT;
+    bool inWindow = false;
+  };
+
+  static Current &GetCurrent (void);
+  uint32_t GetPartitionOf (uint32_t context) const;
+  uint64_t GetLookaheadTs (uint32_t from, uint32_t to) const;
+  Partition &GetPartitionState (uint32_t partition) const;
+  void Insert (uint32_t context, uint64_t ts, EventImpl *impl, uint32_t uid, bool tracked);
+  uint64_t NextTs (const Partition &partition) const;
+  void Execute (uint32_t partition, Partition &state);
+  void RunWindow (uint32_t partition);
+  void RunSimultaneous (uint64_t ts);
+  void DeliverOutboxes (void);
+  void Worker (uint32_t partition, uint64_t generation);
+
+  std::vector<uint32_t> m_nodePartition;
+  std::vector<std::unique_ptr<Partition> > m_partitions;
+  std::unique_ptr<Partition> m_global;
+  EventQueue m_setup;                           //!< events scheduled before the first run
+  std::unordered_set<uint32_t> m_setupPending;
+  bool m_distributed;
+  std::list<EventId> m_destroyEvents;
+  mutable std::mutex m_destroyMutex;
+
+  uint64_t m_lookahead;
+  std::map<std::pair<uint32_t, uint32_t>, uint64_t> m_pairLookaheads;
+  std::vector<uint64_t> m_lookaheads;           //!< by from * n + to, during a run
+  std::vector<uint64_t> m_windowEnds;           //!< end of the current window, by partition
+  uint64_t m_windowMaxEnd;
+  bool m_running;
+  bool m_allowThreads;                          //!< Threaded attribute
+  bool m_threaded;                              //!< partitions on their own threads
+  bool m_stop;
+  std::atomic<bool> m_stopRequested;
+  std::atomic<uint32_t> m_uid;
+
+  // Window barrier
+  std::mutex m_mutex;
+  std::condition_variable m_windowStart;
+  std::condition_variable m_windowDone;
+  uint64_t m_generation;
+  uint32_t m_busyThreads;
+  bool m_exit;
+
+  uint64_t m_windows;
+  uint64_t m_crossEvents;
+  double m_barrierNs;
+  double m_wallNs;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PartitionedSimulatorImpl);
+
+inline TypeId
+PartitionedSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PartitionedSimulatorImpl")
+    .SetParent<SimulatorImpl> ()
+    .AddConstructor<PartitionedSimulatorImpl> ()
+    .AddAttribute ("Threaded",
+                   "Run the partitions on their own threads, if the network module is thread-safe; "
+                   "otherwise they run one after the other on one thread, with the same results",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&PartitionedSimulatorImpl::m_allowThreads),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+inline
+PartitionedSimulatorImpl::PartitionedSimulatorImpl ()
+  : m_global (new Partition),
+    m_distributed (false),
+    m_lookahead (0),
+    m_windowMaxEnd (0),
+    m_running (false),
+    m_allowThreads (true),
+    m_threaded (false),
+    m_stop (false),
+    m_stopRequested (false),
+    m_uid (EventId::UID::VALID),
+    m_generation (0),
+    m_busyThreads (0),
+    m_exit (false),
+    m_windows (0),
+    m_crossEvents (0),
+    m_barrierNs (0),
+    m_wallNs (0)
+{
+  m_partitions.emplace_back (new Partition);
+}
+
+inline
+PartitionedSimulatorImpl::~PartitionedSimulatorImpl ()
+{
+}
+
+inline void
+PartitionedSimulatorImpl::DoDispose (void)
+{
+  std::vector<EventQueue *> queues = {&m_setup, &m_global->events};
+  for (std::unique_ptr<Partition> &partition : m_partitions)
+    {
+      queues.push_back (&partition->events);
+      for (Event &ev : partition->outbox)
+        {
+          ev.impl->Unref ();
+        }
+      partition->outbox.clear ();
+      partition->pending.clear ();
+    }
+  for (EventQueue *events : queues)
+    {
+      while (!events->empty ())
+        {
+          events->top ().impl->Unref ();
+          events->pop ();
+        }
+    }
+  m_global->pending.clear ();
+  m_setupPending.clear ();
+  SimulatorImpl::DoDispose ();
+}
+
+inline PartitionedSimulatorImpl::Current &
+PartitionedSimulatorImpl::GetCurrent (void)
+{
+  static thread_local Current current;
+  return current;
+}
+
+inline void
+PartitionedSimulatorImpl::SetPartition (uint32_t nodeId, uint32_t partition)
+{
+  NS_ASSERT_MSG (!m_distributed, "Partitions must be assigned before Simulator::Run");
+  if (nodeId >= m_nodePartition.size ())
+    {
+      m_nodePartition.resize (nodeId + 1, 0);
+    }
+  m_nodePartition[nodeId] = partition;
+  while (partition >= m_partitions.size ())
+    {
+      m_partitions.emplace_back (new Partition);
+    }
+}
+
+inline void
+PartitionedSimulatorImpl::SetLookahead (Time lookahead)
+{
+  NS_ASSERT_MSG (lookahead.IsStrictlyPositive (), "The lookahead must be positive");
+  m_lookahead = lookahead.GetTimeStep ();
+}
+
+inline void
+PartitionedSimulatorImpl::SetLookahead (uint32_t from, uint32_t to, Time lookahead)
+{
+  NS_ASSERT_MSG (lookahead.IsStrictlyPositive (), "The lookahead must be positive");
+  NS_ASSERT_MSG (!m_running, "Lookaheads must be set before Simulator::Run");
+  m_pairLookaheads[std::make_pair (from, to)] = lookahead.GetTimeStep ();
+}
+
+inline Time
+PartitionedSimulatorImpl::GetLookahead (void) const
+{
+  uint64_t lookahead = partitioned::NO_TS;
+  for (uint32_t from = 0; from < m_partitions.size (); from++)
+    {
+      for (uint32_t to = 0; to < m_partitions.size (); to++)
+        {
+          if (from != to)
+            {
+              lookahead = std::min (lookahead, GetLookaheadTs (from, to));
+            }
+        }
+    }
+  return TimeStep (lookahead == partitioned::NO_TS ? m_lookahead : lookahead);
+}
+
+inline Time
+PartitionedSimulatorImpl::GetLookahead (uint32_t from, uint32_t to) const
+{
+  return TimeStep (GetLookaheadTs (from, to));
+}
+
+inline uint64_t
+PartitionedSimulatorImpl::GetLookaheadTs (uint32_t from, uint32_t to) const
+{
+  std::map<std::pair<uint32_t, uint32_t>, uint64_t>::const_iterator it = m_pairLookaheads.find (std::make_pair (from, to));
+  return it != m_pairLookaheads.end () ? it->second : m_lookahead;
+}
+
+inline uint32_t
+PartitionedSimulatorImpl::GetPartition (uint32_t nodeId) const
+{
+  return GetPartitionOf (nodeId);
+}
+
+inline uint32_t
+PartitionedSimulatorImpl::GetNPartitions (void) const
+{
+  return m_partitions.size ();
+}
+
+inline uint64_t
+PartitionedSimulatorImpl::GetCrossPartitionEvents (void) const
+{
+  return m_crossEvents;
+}
+
+inline bool
+PartitionedSimulatorImpl::IsThreaded (void) const
+{
+  return partitioned::THREAD_SAFE_NETWORK && m_allowThreads && m_partitions.size () > 1;
+}
+
+inline double
+PartitionedSimulatorImpl::GetSpeedup (void) const
+{
+  double busyNs = m_barrierNs;
+  for (const std::unique_ptr<Partition> &p : m_partitions)
+    {
+      busyNs += p->busyNs;
+    }
+  return m_wallNs > 0 ? busyNs / m_wallNs : 1.0;
+}
+
+inline uint32_t
+PartitionedSimulatorImpl::GetPartitionOf (uint32_t context) const
+{
+  if (context == Simulator::NO_CONTEXT)
+    {
+      return partitioned::GLOBAL;
+    }
+  return context < m_nodePartition.size () ? m_nodePartition[context] : 0;
+}
+
+inline PartitionedSimulatorImpl::Partition &
+PartitionedSimulatorImpl::GetPartitionState (uint32_t partition) const
+{
+  return (partition == partitioned::GLOBAL) ? *m_global : *m_partitions[partition];
+}
+
+inline void
+PartitionedSimulatorImpl::Insert (uint32_t context, uint64_t ts, EventImpl *impl, uint32_t uid, bool tracked)
+{
+  Current &current = GetCurrent ();
+  Partition &source = GetPartitionState (current.partition);
+  Event ev;
+  ev.key.ts = ts;
+  ev.key.schedTs = source.currentTs;
+  ev.key.schedContext = current.context;
+  if (current.context == Simulator::NO_CONTEXT)
+    {
+      ev.key.seq = source.globalSeq++;
+    }
+  else
+    {
+      if (current.context >= source.contextSeq.size ())
+        {
+          source.contextSeq.resize (current.context + 1, 0);
+        }
+      ev.key.seq = source.contextSeq[current.context]++;
+    }
+  ev.impl = impl;
+  ev.context = context;
+  ev.uid = uid;
+
+  if (!m_distributed)
+    {
+      // Partitions may still be assigned; events are distributed at Run
+      if (tracked)
+        {
+          m_setupPending.insert (uid);
+        }
+      m_setup.push (ev);
+      return;
+    }
+  uint32_t target = GetPartitionOf (context);
+  if (current.inWindow && target != current.partition)
+    {
+      // The target may already be running this window, up to its end
+      uint64_t end = (target == partitioned::GLOBAL) ? m_windowMaxEnd : m_windowEnds[target];
+      if (ts < end)
+        {
+          NS_FATAL_ERROR ("Event scheduled from partition " << current.partition
+                          << " into partition " << target << " below the lookahead");
+        }
+      NS_ASSERT_MSG (!tracked, "Events with an EventId stay in their partition");
+      source.outbox.push_back (ev);
+      return;
+    }
+  Partition &state = GetPartitionState (target);
+  if (tracked)
+    {
+      state.pending.insert (uid);
+    }
+  state.events.push (ev);
+}
+
+inline EventId
+PartitionedSimulatorImpl::Schedule (const Time &delay, EventImpl *event)
+{
+  NS_ASSERT_MSG (!delay.IsStrictlyNegative (), "Negative delay");
+  Current &current = GetCurrent ();
+  uint64_t ts = GetPartitionState (current.partition).currentTs + delay.GetTimeStep ();
+  uint32_t uid = m_uid++;
+  EventId id (event, ts, current.context, uid);
+  Insert (current.context, ts, event, uid, true);
+  return id;
+}
+
+inline void
+PartitionedSimulatorImpl::ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event)
+{
+  NS_ASSERT_MSG (!delay.IsStrictlyNegative (), "Negative delay");
+  uint64_t ts = GetPartitionState (GetCurrent ().partition).currentTs + delay.GetTimeStep ();
+  // The simulator holds the only reference, released after execution
+  Insert (context, ts, event, m_uid++, false);
+}
+
+inline EventId
+PartitionedSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  return Schedule (TimeStep (0), event);
+}
+
+inline EventId
+PartitionedSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  EventId id (Ptr<EventImpl> (event, false), Now ().GetTimeStep (), Simulator::NO_CONTEXT, EventId::UID::DESTROY);
+  std::lock_guard<std::mutex> lock (m_destroyMutex);
+  m_destroyEvents.push_back (id);
+  return id;
+}
+
+inline void
+PartitionedSimulatorImpl::Remove (const EventId &id)
+{
+  if (id.GetUid () == EventId::UID::DESTROY)
+    {
+      std::lock_guard<std::mutex> lock (m_destroyMutex);
+      for (std::list<EventId>::iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              m_destroyEvents.erase (i);
+              break;
+            }
+        }
+      return;
+    }
+  // Removed events stay in their queue and are skipped when they expire
+  Cancel (id);
+  if (m_distributed)
+    {
+      GetPartitionState (GetPartitionOf (id.GetContext ())).pending.erase (id.GetUid ());
+    }
+  else
+    {
+      m_setupPending.erase (id.GetUid ());
+    }
+}
+
+inline void
+PartitionedSimulatorImpl::Cancel (const EventId &id)
+{
+  if (!IsExpired (id))
+    {
+      id.PeekEventImpl ()->Cancel ();
+    }
+}
+
+inline bool
+PartitionedSimulatorImpl::IsExpired (const EventId &id) const
+{
+  if (id.GetUid () == EventId::UID::DESTROY)
+    {
+      if (id.PeekEventImpl () == 0 || id.PeekEventImpl ()->IsCancelled ())
+        {
+          return true;
+        }
+      std::lock_guard<std::mutex> lock (m_destroyMutex);
+      for (std::list<EventId>::const_iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  if (id.PeekEventImpl () == 0 || id.PeekEventImpl ()->IsCancelled ())
+    {
+      return true;
+    }
+  // An event with an EventId is in the partition of the context it was
+  // scheduled from, so only that partition's thread looks it up
+  const std::unordered_set<uint32_t> &pending = m_distributed
+    ? GetPartitionState (GetPartitionOf (id.GetContext ())).pending
+    : m_setupPending;
+  return pending.find (id.GetUid ()) == pending.end ();
+}
+
+inline Time
+PartitionedSimulatorImpl::GetDelayLeft (const EventId &id) const
+{
+  if (IsExpired (id))
+    {
+      return TimeStep (0);
+    }
+  return TimeStep (id.GetTs () - Now ().GetTimeStep ());
+}
+
+inline uint64_t
+PartitionedSimulatorImpl::NextTs (const Partition &partition) const
+{
+  return partition.events.empty () ? partitioned::NO_TS : partition.events.top ().key.ts;
+}
+
+inline void
+PartitionedSimulatorImpl::Execute (uint32_t partition, Partition &state)
+{
+  Event ev = state.events.top ();
+  state.events.pop ();
+  NS_ASSERT (ev.key.ts >= state.currentTs);
+  state.currentTs = ev.key.ts;
+  Current &current = GetCurrent ();
+  current.partition = partition;
+  current.context = ev.context;
+  state.pending.erase (ev.uid);
+  // Only this thread writes the counter
+  state.executed.store (state.executed.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  ev.impl->Invoke ();
+  ev.impl->Unref ();
+}
+
+inline void
+PartitionedSimulatorImpl::RunWindow (uint32_t partition)
+{
+  Partition &state = *m_partitions[partition];
+  uint64_t end = m_windowEnds[partition];
+  Current &current = GetCurrent ();
+  current.inWindow = true;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  if (NextTs (state) >= end)
+    {
+      state.idleWindows++;
+    }
+  while (!state.stopped && NextTs (state) < end)
+    {
+      Execute (partition, state);
+    }
+  current.inWindow = false;
+  current.partition = partitioned::GLOBAL;
+  current.context = Simulator::NO_CONTEXT;
+  state.finished = std::chrono::steady_clock::now ();
+  std::chrono::duration<double, std::nano> elapsed = state.finished - start;
+  state.busyNs += elapsed.count ();
+}
+
+inline void
+PartitionedSimulatorImpl::Worker (uint32_t partition, uint64_t generation)
+{
+  while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_windowStart.wait (lock, [this, generation] { return m_exit || m_generation != generation; });
+        if (m_exit)
+          {
+            return;
+          }
+        generation = m_generation;
+      }
+      RunWindow (partition);
+      std::lock_guard<std::mutex> lock (m_mutex);
+      if (--m_busyThreads == 0)
+        {
+          m_windowDone.notify_one ();
+        }
+    }
+}
+
+inline void
+PartitionedSimulatorImpl::DeliverOutboxes (void)
+{
+  for (std::unique_ptr<Partition> &partition : m_partitions)
+    {
+      for (const Event &ev : partition->outbox)
+        {
+          GetPartitionState (GetPartitionOf (ev.context)).events.push (ev);
+        }
+      m_crossEvents += partition->outbox.size ();
+      partition->outbox.clear ();
+    }
+}
+
+inline void
+PartitionedSimulatorImpl::RunSimultaneous (uint64_t ts)
+{
+  // Execute every event of this timestamp, from all partitions, in key
+  // order on this thread while the others wait
+  m_global->currentTs = ts;
+  while (!m_stop)
+    {
+      uint32_t best = partitioned::GLOBAL;
+      Partition *bestState = 0;
+      if (NextTs (*m_global) == ts)
+        {
+          bestState = m_global.get ();
+        }
+      for (uint32_t p = 0; p < m_partitions.size (); p++)
+        {
+          Partition &state = *m_partitions[p];
+          if (NextTs (state) == ts
+              && (bestState == 0 || bestState->events.top ().key > state.events.top ().key))
+            {
+              best = p;
+              bestState = &state;
+            }
+        }
+      if (bestState == 0)
+        {
+          break;
+        }
+      Execute (best, *bestState);
+    }
+  Current &current = GetCurrent ();
+  current.partition = partitioned::GLOBAL;
+  current.context = Simulator::NO_CONTEXT;
+}
+
+inline void
+PartitionedSimulatorImpl::Run (void)
+{
+  uint32_t n = m_partitions.size ();
+  m_threaded = IsThreaded ();
+  m_lookaheads.assign (n * n, partitioned::NO_TS);
+  for (uint32_t from = 0; from < n; from++)
+    {
+      for (uint32_t to = 0; to < n; to++)
+        {
+          if (from != to)
+            {
+              m_lookaheads[from * n + to] = GetLookaheadTs (from, to);
+              NS_ABORT_MSG_IF (m_lookaheads[from * n + to] == 0,
+                               "PartitionedSimulatorImpl: no lookahead from partition " << from << " to " << to);
+            }
+        }
+    }
+  m_windowEnds.assign (n, 0);
+
+  // Distribute the events scheduled during setup to their partitions
+  if (!m_distributed)
+    {
+      m_distributed = true;
+      while (!m_setup.empty ())
+        {
+          Event ev = m_setup.top ();
+          m_setup.pop ();
+          Partition &state = GetPartitionState (GetPartitionOf (ev.context));
+          if (m_setupPending.erase (ev.uid))
+            {
+              state.pending.insert (ev.uid);
+            }
+          state.events.push (ev);
+        }
+      m_setupPending.clear ();
+    }
+  m_running = true;
+  m_stop = false;
+  m_stopRequested = false;
+
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
+  std::vector<std::thread> workers;
+  m_exit = false;
+  for (uint32_t p = 1; m_threaded && p < n; p++)
+    {
+      workers.emplace_back (&PartitionedSimulatorImpl::Worker, this, p, m_generation);
+    }
+
+  std::vector<uint64_t> next (n);
+  while (!m_stop)
+    {
+      uint64_t globalNext = NextTs (*m_global);
+      uint64_t first = globalNext;
+      for (uint32_t p = 0; p < n; p++)
+        {
+          next[p] = NextTs (*m_partitions[p]);
+          first = std::min (first, next[p]);
+        }
+      if (first == partitioned::NO_TS)
+        {
+          break;
+        }
+      if (first == globalNext)
+        {
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+          RunSimultaneous (globalNext);
+          std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+          m_barrierNs += elapsed.count ();
+          continue;
+        }
+
+      // Partition p runs until any other partition could reach it
+      m_windowMaxEnd = 0;
+      for (uint32_t p = 0; p < n; p++)
+        {
+          uint64_t end = globalNext;
+          for (uint32_t q = 0; q < n; q++)
+            {
+              if (q != p)
+                {
+                  end = std::min (end, partitioned::AddTs (next[q], m_lookaheads[q * n + p]));
+                }
+            }
+          m_windowEnds[p] = end;
+          m_windowMaxEnd = std::max (m_windowMaxEnd, end);
+        }
+
+      if (m_threaded)
+        {
+          {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_busyThreads = n - 1;
+            m_generation++;
+          }
+          m_windowStart.notify_all ();
+          RunWindow (0);
+          {
+            std::unique_lock<std::mutex> lock (m_mutex);
+            m_windowDone.wait (lock, [this] { return m_busyThreads == 0; });
+          }
+          // All but the last thread to arrive waited at the barrier
+          std::chrono::steady_clock::time_point last = m_partitions[0]->finished;
+          for (std::unique_ptr<Partition> &partition : m_partitions)
+            {
+              last = std::max (last, partition->finished);
+            }
+          for (std::unique_ptr<Partition> &partition : m_partitions)
+            {
+              if (partition->finished < last)
+                {
+                  std::chrono::duration<double, std::nano> waited = last - partition->finished;
+                  partition->waitNs += waited.count ();
+                  partition->waits++;
+                }
+            }
+        }
+      else
+        {
+          // Same windows, one partition after the other
+          for (uint32_t p = 0; p < n; p++)
+            {
+              RunWindow (p);
+            }
+        }
+      m_windows++;
+      DeliverOutboxes ();
+      if (m_stopRequested)
+        {
+          m_stop = true;
+        }
+    }
+
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_exit = true;
+  }
+  m_windowStart.notify_all ();
+  for (std::thread &worker : workers)
+    {
+      worker.join ();
+    }
+  std::chrono::duration<double, std::nano> wall = std::chrono::steady_clock::now () - runStart;
+  m_wallNs += wall.count ();
+
+  // Now () is the time of the last executed event
+  for (std::unique_ptr<Partition> &partition : m_partitions)
+    {
+      m_global->currentTs = std::max (m_global->currentTs, partition->currentTs);
+      partition->stopped = false;
+    }
+  m_running = false;
+}
+
+inline void
+PartitionedSimulatorImpl::PrintStatistics (std::ostream &os) const
+{
+  os << "Partitioned run: " << m_partitions.size () << " partitions on "
+     << (m_threaded ? "as many threads" : (m_allowThreads ? "one thread (PARTITIONED_THREAD_SAFE_NETWORK not defined)"
+                                                             : "one thread (Threaded=false)"))
+     << ", lookahead "
+     << GetLookahead ().GetSeconds () * 1e6 << " us, " << m_windows << " windows, "
+     << m_crossEvents << " cross-partition events" << std::endl;
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      const Partition &p = *m_partitions[i];
+      os << "  partition " << i << ": " << p.executed.load () << " events, "
+         << std::fixed << std::setprecision (3) << p.busyNs / 1e9 << " s busy, waited for the others in "
+         << p.waits << " windows for " << p.waitNs / 1e9 << " s, nothing to do in "
+         << p.idleWindows << " windows" << std::endl;
+    }
+  os << "  global: " << m_global->executed.load () << " events, "
+     << std::fixed << std::setprecision (3) << m_barrierNs / 1e9 << " s at barriers" << std::endl;
+  os << "  wall-clock time " << m_wallNs / 1e9 << " s, speedup over one thread "
+     << std::setprecision (2) << GetSpeedup () << std::endl;
+  os.unsetf (std::ios_base::floatfield);
+}
+
+inline void
+PartitionedSimulatorImpl::Destroy ()
+{
+  while (true)
+    {
+      Ptr<EventImpl> ev;
+      {
+        // Not held while the event runs, which may schedule others
+        std::lock_guard<std::mutex> lock (m_destroyMutex);
+        if (m_destroyEvents.empty ())
+          {
+            break;
+          }
+        ev = m_destroyEvents.front ().PeekEventImpl ();
+        m_destroyEvents.pop_front ();
+      }
+      if (!ev->IsCancelled ())
+        {
+          ev->Invoke ();
+        }
+    }
+}
+
+inline bool
+PartitionedSimulatorImpl::IsFinished (void) const
+{
+  if (m_stop)
+    {
+      return true;
+    }
+  if (!m_setup.empty () || !m_global->events.empty ())
+    {
+      return false;
+    }
+  for (const std::unique_ptr<Partition> &p : m_partitions)
+    {
+      if (!p->events.empty ())
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+inline void
+PartitionedSimulatorImpl::Stop (void)
+{
+  Current &current = GetCurrent ();
+  if (current.inWindow)
+    {
+      // The other partitions finish the window
+      GetPartitionState (current.partition).stopped = true;
+      m_stopRequested = true;
+      return;
+    }
+  m_stop = true;
+}
+
+inline void
+PartitionedSimulatorImpl::Stop (const Time &delay)
+{
+  Current &current = GetCurrent ();
+  uint64_t ts = GetPartitionState (current.partition).currentTs + delay.GetTimeStep ();
+  if (current.inWindow && ts < m_windowMaxEnd)
+    {
+      // Too soon for a barrier: stop this partition then, and the others
+      // at the end of that window
+      Schedule (delay, MakeEvent (&Simulator::Stop));
+      return;
+    }
+  // A stop time is a barrier for all partitions
+  ScheduleWithContext (Simulator::NO_CONTEXT, delay, MakeEvent (&Simulator::Stop));
+}
+
+inline Time
+PartitionedSimulatorImpl::Now (void) const
+{
+  // Each thread has the time of the partition it is executing
+  return TimeStep (GetPartitionState (GetCurrent ().partition).currentTs);
+}
+
+inline Time
+PartitionedSimulatorImpl::GetMaximumSimulationTime (void) const
+{
+  return TimeStep (0x7fffffffffffffffLL);
+}
+
+inline void
+PartitionedSimulatorImpl::SetScheduler (ObjectFactory schedulerFactory)
+{
+  // Each partition keeps its own event queue ordered by the
+  // partition-independent key; the scheduler type is not used.
+}
+
+inline uint32_t
+PartitionedSimulatorImpl::GetSystemId (void) const
+{
+  return 0;
+}
+
+inline uint32_t
+PartitionedSimulatorImpl::GetContext (void) const
+{
+  return GetCurrent ().context;
+}
+
+inline uint64_t
+PartitionedSimulatorImpl::GetEventCount (void) const
+{
+  uint64_t events = m_global->executed.load (std::memory_order_relaxed);
+  for (const std::unique_ptr<Partition> &p : m_partitions)
+    {
+      events += p->executed.load (std::memory_order_relaxed);
+    }
+  return events;
+}
+
+} // namespace ns3
+
+#endif /* PARTITIONED_SIMULATOR_IMPL_H */
@@ -0,0 +1,299 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// A-MPDU construction benchmark (--bench=aggregate).
+//
+// Builds --ampdus A-MPDUs of UDP frames of --payloadSize bytes, as large as
+// the aggregation limits of the scenarios allow:
+//
+//   ampdu     65535 B A-MPDUs of single MSDUs, as the largest A-MPDU of
+//             myproject,
+//   twolevel  32768 B A-MPDUs of 3839 B A-MSDUs, as the two-level
+//             aggregation of myproject,
+//   maxthr    1048545 B A-MPDUs of 7935 B A-MSDUs, as ms-lab7-maxthr,
+//
+// in two ways:
+//
+//   copy     WifiMacQueueItem::Aggregate for the A-MSDUs, then the
+//            WifiPsdu, its packet (WifiPsdu::GetPacket, as for pcap and
+//            the monitor traces) and the packet of each MPDU
+//            (GetProtocolDataUnit, as for the PHY transmit trace),
+//   scatter  ScatterGatherPsdu (see scatter-gather-psdu.h) and its
+//            segments.
+//
+// The queued MSDUs are created outside of the measurement.  Both
+// constructions must give the same A-MPDU sizes.  Reported: MPDUs and
+// MSDUs per A-MPDU, and allocations and us per A-MPDU of each.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=aggregate --profiles=twolevel,maxthr"
+
+#include "perf-bench.h"
+#include "../scatter-gather-psdu.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("AggregateBench");
+
+namespace {
+
+struct AggregateProfile
+{
+  const char *name;
+  uint32_t maxAmpduSize;
+  uint32_t maxAmsduSize;            //!< 0 for no A-MSDU
+};
+
+const AggregateProfile AGGREGATE_PROFILES[] = {
+  { "ampdu", 65535, 0 },
+  { "twolevel", 32768, 3839 },
+  { "maxthr", 1048545, 7935 },
+};
+
+/// \returns the number of MSDUs of each MPDU of the largest A-MPDU
+std::vector<uint32_t>
+PlanAmpdu (const AggregateProfile &profile, uint32_t msduSize, uint32_t headerSize)
+{
+  std::vector<uint32_t> plan;
+  uint32_t mpduMsdus = 1;
+  uint32_t mpduSize = headerSize + scattergather::FCS_SIZE + msduSize;
+  if (profile.maxAmsduSize > 0)
+    {
+      uint32_t amsduSize = scattergather::SUBFRAME_HEADER_SIZE + msduSize;
+      while (amsduSize + scattergather::GetPadding (amsduSize)
+             + scattergather::SUBFRAME_HEADER_SIZE + msduSize <= profile.maxAmsduSize)
+        {
+          amsduSize += scattergather::GetPadding (amsduSize) + scattergather::SUBFRAME_HEADER_SIZE + msduSize;
+          mpduMsdus++;
+        }
+      mpduSize = headerSize + scattergather::FCS_SIZE + amsduSize;
+    }
+  uint32_t ampduSize = scattergather::DELIMITER_SIZE + mpduSize;
+  plan.push_back (mpduMsdus);
+  while (ampduSize + scattergather::GetPadding (ampduSize)
+         + scattergather::DELIMITER_SIZE + mpduSize <= profile.maxAmpduSize)
+    {
+      ampduSize += scattergather::GetPadding (ampduSize) + scattergather::DELIMITER_SIZE + mpduSize;
+      plan.push_back (mpduMsdus);
+    }
+  return plan;
+}
+
+struct AggregateResult
+{
+  uint64_t allocations = 0;
+  double ns = 0;
+  std::vector<uint32_t> sizes;
+};
+
+class AggregateBench
+{
+public:
+  AggregateBench (const AggregateProfile &profile, uint32_t payloadSize);
+  /// Build n A-MPDUs with copies and with ScatterGatherPsdu
+  void Run (uint32_t n, AggregateResult &copy, AggregateResult &scatter);
+
+  uint32_t GetNMpdus (void) const;
+  uint32_t GetNMsdus (void) const;
+
+private:
+  /// \returns the MSDUs of one A-MPDU, as queued
+  std::vector<Ptr<WifiMacQueueItem> > MakeMsdus (void) const;
+  void BuildWithCopies (const std::vector<Ptr<WifiMacQueueItem> > &msdus, AggregateResult &r);
+  void BuildScatterGather (const std::vector<Ptr<WifiMacQueueItem> > &msdus, AggregateResult &r);
+
+  bool m_amsdu;
+  uint32_t m_msduSize;
+  std::vector<uint32_t> m_plan;
+  uint32_t m_nMsdus;
+  Mac48Address m_source;
+  Mac48Address m_destination;
+  ScatterGatherPsdu m_psdu;
+};
+
+AggregateBench::AggregateBench (const AggregateProfile &profile, uint32_t payloadSize)
+  : m_amsdu (profile.maxAmsduSize > 0),
+    m_msduSize (payloadSize + 8 + 20 + 8),        // UDP, IP and LLC headers
+    m_nMsdus (0),
+    m_source (Mac48Address::Allocate ()),
+    m_destination (Mac48Address::Allocate ())
+{
+  WifiMacHeader header;
+  header.SetType (WIFI_MAC_QOSDATA);
+  m_plan = PlanAmpdu (profile, m_msduSize, header.GetSize ());
+  for (uint32_t msdus : m_plan)
+    {
+      m_nMsdus += msdus;
+    }
+}
+
+uint32_t
+AggregateBench::GetNMpdus (void) const
+{
+  return m_plan.size ();
+}
+
+uint32_t
+AggregateBench::GetNMsdus (void) const
+{
+  return m_nMsdus;
+}
+
+std::vector<Ptr<WifiMacQueueItem> >
+AggregateBench::MakeMsdus (void) const
+{
+  std::vector<Ptr<WifiMacQueueItem> > msdus;
+  for (uint32_t i = 0; i < m_nMsdus; i++)
+    {
+      WifiMacHeader header;
+      header.SetType (WIFI_MAC_QOSDATA);
+      header.SetAddr1 (m_destination);
+      header.SetAddr2 (m_source);
+      header.SetAddr3 (m_destination);
+      header.SetDsNotFrom ();
+      header.SetDsNotTo ();
+      header.SetQosTid (0);
+      msdus.push_back (Create<WifiMacQueueItem> (Create<Packet> (m_msduSize), header));
+    }
+  return msdus;
+}
+
+void
+AggregateBench::BuildWithCopies (const std::vector<Ptr<WifiMacQueueItem> > &msdus, AggregateResult &r)
+{
+  uint64_t allocations = GetAllocationCount ();
+  Stopwatch stopwatch;
+  stopwatch.Start ();
+  std::vector<Ptr<WifiMacQueueItem> > mpdus;
+  std::size_t next = 0;
+  for (uint32_t mpduMsdus : m_plan)
+    {
+      Ptr<WifiMacQueueItem> mpdu = msdus[next++];
+      for (uint32_t i = 1; i < mpduMsdus; i++)
+        {
+          mpdu->Aggregate (msdus[next++]);
+        }
+      mpdus.push_back (mpdu);
+    }
+  Ptr<WifiPsdu> psdu = Create<WifiPsdu> (mpdus);
+  Ptr<const Packet> packet = psdu->GetPacket ();
+  for (const Ptr<WifiMacQueueItem> &mpdu : *psdu)
+    {
+      packet = mpdu->GetProtocolDataUnit ();
+    }
+  stopwatch.Stop ();
+  r.ns += stopwatch.GetNs ();
+  r.allocations += GetAllocationCount () - allocations;
+  r.sizes.push_back (psdu->GetSize ());
+}
+
+void
+AggregateBench::BuildScatterGather (const std::vector<Ptr<WifiMacQueueItem> > &msdus, AggregateResult &r)
+{
+  uint64_t allocations = GetAllocationCount ();
+  Stopwatch stopwatch;
+  stopwatch.Start ();
+  m_psdu.Clear ();
+  std::size_t next = 0;
+  for (uint32_t mpduMsdus : m_plan)
+    {
+      m_psdu.AddMpdu (msdus[next]->GetHeader (), m_amsdu);
+      for (uint32_t i = 0; i < mpduMsdus; i++, next++)
+        {
+          const WifiMacHeader &header = msdus[next]->GetHeader ();
+          m_psdu.AddMsdu (msdus[next]->GetPacket (), header.GetAddr2 (), header.GetAddr1 ());
+        }
+    }
+  m_psdu.GetSegments ();
+  stopwatch.Stop ();
+  r.ns += stopwatch.GetNs ();
+  r.allocations += GetAllocationCount () - allocations;
+  r.sizes.push_back (m_psdu.GetSize ());
+}
+
+void
+AggregateBench::Run (uint32_t n, AggregateResult &copy, AggregateResult &scatter)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      // Aggregate changes the first MSDU of each A-MSDU, so each
+      // construction gets its own MSDUs
+      BuildWithCopies (MakeMsdus (), copy);
+      BuildScatterGather (MakeMsdus (), scatter);
+    }
+}
+
+} // unnamed namespace
+
+int
+RunAggregateBench (int argc, char *argv[])
+{
+  std::string profiles = "ampdu,twolevel,maxthr";
+  uint32_t ampdus = 100;
+  uint32_t payloadSize = 1472;
+
+  CommandLine cmd;
+  cmd.AddValue ("profiles", "Comma-separated aggregation limits (ampdu, twolevel, maxthr)", profiles);
+  cmd.AddValue ("ampdus", "A-MPDUs built per profile", ampdus);
+  cmd.AddValue ("payloadSize", "UDP payload [B]", payloadSize);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (ampdus > 0, "At least one A-MPDU is needed");
+
+  std::cout << std::left << std::setw (10) << "profile" << std::right << std::setw (7) << "MPDUs"
+            << std::setw (7) << "MSDUs" << std::setw (13) << "allocs/copy" << std::setw (16) << "allocs/scatter"
+            << std::setw (10) << "us/copy" << std::setw (13) << "us/scatter" << std::endl;
+  for (const std::string &name : SplitList (profiles))
+    {
+      const AggregateProfile *profile = 0;
+      for (const AggregateProfile &p : AGGREGATE_PROFILES)
+        {
+          if (name == p.name)
+            {
+              profile = &p;
+            }
+        }
+      NS_ABORT_MSG_UNLESS (profile != 0, "Unknown profile " << name);
+
+      AggregateBench bench (*profile, payloadSize);
+      AggregateResult copy;
+      AggregateResult scatter;
+      bench.Run (ampdus, copy, scatter);
+      NS_ABORT_MSG_UNLESS (copy.sizes == scatter.sizes, "The A-MPDU sizes differ");
+      NS_LOG_INFO (name << ": " << copy.sizes.front () << " B A-MPDUs");
+
+      std::cout << std::left << std::setw (10) << name << std::right << std::setw (7) << bench.GetNMpdus ()
+                << std::setw (7) << bench.GetNMsdus () << std::fixed << std::setprecision (1)
+                << std::setw (13) << static_cast<double> (copy.allocations) / ampdus
+                << std::setw (16) << static_cast<double> (scatter.allocations) / ampdus
+                << std::setw (10) << copy.ns / ampdus / 1000
+                << std::setw (13) << scatter.ns / ampdus / 1000 << std::endl;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
@@ -0,0 +1,335 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Block Ack scoreboard benchmark (--bench=blockack).
+//
+// An originator sends A-MPDUs filling its Block Ack window of --window
+// MPDUs, retransmissions first, over a channel losing each MPDU with
+// probability --per; the recipient answers each A-MPDU with a Block Ack
+// of --window bits.  The exchange is run with:
+//
+//   perbit  circular vector<bool> windows updated one bit at a time, as
+//           the Block Ack window of the MAC,
+//   bitmap  OriginatorScoreboard and RecipientScoreboard (see
+//           block-ack-scoreboard.h),
+//
+// which must move their windows identically.  Reported: MPDUs per
+// A-MPDU, and ns per A-MPDU of the scoreboard updates at both ends.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=blockack --window=64,256,1024 --per=0.1"
+
+#include "perf-bench.h"
+#include "../block-ack-scoreboard.h"
+
+#include "ns3/core-module.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("BlockAckBench");
+
+namespace {
+
+/// Circular window of flags, moved one bit at a time
+class PerBitWindow
+{
+public:
+  PerBitWindow (uint16_t winSize, uint16_t winStart)
+    : m_winStart (winStart),
+      m_head (0),
+      m_flags (winSize, false)
+  {
+  }
+
+  uint16_t GetWinStart (void) const
+  {
+    return m_winStart;
+  }
+  uint16_t GetWinSize (void) const
+  {
+    return m_flags.size ();
+  }
+  std::vector<bool>::reference At (uint32_t offset)
+  {
+    return m_flags[(m_head + offset) % m_flags.size ()];
+  }
+  bool At (uint32_t offset) const
+  {
+    return m_flags[(m_head + offset) % m_flags.size ()];
+  }
+  void Advance (uint32_t n)
+  {
+    for (uint32_t i = 0; i < n; i++)
+      {
+        m_flags[m_head] = false;
+        m_head = (m_head + 1) % m_flags.size ();
+      }
+    m_winStart = (m_winStart + n) % blockackscoreboard::SEQNO_SPACE;
+  }
+  void SetWinStart (uint16_t winStart)
+  {
+    m_winStart = winStart;
+  }
+
+private:
+  uint16_t m_winStart;
+  uint32_t m_head;
+  std::vector<bool> m_flags;
+};
+
+bool
+GetBit (const uint64_t *bitmap, uint32_t bit)
+{
+  return (bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
+class PerBitOriginator
+{
+public:
+  PerBitOriginator (uint16_t winSize, uint16_t winStart)
+    : m_sent (winSize, winStart),
+      m_acked (winSize, winStart)
+  {
+  }
+
+  uint16_t GetWinStart (void) const
+  {
+    return m_sent.GetWinStart ();
+  }
+  bool IsInWindow (uint16_t seq) const
+  {
+    return blockackscoreboard::GetDistance (seq, GetWinStart ()) < m_sent.GetWinSize ();
+  }
+  void NotifySent (uint16_t seq)
+  {
+    m_sent.At (blockackscoreboard::GetDistance (seq, GetWinStart ())) = true;
+  }
+  void NotifyBlockAck (uint16_t startingSeq, const uint64_t *bitmap, uint32_t nBits)
+  {
+    uint32_t winSize = m_sent.GetWinSize ();
+    uint16_t ahead = blockackscoreboard::GetDistance (startingSeq, GetWinStart ());
+    if (ahead < blockackscoreboard::HALF_SEQNO_SPACE)
+      {
+        Advance (ahead < winSize ? ahead : winSize);
+        if (ahead > winSize)
+          {
+            m_sent.SetWinStart (startingSeq);
+            m_acked.SetWinStart (startingSeq);
+          }
+        for (uint32_t i = 0; i < nBits && i < winSize; i++)
+          {
+            if (GetBit (bitmap, i))
+              {
+                m_acked.At (i) = true;
+              }
+          }
+      }
+    else
+      {
+        uint32_t behind = blockackscoreboard::SEQNO_SPACE - ahead;
+        for (uint32_t i = behind; i < nBits && i < behind + winSize; i++)
+          {
+            if (GetBit (bitmap, i))
+              {
+                m_acked.At (i - behind) = true;
+              }
+          }
+      }
+    uint32_t n = 0;
+    while (n < winSize && m_acked.At (n))
+      {
+        n++;
+      }
+    Advance (n);
+  }
+  void GetRetransmissions (std::vector<uint16_t> &seqs) const
+  {
+    seqs.clear ();
+    for (uint32_t i = 0; i < m_sent.GetWinSize (); i++)
+      {
+        if (m_sent.At (i) && !m_acked.At (i))
+          {
+            seqs.push_back ((GetWinStart () + i) % blockackscoreboard::SEQNO_SPACE);
+          }
+      }
+  }
+
+private:
+  void Advance (uint32_t n)
+  {
+    m_sent.Advance (n);
+    m_acked.Advance (n);
+  }
+
+  PerBitWindow m_sent;
+  PerBitWindow m_acked;
+};
+
+class PerBitRecipient
+{
+public:
+  PerBitRecipient (uint16_t winSize, uint16_t winStart)
+    : m_received (winSize, winStart)
+  {
+  }
+
+  uint16_t GetWinStart (void) const
+  {
+    return m_received.GetWinStart ();
+  }
+  void NotifyReceived (uint16_t seq)
+  {
+    uint32_t winSize = m_received.GetWinSize ();
+    uint16_t ahead = blockackscoreboard::GetDistance (seq, GetWinStart ());
+    if (ahead >= blockackscoreboard::HALF_SEQNO_SPACE)
+      {
+        return;
+      }
+    if (ahead >= winSize)
+      {
+        m_received.Advance (ahead - winSize + 1);
+        ahead = winSize - 1;
+      }
+    m_received.At (ahead) = true;
+    while (m_received.At (0))
+      {
+        m_received.Advance (1);
+      }
+  }
+  void FillBitmap (uint64_t *bitmap, uint32_t nBits) const
+  {
+    for (uint32_t w = 0; w < (nBits + 63) / 64; w++)
+      {
+        bitmap[w] = 0;
+      }
+    for (uint32_t i = 0; i < nBits; i++)
+      {
+        if (m_received.At (i))
+          {
+            bitmap[i / 64] |= uint64_t (1) << (i % 64);
+          }
+      }
+  }
+
+private:
+  PerBitWindow m_received;
+};
+
+struct BlockAckResult
+{
+  double ns = 0;
+  uint64_t mpdus = 0;
+  std::vector<uint16_t> winStarts;  //!< originator window start after each Block Ack
+};
+
+/**
+ * Run the exchanges, the i-th MPDU sent being lost if lost[i]; only the
+ * scoreboard updates are timed
+ */
+template <typename ORIGINATOR, typename RECIPIENT>
+BlockAckResult
+RunExchanges (uint16_t winSize, uint32_t ampdus, const std::vector<bool> &lost)
+{
+  BlockAckResult r;
+  ORIGINATOR originator (winSize, 0);
+  RECIPIENT recipient (winSize, 0);
+  std::vector<uint16_t> ampdu;
+  std::vector<uint16_t> retransmissions;
+  std::vector<uint64_t> bitmap ((winSize + 63) / 64);
+  uint16_t nextSeq = 0;
+  std::size_t nextLoss = 0;
+  Stopwatch stopwatch;
+  for (uint32_t a = 0; a < ampdus; a++)
+    {
+      stopwatch.Start ();
+      originator.GetRetransmissions (ampdu);
+      while (ampdu.size () < winSize && originator.IsInWindow (nextSeq))
+        {
+          ampdu.push_back (nextSeq);
+          nextSeq = (nextSeq + 1) % blockackscoreboard::SEQNO_SPACE;
+        }
+      for (uint16_t seq : ampdu)
+        {
+          originator.NotifySent (seq);
+        }
+      for (uint16_t seq : ampdu)
+        {
+          if (!lost[nextLoss++ % lost.size ()])
+            {
+              recipient.NotifyReceived (seq);
+            }
+        }
+      recipient.FillBitmap (bitmap.data (), winSize);
+      originator.NotifyBlockAck (recipient.GetWinStart (), bitmap.data (), winSize);
+      stopwatch.Stop ();
+      r.mpdus += ampdu.size ();
+      r.winStarts.push_back (originator.GetWinStart ());
+    }
+  r.ns = stopwatch.GetNs ();
+  return r;
+}
+
+} // unnamed namespace
+
+int
+RunBlockAckBench (int argc, char *argv[])
+{
+  std::string windows = "64,256,1024";
+  uint32_t ampdus = 10000;
+  double per = 0.1;
+
+  CommandLine cmd;
+  cmd.AddValue ("window", "Comma-separated Block Ack window sizes (at most 1024)", windows);
+  cmd.AddValue ("ampdus", "A-MPDUs per window size", ampdus);
+  cmd.AddValue ("per", "MPDU loss probability", per);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (ampdus > 0, "At least one A-MPDU is needed");
+
+  // The same losses for both scoreboards
+  Ptr<UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
+  std::vector<bool> lost (1 << 20);
+  for (std::size_t i = 0; i < lost.size (); i++)
+    {
+      lost[i] = rv->GetValue () < per;
+    }
+
+  std::cout << std::right << std::setw (7) << "window" << std::setw (13) << "MPDUs/A-MPDU"
+            << std::setw (12) << "ns/perbit" << std::setw (12) << "ns/bitmap" << std::endl;
+  for (const std::string &value : SplitList (windows))
+    {
+      uint32_t winSize = std::stoul (value);
+      NS_ABORT_MSG_UNLESS (winSize > 0 && winSize <= blockackscoreboard::MAX_WINDOW,
+                           "Window sizes must be between 1 and " << blockackscoreboard::MAX_WINDOW);
+      BlockAckResult perBit = RunExchanges<PerBitOriginator, PerBitRecipient> (winSize, ampdus, lost);
+      BlockAckResult bitmap = RunExchanges<OriginatorScoreboard, RecipientScoreboard> (winSize, ampdus, lost);
+      NS_ABORT_MSG_UNLESS (perBit.winStarts == bitmap.winStarts && perBit.mpdus == bitmap.mpdus,
+                           "The scoreboards moved their windows differently");
+      std::cout << std::setw (7) << winSize << std::fixed << std::setprecision (1)
+                << std::setw (13) << static_cast<double> (bitmap.mpdus) / ampdus
+                << std::setw (12) << perBit.ns / ampdus << std::setw (12) << bitmap.ns / ampdus << std::endl;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
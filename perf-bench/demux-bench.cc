@@ -0,0 +1,206 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// IPv4 end point demux benchmark (--bench=demux).
+//
+// The AP of a scenario with --flows flows receives --lookups packets of
+// random flows.  Two layouts of the end points of the AP:
+//
+//   sinks  one PacketSink per flow, bound to the AP address on ports 9,
+//          10, 11 and so on, as in ms-lab4, ms-lab6 and ms-lab7-outdoor,
+//   conns  one TCP listener on port 9 and one accepted connection per
+//          flow, allocated with its peer,
+//
+// are looked up with:
+//
+//   list    Ipv4EndPointDemux,
+//   hashed  HashedIpv4EndPointDemux (see hashed-ipv4-end-point-demux.h),
+//
+// which must find the same end points.  Reported: ns per lookup of each.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=demux --flows=10,100,1000"
+
+#include "perf-bench.h"
+#include "../hashed-ipv4-end-point-demux.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-end-point-demux.h"
+#include "ns3/ipv4-interface.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("DemuxBench");
+
+namespace {
+
+const uint16_t DEMUX_FIRST_PORT = 9;
+const uint16_t DEMUX_PEER_PORT = 49153;
+
+struct DemuxPacket
+{
+  Ipv4Address source;
+  uint16_t destinationPort;
+};
+
+/// The end points of one flow: its position in both demuxes
+struct DemuxFlow
+{
+  Ipv4EndPoint *list;
+  Ipv4EndPoint *hashed;
+};
+
+class DemuxBench
+{
+public:
+  /**
+   * \param nFlows the number of flows
+   * \param connections true for one connection per flow on one port,
+   * false for one sink per flow on its own port
+   */
+  DemuxBench (uint32_t nFlows, bool connections);
+
+  /// Look up the packets in both demuxes, checking that they agree
+  void Run (const std::vector<uint32_t> &flows, double &listNs, double &hashedNs);
+
+private:
+  template <typename DEMUX>
+  double LookUp (DEMUX &demux, const std::vector<uint32_t> &flows, std::vector<Ipv4EndPoint *> &found);
+
+  Ipv4Address m_address;
+  Ptr<Ipv4Interface> m_interface;
+  Ipv4EndPointDemux m_list;
+  HashedIpv4EndPointDemux m_hashed;
+  std::vector<DemuxPacket> m_packets;       //!< by flow
+  std::vector<DemuxFlow> m_flows;
+};
+
+DemuxBench::DemuxBench (uint32_t nFlows, bool connections)
+  : m_address ("10.1.0.1")
+{
+  m_interface = CreateObject<Ipv4Interface> ();
+  m_interface->AddAddress (Ipv4InterfaceAddress (m_address, Ipv4Mask ("255.255.0.0")));
+  if (connections)
+    {
+      m_list.Allocate (0, m_address, DEMUX_FIRST_PORT);
+      m_hashed.Allocate (0, m_address, DEMUX_FIRST_PORT);
+    }
+  for (uint32_t i = 0; i < nFlows; i++)
+    {
+      Ipv4Address source (m_address.Get () + 1 + i);
+      if (connections)
+        {
+          m_packets.push_back ({source, DEMUX_FIRST_PORT});
+          m_flows.push_back ({m_list.Allocate (0, m_address, DEMUX_FIRST_PORT, source, DEMUX_PEER_PORT),
+                              m_hashed.Allocate (0, m_address, DEMUX_FIRST_PORT, source, DEMUX_PEER_PORT)});
+        }
+      else
+        {
+          uint16_t port = DEMUX_FIRST_PORT + i;
+          m_packets.push_back ({source, port});
+          m_flows.push_back ({m_list.Allocate (0, m_address, port), m_hashed.Allocate (0, m_address, port)});
+        }
+    }
+}
+
+template <typename DEMUX>
+double
+DemuxBench::LookUp (DEMUX &demux, const std::vector<uint32_t> &flows, std::vector<Ipv4EndPoint *> &found)
+{
+  found.clear ();
+  Stopwatch stopwatch;
+  stopwatch.Start ();
+  for (uint32_t flow : flows)
+    {
+      const DemuxPacket &packet = m_packets[flow];
+      typename DEMUX::EndPoints endPoints = demux.Lookup (m_address, packet.destinationPort,
+                                                         packet.source, DEMUX_PEER_PORT, m_interface);
+      found.push_back (endPoints.empty () ? 0 : endPoints.front ());
+    }
+  stopwatch.Stop ();
+  return stopwatch.GetNs ();
+}
+
+void
+DemuxBench::Run (const std::vector<uint32_t> &flows, double &listNs, double &hashedNs)
+{
+  std::vector<Ipv4EndPoint *> listFound;
+  std::vector<Ipv4EndPoint *> hashedFound;
+  listNs = LookUp (m_list, flows, listFound);
+  hashedNs = LookUp (m_hashed, flows, hashedFound);
+  for (std::size_t i = 0; i < flows.size (); i++)
+    {
+      const DemuxFlow &flow = m_flows[flows[i]];
+      NS_ABORT_MSG_UNLESS (listFound[i] == flow.list && hashedFound[i] == flow.hashed,
+                           "The demuxes found different end points for flow " << flows[i]);
+    }
+  NS_LOG_INFO (flows.size () << " lookups, " << m_hashed.GetStatistics ().tupleHits << " by 4-tuple");
+}
+
+} // unnamed namespace
+
+int
+RunDemuxBench (int argc, char *argv[])
+{
+  std::string flowCounts = "10,100,1000";
+  uint32_t lookups = 1000000;
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Comma-separated numbers of flows", flowCounts);
+  cmd.AddValue ("lookups", "Lookups per number of flows and layout", lookups);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (lookups > 0, "At least one lookup is needed");
+
+  Ptr<UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
+  std::cout << std::right << std::setw (7) << "flows" << std::setw (14) << "ns/list sinks"
+            << std::setw (16) << "ns/hashed sinks" << std::setw (14) << "ns/list conns"
+            << std::setw (16) << "ns/hashed conns" << std::endl;
+  for (const std::string &value : SplitList (flowCounts))
+    {
+      uint32_t nFlows = std::stoul (value);
+      NS_ABORT_MSG_UNLESS (nFlows > 0 && nFlows <= DEMUX_PEER_PORT - DEMUX_FIRST_PORT,
+                           "The number of flows must be between 1 and " << DEMUX_PEER_PORT - DEMUX_FIRST_PORT);
+      std::vector<uint32_t> flows;
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          flows.push_back (rv->GetInteger (0, nFlows - 1));
+        }
+
+      std::cout << std::setw (7) << nFlows << std::fixed << std::setprecision (1);
+      for (bool connections : {false, true})
+        {
+          DemuxBench bench (nFlows, connections);
+          double listNs;
+          double hashedNs;
+          bench.Run (flows, listNs, hashedNs);
+          std::cout << std::setw (14) << listNs / lookups << std::setw (16) << hashedNs / lookups;
+        }
+      std::cout << std::endl;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
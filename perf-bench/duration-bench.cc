@@ -0,0 +1,220 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Frame duration benchmark (--bench=duration).
+//
+// Replays the duration computations of the frame exchanges of the
+// fixed-rate scenarios, with WifiPhy::CalculateTxDuration and with the
+// FrameDurationCache (see frame-duration-cache.h):
+//
+//   ofdm  802.11a at OfdmRate54Mbps, control frames at OfdmRate6Mbps, as
+//         in anomaly2_6_54 and anomaly_project: RTS, CTS, data, ACK and
+//         the NAV of each,
+//   he    802.11ax at HeMcs<mcs> for data and control frames, as in
+//         ms-lab4 and ms-lab6: A-MPDUs of 1 to --maxAmpdu MPDUs and their
+//         Block Ack.
+//
+// Reported: ns per duration, computed and cached, and the cache hit rate.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=duration --maxAmpdu=32"
+
+#include "perf-bench.h"
+#include "../frame-duration-cache.h"
+
+#include "ns3/core-module.h"
+#include "ns3/wifi-module.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("DurationBench");
+
+namespace {
+
+struct DurationQuery
+{
+  uint32_t size;
+  uint32_t txVector;                //!< index in the profile TXVECTORs
+};
+
+struct DurationProfile
+{
+  std::string name;
+  WifiPhyBand band;
+  std::vector<WifiTxVector> txVectors;
+  std::vector<DurationQuery> queries;
+};
+
+WifiTxVector
+MakeTxVector (WifiMode mode, WifiPreamble preamble)
+{
+  WifiTxVector txVector;
+  txVector.SetMode (mode);
+  txVector.SetPreambleType (preamble);
+  txVector.SetChannelWidth (20);
+  txVector.SetGuardInterval (800);
+  txVector.SetNss (1);
+  return txVector;
+}
+
+DurationProfile
+MakeOfdmProfile (uint32_t exchanges, uint32_t payloadSize)
+{
+  DurationProfile profile;
+  profile.name = "ofdm";
+  profile.band = WIFI_PHY_BAND_5GHZ;
+  profile.txVectors.push_back (MakeTxVector (WifiPhy::GetOfdmRate54Mbps (), WIFI_PREAMBLE_LONG));
+  profile.txVectors.push_back (MakeTxVector (WifiPhy::GetOfdmRate6Mbps (), WIFI_PREAMBLE_LONG));
+  // UDP, IP, LLC, QoS MAC header and FCS
+  uint32_t dataSize = payloadSize + 8 + 20 + 8 + 26 + 4;
+  for (uint32_t i = 0; i < exchanges; i++)
+    {
+      // RTS with the NAV of CTS, data and ACK; CTS with the NAV of data and
+      // ACK; data with the NAV of the ACK; ACK
+      profile.queries.push_back ({20, 1});
+      profile.queries.push_back ({14, 1});
+      profile.queries.push_back ({dataSize, 0});
+      profile.queries.push_back ({14, 1});
+      profile.queries.push_back ({14, 1});
+      profile.queries.push_back ({dataSize, 0});
+      profile.queries.push_back ({14, 1});
+      profile.queries.push_back ({dataSize, 0});
+      profile.queries.push_back ({14, 1});
+      profile.queries.push_back ({14, 1});
+    }
+  return profile;
+}
+
+DurationProfile
+MakeHeProfile (uint32_t exchanges, uint32_t payloadSize, uint32_t mcs, uint32_t maxAmpdu)
+{
+  static const WifiMode HE_MCS[] = {
+    WifiPhy::GetHeMcs0 (), WifiPhy::GetHeMcs1 (), WifiPhy::GetHeMcs2 (), WifiPhy::GetHeMcs3 (),
+    WifiPhy::GetHeMcs4 (), WifiPhy::GetHeMcs5 (), WifiPhy::GetHeMcs6 (), WifiPhy::GetHeMcs7 (),
+    WifiPhy::GetHeMcs8 (), WifiPhy::GetHeMcs9 (), WifiPhy::GetHeMcs10 (), WifiPhy::GetHeMcs11 ()
+  };
+  NS_ABORT_MSG_UNLESS (mcs < 12, "HE MCS must be between 0 and 11");
+  DurationProfile profile;
+  profile.name = "he";
+  profile.band = WIFI_PHY_BAND_5GHZ;
+  profile.txVectors.push_back (MakeTxVector (HE_MCS[mcs], WIFI_PREAMBLE_HE_SU));
+
+  Ptr<UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
+  // Padded MPDU with its A-MPDU subframe delimiter
+  uint32_t mpduSize = payloadSize + 8 + 20 + 8 + 26 + 4 + 4;
+  mpduSize += (4 - mpduSize % 4) % 4;
+  for (uint32_t i = 0; i < exchanges; i++)
+    {
+      uint32_t ampduSize = mpduSize * rv->GetInteger (1, maxAmpdu);
+      // A-MPDU with the NAV of the Block Ack; compressed Block Ack
+      profile.queries.push_back ({ampduSize, 0});
+      profile.queries.push_back ({32, 0});
+      profile.queries.push_back ({32, 0});
+    }
+  return profile;
+}
+
+void
+RunProfile (const DurationProfile &profile)
+{
+  // Every duration is kept, so that each cached one is checked
+  std::vector<int64_t> computedDurations (profile.queries.size ());
+  std::vector<int64_t> cachedDurations (profile.queries.size ());
+  Stopwatch computed;
+  computed.Start ();
+  for (std::size_t i = 0; i < profile.queries.size (); i++)
+    {
+      const DurationQuery &q = profile.queries[i];
+      computedDurations[i] = WifiPhy::CalculateTxDuration (q.size, profile.txVectors[q.txVector], profile.band).GetTimeStep ();
+    }
+  computed.Stop ();
+
+  FrameDurationCache &cache = FrameDurationCache::Get ();
+  cache.Clear ();
+  Stopwatch cached;
+  cached.Start ();
+  for (std::size_t i = 0; i < profile.queries.size (); i++)
+    {
+      const DurationQuery &q = profile.queries[i];
+      cachedDurations[i] = cache.GetTxDuration (q.size, profile.txVectors[q.txVector], profile.band).GetTimeStep ();
+    }
+  cached.Stop ();
+  for (std::size_t i = 0; i < profile.queries.size (); i++)
+    {
+      NS_ABORT_MSG_UNLESS (cachedDurations[i] == computedDurations[i],
+                           "Query " << i << " of " << profile.name << " (" << profile.queries[i].size
+                           << " bytes, TXVECTOR " << profile.queries[i].txVector << "): cached duration "
+                           << cachedDurations[i] << " differs from the computed " << computedDurations[i]);
+    }
+
+  const framedurations::Statistics &stats = cache.GetStatistics ();
+  double n = profile.queries.size ();
+  std::cout << std::left << std::setw (8) << profile.name << std::right << std::setw (11) << profile.queries.size ()
+            << std::fixed << std::setprecision (1) << std::setw (12) << computed.GetNs () / n
+            << std::setw (10) << cached.GetNs () / n << std::setprecision (2)
+            << std::setw (9) << 100.0 * stats.hits / n << "%" << std::setw (9) << stats.misses << std::endl;
+}
+
+} // unnamed namespace
+
+int
+RunDurationBench (int argc, char *argv[])
+{
+  std::string profiles = "ofdm,he";
+  uint32_t exchanges = 100000;
+  uint32_t payloadSize = 1472;
+  uint32_t mcs = 11;
+  uint32_t maxAmpdu = 42;
+
+  CommandLine cmd;
+  cmd.AddValue ("profiles", "Comma-separated frame mixes (ofdm, he)", profiles);
+  cmd.AddValue ("exchanges", "Frame exchanges per profile", exchanges);
+  cmd.AddValue ("payloadSize", "UDP payload [B]", payloadSize);
+  cmd.AddValue ("mcs", "HE MCS of the he profile", mcs);
+  cmd.AddValue ("maxAmpdu", "Maximum MPDUs per A-MPDU in the he profile", maxAmpdu);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (exchanges > 0 && maxAmpdu > 0, "exchanges and maxAmpdu must be positive");
+
+  std::cout << std::left << std::setw (8) << "profile" << std::right << std::setw (11) << "durations"
+            << std::setw (12) << "ns/computed" << std::setw (10) << "ns/cached"
+            << std::setw (10) << "hits" << std::setw (9) << "misses" << std::endl;
+  for (const std::string &name : SplitList (profiles))
+    {
+      if (name == "ofdm")
+        {
+          RunProfile (MakeOfdmProfile (exchanges, payloadSize));
+        }
+      else if (name == "he")
+        {
+          RunProfile (MakeHeProfile (exchanges, payloadSize, mcs, maxAmpdu));
+        }
+      else
+        {
+          NS_ABORT_MSG ("Unknown profile " << name);
+        }
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
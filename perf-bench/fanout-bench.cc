@@ -0,0 +1,331 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Wi-Fi channel fan-out benchmark (--bench=fanout).
+//
+// One transmitter and N idle receivers (802.11a ad hoc devices, as in
+// anomaly2_6_54) share a YansWifiChannel with the default LogDistance
+// loss; the receivers are placed uniformly on a disc around the
+// transmitter.  The transmitter PHY sends --frames data frames addressed
+// to no receiver, so that every receiver runs its PHY reception and drops
+// the frame in the MAC.  The cost per frame and per receiver is split
+// into:
+//
+//   loss   PropagationLossModel::CalcRxPower and the propagation delay,
+//   copy   Packet::Copy of the frame, which the channel does per receiver,
+//   sched  scheduling and running one empty event per receiver,
+//   phy    the rest of the full delivery: PHY reception start and end,
+//          interference tracking and the MAC drop.
+//
+// The first three are measured on their own with the same receivers; phy
+// is the full delivery time minus the three.  "rx" is the fraction of
+// receivers above the PHY sensitivity.
+//
+// With --sharedDelivery=1 the PHYs are SharedDeliveryYansWifiPhy (see
+// shared-delivery-yans-wifi-phy.h), which skip the receivers below the
+// sensitivity and share one PPDU between the others.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=fanout --receivers=1,10,100,1000,10000"
+
+#include "perf-bench.h"
+#include "../shared-delivery-yans-wifi-phy.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/wifi-module.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("FanoutBench");
+
+namespace {
+
+struct FanoutResult
+{
+  double loss = 0;
+  double copy = 0;
+  double sched = 0;
+  double total = 0;
+  uint64_t aboveSensitivity = 0;
+};
+
+class FanoutBench
+{
+public:
+  FanoutBench (uint32_t nReceivers, uint32_t nFrames, uint32_t packetSize, double radius, bool shared);
+  FanoutResult Run (void);
+
+private:
+  void Setup (void);
+  void MeasureLoss (void);
+  void MeasureCopy (void);
+  void MeasureScheduling (void);
+  void MeasureDelivery (void);
+  void Fanout (void);
+  void Send (void);
+  static void Noop (void);
+
+  uint32_t m_nReceivers;
+  uint32_t m_nFrames;
+  uint32_t m_packetSize;
+  double m_radius;
+  bool m_shared;
+
+  NodeContainer m_transmitter;
+  NodeContainer m_receivers;
+  Ptr<WifiPhy> m_phy;
+  Ptr<PropagationLossModel> m_loss;
+  Ptr<PropagationDelayModel> m_delay;
+  Ptr<MobilityModel> m_txMobility;
+  std::vector<Ptr<MobilityModel> > m_rxMobility;
+  std::vector<Time> m_rxDelay;
+  WifiMacHeader m_header;
+  WifiTxVector m_txVector;
+  double m_txPowerDbm;
+  FanoutResult m_result;
+};
+
+FanoutBench::FanoutBench (uint32_t nReceivers, uint32_t nFrames, uint32_t packetSize, double radius, bool shared)
+  : m_nReceivers (nReceivers),
+    m_nFrames (nFrames),
+    m_packetSize (packetSize),
+    m_radius (radius),
+    m_shared (shared),
+    m_txPowerDbm (16.0206)
+{
+}
+
+void
+FanoutBench::Noop (void)
+{
+}
+
+void
+FanoutBench::Setup (void)
+{
+  m_transmitter.Create (1);
+  m_receivers.Create (m_nReceivers);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (m_transmitter);
+  Ptr<UniformDiscPositionAllocator> positionAlloc = CreateObject<UniformDiscPositionAllocator> ();
+  positionAlloc->SetRho (m_radius);
+  mobility.SetPositionAllocator (positionAlloc);
+  mobility.Install (m_receivers);
+
+  YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
+  Ptr<YansWifiChannel> channel = channelHelper.Create ();
+  SharedDeliveryPhyHelper phy (m_shared);
+  phy.SetChannel (channel);
+  phy.Set ("TxPowerStart", DoubleValue (m_txPowerDbm));
+  phy.Set ("TxPowerEnd", DoubleValue (m_txPowerDbm));
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_STANDARD_80211a);
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                "DataMode", StringValue ("OfdmRate54Mbps"),
+                                "ControlMode", StringValue ("OfdmRate6Mbps"));
+  WifiMacHelper mac;
+  mac.SetType ("ns3::AdhocWifiMac");
+  NetDeviceContainer devices = wifi.Install (phy, mac, m_transmitter);
+  wifi.Install (phy, mac, m_receivers);
+
+  m_phy = DynamicCast<WifiNetDevice> (devices.Get (0))->GetPhy ();
+  PointerValue loss;
+  channel->GetAttribute ("PropagationLossModel", loss);
+  m_loss = loss.Get<PropagationLossModel> ();
+  PointerValue delay;
+  channel->GetAttribute ("PropagationDelayModel", delay);
+  m_delay = delay.Get<PropagationDelayModel> ();
+
+  m_txMobility = m_transmitter.Get (0)->GetObject<MobilityModel> ();
+  for (NodeContainer::Iterator i = m_receivers.Begin (); i != m_receivers.End (); i++)
+    {
+      m_rxMobility.push_back ((*i)->GetObject<MobilityModel> ());
+      m_rxDelay.push_back (m_delay->GetDelay (m_txMobility, m_rxMobility.back ()));
+    }
+
+  // A locally administered address, never allocated to a device
+  m_header.SetType (WIFI_MAC_DATA);
+  m_header.SetAddr1 (Mac48Address ("02:00:00:00:00:01"));
+  m_header.SetAddr2 (Mac48Address::ConvertFrom (devices.Get (0)->GetAddress ()));
+  m_header.SetAddr3 (Mac48Address ("02:00:00:00:00:01"));
+  m_header.SetDsNotFrom ();
+  m_header.SetDsNotTo ();
+  m_txVector.SetMode (WifiMode ("OfdmRate54Mbps"));
+  m_txVector.SetPreambleType (WIFI_PREAMBLE_LONG);
+  m_txVector.SetChannelWidth (20);
+  m_txVector.SetNss (1);
+  m_txVector.SetTxPowerLevel (0);
+
+  // Run the device initialization out of the measurements
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+}
+
+void
+FanoutBench::MeasureLoss (void)
+{
+  DoubleValue sensitivity;
+  m_phy->GetAttribute ("RxSensitivity", sensitivity);
+  Stopwatch watch;
+  watch.Start ();
+  for (uint32_t frame = 0; frame < m_nFrames; frame++)
+    {
+      for (uint32_t i = 0; i < m_nReceivers; i++)
+        {
+          double rxPowerDbm = m_loss->CalcRxPower (m_txPowerDbm, m_txMobility, m_rxMobility[i]);
+          m_delay->GetDelay (m_txMobility, m_rxMobility[i]);
+          if (frame == 0 && rxPowerDbm >= sensitivity.Get ())
+            {
+              m_result.aboveSensitivity++;
+            }
+        }
+    }
+  watch.Stop ();
+  m_result.loss = watch.GetNs ();
+}
+
+void
+FanoutBench::MeasureCopy (void)
+{
+  Ptr<Packet> frame = Create<Packet> (m_packetSize);
+  frame->AddHeader (m_header);
+  std::vector<Ptr<Packet> > copies (m_nReceivers);
+  Stopwatch watch;
+  watch.Start ();
+  for (uint32_t f = 0; f < m_nFrames; f++)
+    {
+      for (uint32_t i = 0; i < m_nReceivers; i++)
+        {
+          copies[i] = frame->Copy ();
+        }
+    }
+  watch.Stop ();
+  m_result.copy = watch.GetNs ();
+}
+
+void
+FanoutBench::Fanout (void)
+{
+  for (uint32_t i = 0; i < m_nReceivers; i++)
+    {
+      Simulator::ScheduleWithContext (m_receivers.Get (i)->GetId (), m_rxDelay[i], &FanoutBench::Noop);
+    }
+}
+
+void
+FanoutBench::MeasureScheduling (void)
+{
+  for (uint32_t f = 0; f < m_nFrames; f++)
+    {
+      Simulator::Schedule (MilliSeconds (1 + f), &FanoutBench::Fanout, this);
+    }
+  Stopwatch watch;
+  watch.Start ();
+  Simulator::Run ();
+  watch.Stop ();
+  m_result.sched = watch.GetNs ();
+}
+
+void
+FanoutBench::Send (void)
+{
+  m_phy->Send (Create<WifiPsdu> (Create<Packet> (m_packetSize), m_header), m_txVector);
+}
+
+void
+FanoutBench::MeasureDelivery (void)
+{
+  // A 1500 byte frame lasts about 250 us at 54 Mb/s: the transmitter is
+  // idle again long before the next one
+  for (uint32_t f = 0; f < m_nFrames; f++)
+    {
+      Simulator::Schedule (MilliSeconds (1 + f), &FanoutBench::Send, this);
+    }
+  Stopwatch watch;
+  watch.Start ();
+  Simulator::Run ();
+  watch.Stop ();
+  m_result.total = watch.GetNs ();
+}
+
+FanoutResult
+FanoutBench::Run (void)
+{
+  Setup ();
+  MeasureLoss ();
+  MeasureCopy ();
+  MeasureScheduling ();
+  MeasureDelivery ();
+  Simulator::Destroy ();
+  return m_result;
+}
+
+} // unnamed namespace
+
+int
+RunFanoutBench (int argc, char *argv[])
+{
+  std::string receivers = "1,10,100,1000,10000";
+  uint32_t frames = 100;
+  uint32_t packetSize = 1500;
+  double radius = 50;
+  bool sharedDelivery = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("receivers", "Comma-separated numbers of receivers", receivers);
+  cmd.AddValue ("frames", "Frames sent per configuration", frames);
+  cmd.AddValue ("packetSize", "Frame payload [B]", packetSize);
+  cmd.AddValue ("radius", "Radius of the disc of receivers [m]", radius);
+  cmd.AddValue ("sharedDelivery", "Use SharedDeliveryYansWifiPhy", sharedDelivery);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (frames > 0, "At least one frame is needed");
+
+  std::cout << "ns per frame and receiver" << std::endl
+            << std::right << std::setw (9) << "receivers" << std::setw (7) << "rx"
+            << std::setw (10) << "total" << std::setw (9) << "loss" << std::setw (9) << "copy"
+            << std::setw (9) << "sched" << std::setw (9) << "phy" << std::endl;
+
+  for (const std::string &count : SplitList (receivers))
+    {
+      uint32_t nReceivers = std::stoul (count);
+      NS_ABORT_MSG_UNLESS (nReceivers > 0, "The number of receivers must be positive");
+      FanoutBench bench (nReceivers, frames, packetSize, radius, sharedDelivery);
+      FanoutResult r = bench.Run ();
+      double deliveries = static_cast<double> (frames) * nReceivers;
+      std::cout << std::setw (9) << nReceivers << std::fixed << std::setprecision (0)
+                << std::setw (6) << 100.0 * r.aboveSensitivity / nReceivers << "%"
+                << std::setprecision (1) << std::setw (10) << r.total / deliveries
+                << std::setw (9) << r.loss / deliveries << std::setw (9) << r.copy / deliveries
+                << std::setw (9) << r.sched / deliveries
+                << std::setw (9) << (r.total - r.loss - r.copy - r.sched) / deliveries << std::endl;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
@@ -0,0 +1,223 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Wi-Fi MAC queue benchmark (--bench=macqueue).
+//
+// The queue of an AP holds --depth QoS data frames of TID 0 for --stations
+// receivers, in random order.  Each operation picks a receiver, dequeues up
+// to --burst of its frames by receiver and TID, as an A-MPDU is built, and
+// enqueues as many new frames for random receivers, so that the depth
+// stays constant.  The same operations are run on:
+//
+//   list     WifiMacQueue,
+//   indexed  IndexedMacQueue (see indexed-mac-queue.h),
+//
+// which must return the same frames.  Then the whole queue expires, and
+// one Dequeue call on each removes it.  Reported: ns per dequeued frame and
+// ns per expired frame.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=macqueue --depth=100,1000,10000 --stations=20"
+
+#include "perf-bench.h"
+#include "../indexed-mac-queue.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("MacQueueBench");
+
+namespace {
+
+const Time MACQUEUE_LIFETIME = MilliSeconds (500);
+
+struct MacQueueWorkload
+{
+  std::vector<Mac48Address> stations;
+  std::vector<Ptr<WifiMacQueueItem> > initial;  //!< frames filling the queue
+  std::vector<uint32_t> targets;                //!< receiver of each operation
+  std::vector<Ptr<WifiMacQueueItem> > refill;   //!< frames enqueued by the operations
+};
+
+MacQueueWorkload
+MakeWorkload (uint32_t depth, uint32_t nStations, uint32_t operations, uint32_t burst)
+{
+  Ptr<UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
+  MacQueueWorkload w;
+  for (uint32_t i = 0; i < nStations; i++)
+    {
+      w.stations.push_back (Mac48Address::Allocate ());
+    }
+  Ptr<Packet> packet = Create<Packet> (1472);
+  auto makeItem = [&w, &rv, nStations, packet] ()
+    {
+      WifiMacHeader header;
+      header.SetType (WIFI_MAC_QOSDATA);
+      header.SetAddr1 (w.stations[rv->GetInteger (0, nStations - 1)]);
+      header.SetQosTid (0);
+      return Create<WifiMacQueueItem> (packet, header);
+    };
+  for (uint32_t i = 0; i < depth; i++)
+    {
+      w.initial.push_back (makeItem ());
+    }
+  for (uint32_t i = 0; i < operations; i++)
+    {
+      w.targets.push_back (rv->GetInteger (0, nStations - 1));
+    }
+  // At most burst frames are enqueued per operation
+  for (uint64_t i = 0; i < static_cast<uint64_t> (operations) * burst; i++)
+    {
+      w.refill.push_back (makeItem ());
+    }
+  return w;
+}
+
+struct MacQueueResult
+{
+  double dequeueNs = 0;
+  uint64_t dequeued = 0;
+  double expireNs = 0;
+  uint64_t expired = 0;
+};
+
+/**
+ * Run the workload on queue, which has the interface of WifiMacQueue,
+ * and store the dequeued frames in dequeued
+ */
+template <typename QUEUE>
+MacQueueResult
+RunQueue (QUEUE &queue, const MacQueueWorkload &w, uint32_t burst,
+          std::vector<Ptr<WifiMacQueueItem> > &dequeued)
+{
+  MacQueueResult r;
+  for (const Ptr<WifiMacQueueItem> &item : w.initial)
+    {
+      queue.Enqueue (item);
+    }
+  std::size_t next = 0;
+  Stopwatch dequeueTime;
+  dequeueTime.Start ();
+  for (uint32_t target : w.targets)
+    {
+      uint32_t n = 0;
+      Ptr<WifiMacQueueItem> item;
+      while (n < burst && (item = queue.DequeueByTidAndAddress (0, w.stations[target])) != 0)
+        {
+          dequeued.push_back (item);
+          n++;
+        }
+      for (uint32_t i = 0; i < n; i++)
+        {
+          queue.Enqueue (w.refill[next++]);
+        }
+      r.dequeued += n;
+    }
+  dequeueTime.Stop ();
+  r.dequeueNs = dequeueTime.GetNs ();
+  return r;
+}
+
+template <typename QUEUE>
+void
+Expire (QUEUE *queue, MacQueueResult *r)
+{
+  Stopwatch expireTime;
+  expireTime.Start ();
+  Ptr<WifiMacQueueItem> item = queue->Dequeue ();
+  expireTime.Stop ();
+  NS_ABORT_MSG_UNLESS (item == 0, "Frames left after their lifetime");
+  r->expireNs = expireTime.GetNs ();
+}
+
+/// Run Expire on queue after the lifetime of the frames
+template <typename QUEUE>
+void
+RunExpiry (QUEUE *queue, MacQueueResult *r)
+{
+  r->expired = queue->GetNPackets ();
+  Simulator::Schedule (MACQUEUE_LIFETIME + NanoSeconds (1), &Expire<QUEUE>, queue, r);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+} // unnamed namespace
+
+int
+RunMacQueueBench (int argc, char *argv[])
+{
+  std::string depths = "100,1000,10000";
+  uint32_t nStations = 20;
+  uint32_t operations = 10000;
+  uint32_t burst = 32;
+
+  CommandLine cmd;
+  cmd.AddValue ("depth", "Comma-separated queue depths [packets]", depths);
+  cmd.AddValue ("stations", "Receivers of the queued frames", nStations);
+  cmd.AddValue ("operations", "Dequeue bursts per depth", operations);
+  cmd.AddValue ("burst", "Frames dequeued per burst (A-MPDU size)", burst);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (nStations > 0 && operations > 0 && burst > 0,
+                       "stations, operations and burst must be positive");
+
+  std::cout << std::right << std::setw (8) << "depth" << std::setw (10) << "dequeued"
+            << std::setw (13) << "ns/list" << std::setw (13) << "ns/indexed"
+            << std::setw (16) << "expiry ns/list" << std::setw (19) << "expiry ns/indexed" << std::endl;
+  for (const std::string &value : SplitList (depths))
+    {
+      uint32_t depth = std::stoul (value);
+      MacQueueWorkload w = MakeWorkload (depth, nStations, operations, burst);
+
+      Ptr<WifiMacQueue> list = CreateObject<WifiMacQueue> ();
+      list->SetMaxSize (QueueSize (QueueSizeUnit::PACKETS, depth));
+      list->SetMaxDelay (MACQUEUE_LIFETIME);
+      std::vector<Ptr<WifiMacQueueItem> > listDequeued;
+      MacQueueResult listResult = RunQueue (*list, w, burst, listDequeued);
+      RunExpiry (PeekPointer (list), &listResult);
+
+      IndexedMacQueue indexed (depth, MACQUEUE_LIFETIME);
+      std::vector<Ptr<WifiMacQueueItem> > indexedDequeued;
+      MacQueueResult indexedResult = RunQueue (indexed, w, burst, indexedDequeued);
+      RunExpiry (&indexed, &indexedResult);
+
+      NS_ABORT_MSG_UNLESS (listDequeued == indexedDequeued, "The queues returned different frames");
+      NS_LOG_INFO (indexed.GetStatistics ().expired << " frames expired in the indexed queue");
+
+      double dequeued = std::max<uint64_t> (listResult.dequeued, 1);
+      double expired = std::max<uint64_t> (listResult.expired, 1);
+      std::cout << std::setw (8) << depth << std::setw (10) << listResult.dequeued
+                << std::fixed << std::setprecision (1)
+                << std::setw (13) << listResult.dequeueNs / dequeued
+                << std::setw (13) << indexedResult.dequeueNs / dequeued
+                << std::setw (16) << listResult.expireNs / expired
+                << std::setw (19) << indexedResult.expireNs / expired << std::endl;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
@@ -0,0 +1,241 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Microbenchmark driver.  Usage:
+//
+//   ./waf --run "perf-bench --bench=qdisc [benchmark options]"
+//   ./waf --run "perf-bench --bench=qdisc --PrintHelp"
+//
+// Available benchmarks:
+//   qdisc     per-packet CPU cost of the queue discs used by the scenarios
+//   sched     event schedulers replaying the scenarios' recorded event times
+//   timer     restartable timers: cancel/reschedule versus the timer wheel
+//   suite     fixed variants of the scenarios, compared with stored baselines
+//   fanout    Wi-Fi channel delivery cost per receiver, by receiver count
+//   duration  Wi-Fi frame durations: computed versus memoized
+//   sinr      interference chunks of a reception: from scratch versus incremental
+//   validate  Wi-Fi scenario results with PHY approximations versus the detailed PHY
+//   macqueue  Wi-Fi MAC queue dequeue by receiver and TID: list versus indexed
+//   aggregate A-MPDU construction: copies versus scatter-gather
+//   blockack  Block Ack scoreboards: bit by bit versus word-wide bitmaps
+//   stations  Wi-Fi remote station lookup: list walk versus hash table
+//   demux     IPv4 end point lookup: list walk versus hash tables
+
+#include "perf-bench.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint64_t g_allocations = 0;
+
+} // unnamed namespace
+
+// Count every heap allocation of the program, so that benchmarks can
+// report allocations per operation
+void *
+operator new (std::size_t size)
+{
+  g_allocations++;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return operator new (size);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete[] (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+namespace ns3 {
+namespace perfbench {
+
+uint64_t
+GetAllocationCount (void)
+{
+  return g_allocations;
+}
+
+Stopwatch::Stopwatch ()
+  : m_ns (0)
+{
+}
+
+void
+Stopwatch::Start (void)
+{
+  m_start = std::chrono::steady_clock::now ();
+}
+
+void
+Stopwatch::Stop (void)
+{
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - m_start;
+  m_ns += elapsed.count ();
+}
+
+double
+Stopwatch::GetNs (void) const
+{
+  return m_ns;
+}
+
+std::vector<std::string>
+SplitList (const std::string &list)
+{
+  std::vector<std::string> items;
+  std::istringstream iss (list);
+  std::string item;
+  while (std::getline (iss, item, ','))
+    {
+      if (!item.empty ())
+        {
+          items.push_back (item);
+        }
+    }
+  return items;
+}
+
+std::map<std::string, std::string>
+ParseFields (const std::string &line)
+{
+  std::map<std::string, std::string> fields;
+  std::istringstream iss (line);
+  std::string field;
+  while (iss >> field)
+    {
+      std::string::size_type eq = field.find ('=');
+      if (eq != std::string::npos)
+        {
+          fields[field.substr (0, eq)] = field.substr (eq + 1);
+        }
+    }
+  return fields;
+}
+
+} // namespace perfbench
+} // namespace ns3
+
+int
+main (int argc, char *argv[])
+{
+  std::string bench;
+  std::vector<char *> args;
+  args.push_back (argv[0]);
+  for (int i = 1; i < argc; ++i)
+    {
+      if (std::strncmp (argv[i], "--bench=", 8) == 0)
+        {
+          bench = argv[i] + 8;
+        }
+      else
+        {
+          args.push_back (argv[i]);
+        }
+    }
+
+  if (bench == "qdisc")
+    {
+      return ns3::perfbench::RunQueueDiscBench (args.size (), args.data ());
+    }
+  if (bench == "sched")
+    {
+      return ns3::perfbench::RunSchedulerBench (args.size (), args.data ());
+    }
+  if (bench == "timer")
+    {
+      return ns3::perfbench::RunTimerBench (args.size (), args.data ());
+    }
+  if (bench == "suite")
+    {
+      return ns3::perfbench::RunSuiteBench (args.size (), args.data ());
+    }
+  if (bench == "fanout")
+    {
+      return ns3::perfbench::RunFanoutBench (args.size (), args.data ());
+    }
+  if (bench == "duration")
+    {
+      return ns3::perfbench::RunDurationBench (args.size (), args.data ());
+    }
+  if (bench == "sinr")
+    {
+      return ns3::perfbench::RunSinrBench (args.size (), args.data ());
+    }
+  if (bench == "validate")
+    {
+      return ns3::perfbench::RunValidateBench (args.size (), args.data ());
+    }
+  if (bench == "macqueue")
+    {
+      return ns3::perfbench::RunMacQueueBench (args.size (), args.data ());
+    }
+  if (bench == "aggregate")
+    {
+      return ns3::perfbench::RunAggregateBench (args.size (), args.data ());
+    }
+  if (bench == "blockack")
+    {
+      return ns3::perfbench::RunBlockAckBench (args.size (), args.data ());
+    }
+  if (bench == "stations")
+    {
+      return ns3::perfbench::RunStationsBench (args.size (), args.data ());
+    }
+  if (bench == "demux")
+    {
+      return ns3::perfbench::RunDemuxBench (args.size (), args.data ());
+    }
+
+  std::cerr << "Usage: perf-bench --bench=<name> [options]" << std::endl
+            << "Available benchmarks: qdisc, sched, timer, suite, fanout, duration, sinr, validate, macqueue, aggregate, blockack, stations, demux" << std::endl;
+  return 1;
+}
@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PERF_BENCH_H
+#define PERF_BENCH_H
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Stand-alone microbenchmarks of individual models, selected with
+// --bench=<name>.  The remaining arguments are parsed by the selected
+// benchmark.  Every benchmark is defined in its own file of this directory.
+
+namespace ns3 {
+namespace perfbench {
+
+/**
+ * \returns the number of heap allocations (operator new calls) made by the
+ * program so far
+ */
+uint64_t GetAllocationCount (void);
+
+/**
+ * Wall-clock stopwatch used to time the measured sections
+ */
+class Stopwatch
+{
+public:
+  Stopwatch ();
+  void Start (void);
+  void Stop (void);
+  /// \returns the accumulated time between Start and Stop calls, in ns
+  double GetNs (void) const;
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+  double m_ns;
+};
+
+/// \returns the non-empty items of a comma-separated list
+std::vector<std::string> SplitList (const std::string &list);
+
+/// \returns the fields of a line of "key=value" pairs
+std::map<std::string, std::string> ParseFields (const std::string &line);
+
+int RunQueueDiscBench (int argc, char *argv[]);
+int RunSchedulerBench (int argc, char *argv[]);
+int RunTimerBench (int argc, char *argv[]);
+int RunSuiteBench (int argc, char *argv[]);
+int RunFanoutBench (int argc, char *argv[]);
+int RunDurationBench (int argc, char *argv[]);
+int RunSinrBench (int argc, char *argv[]);
+int RunValidateBench (int argc, char *argv[]);
+int RunMacQueueBench (int argc, char *argv[]);
+int RunAggregateBench (int argc, char *argv[]);
+int RunBlockAckBench (int argc, char *argv[]);
+int RunStationsBench (int argc, char *argv[]);
+int RunDemuxBench (int argc, char *argv[]);
+
+} // namespace perfbench
+} // namespace ns3
+
+#endif /* PERF_BENCH_H */
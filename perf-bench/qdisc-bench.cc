@@ -0,0 +1,373 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Queue disc microbenchmark (--bench=qdisc).
+//
+// Drives the queue discs used by tcp-validation (FqCoDel, CoDel, PIE, RED),
+// traffic-control (RED), tbf-example (TBF) and ms-lab7-queue (FIFO)
+// directly, without nodes, devices or applications.  Every configuration
+// (queue disc, packet sizes, number of flows, ECN) is run as a sequence of
+// batches, one simulator event per batch:
+//
+//   - batchSize IPv4/UDP items are built (not measured),
+//   - the items are enqueued (measured),
+//   - batchSize items are dequeued (measured),
+//   - simulated time advances by step before the next batch.
+//
+// The queue is prefilled with backlog packets, so that with the default
+// step the sojourn time exceeds the CoDel/PIE targets and the AQM drop and
+// mark paths are exercised.  ECN-capable packets are sent when ECN is on.
+// Items are built up front and released after the dequeue loop, so the
+// reported allocations per packet are those made by the queue disc itself.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=qdisc --qdiscs=FqCoDel,CoDel --flows=1,64,1024"
+
+#include "perf-bench.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("QueueDiscBench");
+
+namespace {
+
+struct QdiscBenchConfig
+{
+  std::string qdisc;     //!< short name, e.g. FqCoDel
+  bool randomSize;       //!< uniform 64-1500 byte packets instead of 1500 bytes
+  uint32_t nFlows;       //!< number of distinct 5-tuples
+  bool ecn;              //!< UseEcn on the queue disc and ECT packets
+};
+
+struct QdiscBenchResult
+{
+  uint64_t enqueued = 0;
+  uint64_t dequeued = 0;
+  double enqueueNs = 0;
+  double dequeueNs = 0;
+  uint64_t allocations = 0;
+  uint64_t drops = 0;
+  uint64_t marks = 0;
+};
+
+class QueueDiscBench
+{
+public:
+  QueueDiscBench (const QdiscBenchConfig &config, uint32_t limit, uint32_t backlog,
+                  uint32_t batchSize, uint32_t batches, uint32_t warmupBatches, Time step);
+  QdiscBenchResult Run (void);
+
+private:
+  Ptr<QueueDisc> CreateQueueDisc (void) const;
+  Ptr<QueueDiscItem> MakeItem (void);
+  void Batch (void);
+
+  QdiscBenchConfig m_config;
+  uint32_t m_limit;
+  uint32_t m_backlog;
+  uint32_t m_batchSize;
+  uint32_t m_batches;
+  uint32_t m_warmupBatches;
+  Time m_step;
+
+  Ptr<QueueDisc> m_qd;
+  Ptr<UniformRandomVariable> m_flowRv;
+  Ptr<UniformRandomVariable> m_sizeRv;
+  std::vector<Ptr<QueueDiscItem> > m_items;
+  uint32_t m_batch;
+  Stopwatch m_enqueueWatch;
+  Stopwatch m_dequeueWatch;
+  QueueDisc::Stats m_before;        //!< stats when the first measured batch starts
+  QdiscBenchResult m_result;
+};
+
+QueueDiscBench::QueueDiscBench (const QdiscBenchConfig &config, uint32_t limit, uint32_t backlog,
+                                uint32_t batchSize, uint32_t batches, uint32_t warmupBatches, Time step)
+  : m_config (config),
+    m_limit (limit),
+    m_backlog (backlog),
+    m_batchSize (batchSize),
+    m_batches (batches),
+    m_warmupBatches (warmupBatches),
+    m_step (step),
+    m_batch (0)
+{
+}
+
+Ptr<QueueDisc>
+QueueDiscBench::CreateQueueDisc (void) const
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::" + m_config.qdisc + "QueueDisc");
+  factory.Set ("MaxSize", QueueSizeValue (QueueSize (QueueSizeUnit::PACKETS, m_limit)));
+  if (m_config.qdisc == "FqCoDel")
+    {
+      // There is no device to take the quantum from
+      factory.Set ("Quantum", UintegerValue (1500));
+    }
+  else if (m_config.qdisc == "Tbf")
+    {
+      // Shape well above the offered load, so that dequeues are never
+      // deferred waiting for tokens
+      factory.Set ("Rate", DataRateValue (DataRate ("100Gbps")));
+      factory.Set ("Burst", UintegerValue (1000000));
+      factory.Set ("Mtu", UintegerValue (1500));
+    }
+  if (m_config.ecn)
+    {
+      factory.Set ("UseEcn", BooleanValue (true));
+    }
+  Ptr<QueueDisc> qd = factory.Create<QueueDisc> ();
+  qd->Initialize ();
+  return qd;
+}
+
+Ptr<QueueDiscItem>
+QueueDiscBench::MakeItem (void)
+{
+  uint32_t flow = m_flowRv->GetInteger (0, m_config.nFlows - 1);
+  uint32_t size = m_config.randomSize ? m_sizeRv->GetInteger (64, 1500) : 1500;
+
+  Ptr<Packet> p = Create<Packet> (size - 28);
+  UdpHeader udpHeader;
+  udpHeader.SetSourcePort (1024 + flow % 60000);
+  udpHeader.SetDestinationPort (9);
+  p->AddHeader (udpHeader);
+
+  Ipv4Header ipHeader;
+  ipHeader.SetSource (Ipv4Address (0x0a000000 + flow / 60000 + 1));
+  ipHeader.SetDestination (Ipv4Address ("10.255.0.1"));
+  ipHeader.SetProtocol (UdpL4Protocol::PROT_NUMBER);
+  ipHeader.SetPayloadSize (p->GetSize ());
+  ipHeader.SetTtl (64);
+  ipHeader.SetEcn (m_config.ecn ? Ipv4Header::ECN_ECT0 : Ipv4Header::ECN_NotECT);
+  return Create<Ipv4QueueDiscItem> (p, Address (), Ipv4L3Protocol::PROT_NUMBER, ipHeader);
+}
+
+void
+QueueDiscBench::Batch (void)
+{
+  bool measure = (m_batch >= m_warmupBatches);
+  if (m_batch == m_warmupBatches)
+    {
+      // Drops and marks are counted against the measured enqueues only
+      m_before = m_qd->GetStats ();
+    }
+
+  for (uint32_t i = 0; i < m_batchSize; i++)
+    {
+      m_items.push_back (MakeItem ());
+    }
+  uint64_t allocations = GetAllocationCount ();
+  if (measure)
+    {
+      m_enqueueWatch.Start ();
+    }
+  for (uint32_t i = 0; i < m_batchSize; i++)
+    {
+      m_qd->Enqueue (m_items[i]);
+    }
+  if (measure)
+    {
+      m_enqueueWatch.Stop ();
+      m_result.allocations += GetAllocationCount () - allocations;
+      m_result.enqueued += m_batchSize;
+    }
+  m_items.clear ();
+
+  allocations = GetAllocationCount ();
+  if (measure)
+    {
+      m_dequeueWatch.Start ();
+    }
+  for (uint32_t i = 0; i < m_batchSize; i++)
+    {
+      Ptr<QueueDiscItem> item = m_qd->Dequeue ();
+      if (item == 0)
+        {
+          break;
+        }
+      // Released after the measured loop
+      m_items.push_back (item);
+    }
+  if (measure)
+    {
+      m_dequeueWatch.Stop ();
+      m_result.allocations += GetAllocationCount () - allocations;
+      m_result.dequeued += m_items.size ();
+    }
+  m_items.clear ();
+
+  if (++m_batch < m_batches)
+    {
+      Simulator::Schedule (m_step, &QueueDiscBench::Batch, this);
+    }
+  else
+    {
+      // PIE keeps a periodic update event pending
+      Simulator::Stop ();
+    }
+}
+
+QdiscBenchResult
+QueueDiscBench::Run (void)
+{
+  m_flowRv = CreateObject<UniformRandomVariable> ();
+  m_sizeRv = CreateObject<UniformRandomVariable> ();
+  m_items.reserve (std::max (m_batchSize, m_backlog));
+  m_qd = CreateQueueDisc ();
+
+  for (uint32_t i = 0; i < m_backlog; i++)
+    {
+      m_qd->Enqueue (MakeItem ());
+    }
+
+  Simulator::Schedule (m_step, &QueueDiscBench::Batch, this);
+  Simulator::Run ();
+
+  QueueDisc::Stats after = m_qd->GetStats ();
+  m_result.drops = after.nTotalDroppedPackets - m_before.nTotalDroppedPackets;
+  m_result.marks = after.nTotalMarkedPackets - m_before.nTotalMarkedPackets;
+  m_result.enqueueNs = m_enqueueWatch.GetNs ();
+  m_result.dequeueNs = m_dequeueWatch.GetNs ();
+
+  m_qd->Dispose ();
+  m_qd = 0;
+  Simulator::Destroy ();
+  return m_result;
+}
+
+bool
+SupportsEcn (const std::string &qdisc)
+{
+  return qdisc == "FqCoDel" || qdisc == "CoDel" || qdisc == "Pie" || qdisc == "Red";
+}
+
+} // unnamed namespace
+
+int
+RunQueueDiscBench (int argc, char *argv[])
+{
+  std::string qdiscs = "FqCoDel,CoDel,Pie,Red,Tbf,Fifo";
+  std::string flows = "1,16,256,4096";
+  std::string sizes = "fixed,random";
+  std::string ecn = "off,on";
+  uint32_t limit = 10000;
+  uint32_t backlog = 200;
+  uint32_t batchSize = 32;
+  uint32_t batches = 20000;
+  uint32_t warmupBatches = 1000;
+  Time step = MilliSeconds (1);
+  std::string csvFile = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("qdiscs", "Comma-separated queue discs (FqCoDel, CoDel, Pie, Red, Tbf, Fifo)", qdiscs);
+  cmd.AddValue ("flows", "Comma-separated numbers of flows", flows);
+  cmd.AddValue ("sizes", "Comma-separated packet size modes (fixed, random)", sizes);
+  cmd.AddValue ("ecn", "Comma-separated ECN modes (off, on)", ecn);
+  cmd.AddValue ("limit", "Queue disc limit [packets]", limit);
+  cmd.AddValue ("backlog", "Packets enqueued before the first batch", backlog);
+  cmd.AddValue ("batchSize", "Packets enqueued and dequeued per batch", batchSize);
+  cmd.AddValue ("batches", "Number of batches per configuration", batches);
+  cmd.AddValue ("warmupBatches", "Batches excluded from the measurement", warmupBatches);
+  cmd.AddValue ("step", "Simulated time between batches", step);
+  cmd.AddValue ("csv", "Also write the results to this CSV file", csvFile);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (batches > warmupBatches, "batches must exceed warmupBatches");
+
+  std::ofstream csv;
+  if (!csvFile.empty ())
+    {
+      csv.open (csvFile.c_str (), std::ofstream::out);
+      csv << "qdisc,sizes,flows,ecn,enqueueNs,dequeueNs,nsPerPacket,allocsPerPacket,dropRatio,markRatio" << std::endl;
+    }
+
+  std::cout << std::left << std::setw (8) << "qdisc" << std::setw (8) << "sizes"
+            << std::right << std::setw (7) << "flows" << std::setw (5) << "ecn"
+            << std::setw (11) << "enq ns/op" << std::setw (11) << "deq ns/op"
+            << std::setw (11) << "ns/pkt" << std::setw (11) << "allocs/pkt"
+            << std::setw (8) << "drop%" << std::setw (8) << "mark%" << std::endl;
+
+  for (const std::string &qdisc : SplitList (qdiscs))
+    {
+      for (const std::string &sizeMode : SplitList (sizes))
+        {
+          for (const std::string &flowCount : SplitList (flows))
+            {
+              for (const std::string &ecnMode : SplitList (ecn))
+                {
+                  QdiscBenchConfig config;
+                  config.qdisc = qdisc;
+                  config.randomSize = (sizeMode == "random");
+                  config.nFlows = std::stoul (flowCount);
+                  config.ecn = (ecnMode == "on");
+                  if (config.ecn && !SupportsEcn (qdisc))
+                    {
+                      continue;
+                    }
+                  NS_ABORT_MSG_UNLESS (config.nFlows > 0, "The number of flows must be positive");
+
+                  QueueDiscBench bench (config, limit, backlog, batchSize, batches, warmupBatches, step);
+                  QdiscBenchResult r = bench.Run ();
+
+                  double enqNs = r.enqueueNs / r.enqueued;
+                  double deqNs = r.dequeued ? r.dequeueNs / r.dequeued : 0;
+                  double pktNs = (r.enqueueNs + r.dequeueNs) / r.enqueued;
+                  double allocs = static_cast<double> (r.allocations) / r.enqueued;
+                  double dropPct = 100.0 * r.drops / r.enqueued;
+                  double markPct = 100.0 * r.marks / r.enqueued;
+
+                  std::cout << std::left << std::setw (8) << qdisc << std::setw (8) << sizeMode
+                            << std::right << std::setw (7) << config.nFlows << std::setw (5) << ecnMode
+                            << std::fixed << std::setprecision (1)
+                            << std::setw (11) << enqNs << std::setw (11) << deqNs << std::setw (11) << pktNs
+                            << std::setprecision (2) << std::setw (11) << allocs
+                            << std::setw (8) << dropPct << std::setw (8) << markPct << std::endl;
+                  if (csv.is_open ())
+                    {
+                      csv << qdisc << "," << sizeMode << "," << config.nFlows << "," << ecnMode << ","
+                          << enqNs << "," << deqNs << "," << pktNs << "," << allocs << ","
+                          << r.drops / static_cast<double> (r.enqueued) << ","
+                          << r.marks / static_cast<double> (r.enqueued) << std::endl;
+                    }
+                }
+            }
+        }
+    }
+
+  if (csv.is_open ())
+    {
+      csv.close ();
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
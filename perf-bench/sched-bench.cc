@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Event scheduler benchmark (--bench=sched).
+//
+// Replays the scheduler operations recorded by RecordingScheduler (see
+// recording-scheduler.h) against each scheduler, and recommends the
+// fastest one for every scenario.  Record a scenario first, e.g.:
+//
+//   ./waf --run "tcp-validation --SchedulerType=ns3::RecordingScheduler
+//                --ns3::RecordingScheduler::FileName=tcp-validation-events.bin"
+//   ./waf --run "ms-lab7-outdoor --SchedulerType=ns3::RecordingScheduler
+//                --ns3::RecordingScheduler::FileName=ms-lab7-outdoor-events.bin"
+//
+// then replay the recordings:
+//
+//   ./waf --run "perf-bench --bench=sched
+//                --traces=tcp-validation:tcp-validation-events.bin,ms-lab7-outdoor:ms-lab7-outdoor-events.bin"
+//
+// Inserted events carry the recorded timestamps and their insert position
+// as uid, so every scheduler sees the same operations in the same order as
+// during the recorded run.  The selected scheduler can then be used with
+// --SchedulerType=ns3::<name>Scheduler.
+
+#include "perf-bench.h"
+#include "../ladder-scheduler.h"
+#include "../recording-scheduler.h"
+
+#include "ns3/core-module.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("SchedulerBench");
+
+namespace {
+
+struct SchedulerTrace
+{
+  std::string name;
+  std::vector<int64_t> operations;
+  uint64_t inserts = 0;
+  uint64_t maxPending = 0;
+};
+
+SchedulerTrace
+LoadTrace (const std::string &name, const std::string &fileName, uint64_t maxOperations)
+{
+  SchedulerTrace trace;
+  trace.name = name;
+  std::ifstream file (fileName.c_str (), std::ios::in | std::ios::binary);
+  NS_ABORT_MSG_UNLESS (file.is_open (), "Cannot open " << fileName);
+  int64_t value;
+  uint64_t pending = 0;
+  while (trace.operations.size () < maxOperations
+         && file.read (reinterpret_cast<char *> (&value), sizeof (value)))
+    {
+      trace.operations.push_back (value);
+      if (value >= 0)
+        {
+          trace.inserts++;
+          pending++;
+          trace.maxPending = std::max (trace.maxPending, pending);
+        }
+      else if (value == recording::RECORD_REMOVE
+               && file.read (reinterpret_cast<char *> (&value), sizeof (value)))
+        {
+          trace.operations.push_back (value);
+          pending--;
+        }
+      else if (value == recording::RECORD_REMOVE_NEXT)
+        {
+          pending--;
+        }
+    }
+  return trace;
+}
+
+struct SchedulerBenchResult
+{
+  double ns = 0;
+  uint64_t allocations = 0;
+};
+
+SchedulerBenchResult
+Replay (const std::string &scheduler, const SchedulerTrace &trace)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::" + scheduler + "Scheduler");
+  Ptr<Scheduler> s = factory.Create<Scheduler> ();
+
+  std::vector<Scheduler::Event> inserted;
+  inserted.reserve (trace.inserts);
+  const std::vector<int64_t> &ops = trace.operations;
+  uint64_t now = 0;
+
+  SchedulerBenchResult result;
+  Stopwatch watch;
+  uint64_t allocations = GetAllocationCount ();
+  watch.Start ();
+  for (std::size_t i = 0; i < ops.size (); i++)
+    {
+      if (ops[i] >= 0)
+        {
+          Scheduler::Event ev;
+          ev.impl = 0;
+          ev.key.m_ts = now + ops[i];
+          ev.key.m_uid = static_cast<uint32_t> (inserted.size ());
+          ev.key.m_context = 0;
+          inserted.push_back (ev);
+          s->Insert (ev);
+        }
+      else if (ops[i] == recording::RECORD_REMOVE_NEXT)
+        {
+          now = s->RemoveNext ().key.m_ts;
+        }
+      else if (i + 1 < ops.size ())
+        {
+          s->Remove (inserted[ops[++i]]);
+        }
+    }
+  watch.Stop ();
+  result.allocations = GetAllocationCount () - allocations;
+  result.ns = watch.GetNs ();
+
+  // Drain, so that schedulers that own per-event nodes release them
+  while (!s->IsEmpty ())
+    {
+      s->RemoveNext ();
+    }
+  return result;
+}
+
+} // unnamed namespace
+
+int
+RunSchedulerBench (int argc, char *argv[])
+{
+  std::string traces = "";
+  std::string schedulers = "Map,Heap,List,Calendar,PriorityQueue,Ladder";
+  uint32_t repetitions = 3;
+  uint64_t maxOperations = 20000000;
+  std::string csvFile = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("traces", "Comma-separated scenario:file pairs recorded by RecordingScheduler", traces);
+  cmd.AddValue ("schedulers", "Comma-separated schedulers (Map, Heap, List, Calendar, PriorityQueue, Ladder)", schedulers);
+  cmd.AddValue ("repetitions", "Replays per scheduler; the fastest is reported", repetitions);
+  cmd.AddValue ("maxOperations", "Replay at most this many operations of each trace", maxOperations);
+  cmd.AddValue ("csv", "Also write the results to this CSV file", csvFile);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (traces.empty (), "No traces given, see --PrintHelp");
+  NS_ABORT_MSG_UNLESS (repetitions > 0, "repetitions must be positive");
+
+  std::ofstream csv;
+  if (!csvFile.empty ())
+    {
+      csv.open (csvFile.c_str (), std::ofstream::out);
+      csv << "scenario,scheduler,operations,maxPending,nsPerOp,allocsPerOp" << std::endl;
+    }
+
+  for (const std::string &entry : SplitList (traces))
+    {
+      std::string::size_type colon = entry.find (':');
+      NS_ABORT_MSG_IF (colon == std::string::npos, "Expected scenario:file, got " << entry);
+      SchedulerTrace trace = LoadTrace (entry.substr (0, colon), entry.substr (colon + 1), maxOperations);
+      NS_ABORT_MSG_IF (trace.operations.empty (), "Empty trace " << entry);
+
+      std::cout << trace.name << ": " << trace.operations.size () << " operations, "
+                << trace.inserts << " inserts, up to " << trace.maxPending << " pending events" << std::endl;
+      std::cout << std::left << std::setw (16) << "scheduler"
+                << std::right << std::setw (11) << "ns/op" << std::setw (12) << "allocs/op" << std::endl;
+
+      std::string best;
+      double bestNs = 0;
+      for (const std::string &scheduler : SplitList (schedulers))
+        {
+          SchedulerBenchResult r = Replay (scheduler, trace);
+          for (uint32_t i = 1; i < repetitions; i++)
+            {
+              SchedulerBenchResult next = Replay (scheduler, trace);
+              if (next.ns < r.ns)
+                {
+                  r = next;
+                }
+            }
+          double nsPerOp = r.ns / trace.operations.size ();
+          double allocs = static_cast<double> (r.allocations) / trace.operations.size ();
+          std::cout << std::left << std::setw (16) << scheduler
+                    << std::right << std::fixed << std::setprecision (1) << std::setw (11) << nsPerOp
+                    << std::setprecision (2) << std::setw (12) << allocs << std::endl;
+          if (csv.is_open ())
+            {
+              csv << trace.name << "," << scheduler << "," << trace.operations.size () << ","
+                  << trace.maxPending << "," << nsPerOp << "," << allocs << std::endl;
+            }
+          if (best.empty () || r.ns < bestNs)
+            {
+              best = scheduler;
+              bestNs = r.ns;
+            }
+        }
+      std::cout << "recommended for " << trace.name << ": --SchedulerType=ns3::" << best << "Scheduler"
+                << std::endl << std::endl;
+    }
+
+  if (csv.is_open ())
+    {
+      csv.close ();
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
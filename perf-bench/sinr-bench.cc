@@ -0,0 +1,351 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Interference tracking benchmark (--bench=sinr).
+//
+// One receiver hears N co-channel transmitters, as a STA of the outdoor
+// deployment of ms-lab7-outdoor or of a saturated ms-lab4 cell does.  Each
+// transmitter sends frames of --minDuration to --maxDuration us separated
+// by exponential idle times of mean --idle us, at a received power drawn
+// between --minPower and --maxPower dBm.  The receiver locks on every
+// frame above -82 dBm that starts while it is idle, and computes the noise
+// and interference chunks of that frame when it ends:
+//
+//   scratch      all signals are kept in a list pruned when a reception
+//                ends, and every chunk is summed over the list, as the
+//                interference helper of the PHY does,
+//   incremental  IncrementalInterference (see incremental-interference.h).
+//
+// Both must give the same chunks.  Reported: mean signals in the air, mean
+// signals kept by scratch, chunks per reception and ns per signal heard.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=sinr --transmitters=10,100,1000"
+
+#include "perf-bench.h"
+#include "../incremental-interference.h"
+
+#include "ns3/core-module.h"
+#include "ns3/wifi-utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("SinrBench");
+
+namespace {
+
+struct Signal
+{
+  Time start;
+  Time duration;
+  double powerW;
+  bool receive;
+};
+
+/// Interference tracking from scratch, for comparison
+class ScratchInterference
+{
+public:
+  explicit ScratchInterference (double noiseW)
+    : m_noiseW (noiseW),
+      m_rx (0),
+      m_retained (0)
+  {
+  }
+
+  void Add (const Signal &signal)
+  {
+    m_signals.push_back ({signal.start, signal.start + signal.duration, signal.powerW});
+    if (signal.receive)
+      {
+        m_rx = m_signals.size () - 1;
+      }
+  }
+
+  const std::vector<incrementalinterference::Chunk> &EndReception (Time now)
+  {
+    const Entry rx = m_signals[m_rx];
+    std::vector<Time> boundaries;
+    boundaries.push_back (rx.start);
+    for (const Entry &s : m_signals)
+      {
+        if (s.start > rx.start && s.start < rx.end)
+          {
+            boundaries.push_back (s.start);
+          }
+        if (s.end > rx.start && s.end < rx.end)
+          {
+            boundaries.push_back (s.end);
+          }
+      }
+    boundaries.push_back (rx.end);
+    std::sort (boundaries.begin (), boundaries.end ());
+    boundaries.erase (std::unique (boundaries.begin (), boundaries.end ()), boundaries.end ());
+
+    m_chunks.clear ();
+    for (std::size_t c = 0; c + 1 < boundaries.size (); c++)
+      {
+        double noiseInterferenceW = m_noiseW;
+        for (std::size_t i = 0; i < m_signals.size (); i++)
+          {
+            if (i != m_rx && m_signals[i].start <= boundaries[c] && m_signals[i].end > boundaries[c])
+              {
+                noiseInterferenceW += m_signals[i].powerW;
+              }
+          }
+        m_chunks.push_back ({boundaries[c], boundaries[c + 1], noiseInterferenceW});
+      }
+
+    m_retained += m_signals.size ();
+    m_signals.erase (std::remove_if (m_signals.begin (), m_signals.end (),
+                                     [now] (const Entry &s) { return s.end <= now; }),
+                     m_signals.end ());
+    return m_chunks;
+  }
+
+  /// \returns the number of signals in the list at the ends of receptions
+  uint64_t GetRetained (void) const
+  {
+    return m_retained;
+  }
+
+private:
+  struct Entry
+  {
+    Time start;
+    Time end;
+    double powerW;
+  };
+
+  double m_noiseW;
+  std::vector<Entry> m_signals;
+  std::size_t m_rx;
+  std::vector<incrementalinterference::Chunk> m_chunks;
+  uint64_t m_retained;
+};
+
+struct SinrWorkload
+{
+  uint32_t nSignals;
+  double minDurationUs;
+  double maxDurationUs;
+  double idleUs;
+  double minPowerDbm;
+  double maxPowerDbm;
+  double rxThresholdDbm;
+};
+
+/// \returns the signals of nTransmitters, in start order, with the
+/// receptions of an idle receiver marked
+std::vector<Signal>
+MakeSignals (uint32_t nTransmitters, const SinrWorkload &w)
+{
+  Ptr<UniformRandomVariable> duration = CreateObject<UniformRandomVariable> ();
+  duration->SetAttribute ("Min", DoubleValue (w.minDurationUs));
+  duration->SetAttribute ("Max", DoubleValue (w.maxDurationUs));
+  Ptr<UniformRandomVariable> power = CreateObject<UniformRandomVariable> ();
+  power->SetAttribute ("Min", DoubleValue (w.minPowerDbm));
+  power->SetAttribute ("Max", DoubleValue (w.maxPowerDbm));
+  Ptr<ExponentialRandomVariable> idle = CreateObject<ExponentialRandomVariable> ();
+  idle->SetAttribute ("Mean", DoubleValue (w.idleUs));
+
+  typedef std::pair<Time, uint32_t> NextStart;
+  std::priority_queue<NextStart, std::vector<NextStart>, std::greater<NextStart> > next;
+  for (uint32_t t = 0; t < nTransmitters; t++)
+    {
+      next.push (std::make_pair (NanoSeconds (idle->GetValue () * 1000), t));
+    }
+
+  std::vector<Signal> signals;
+  signals.reserve (w.nSignals);
+  Time rxEnd;
+  while (signals.size () < w.nSignals)
+    {
+      NextStart n = next.top ();
+      next.pop ();
+      double powerDbm = power->GetValue ();
+      Signal s = {n.first, NanoSeconds (duration->GetValue () * 1000), DbmToW (powerDbm), false};
+      if (n.first >= rxEnd && powerDbm >= w.rxThresholdDbm)
+        {
+          s.receive = true;
+          rxEnd = s.start + s.duration;
+        }
+      signals.push_back (s);
+      next.push (std::make_pair (s.start + s.duration + NanoSeconds (idle->GetValue () * 1000), n.second));
+    }
+  return signals;
+}
+
+struct SinrResult
+{
+  double scratchNs = 0;
+  double incrementalNs = 0;
+  uint64_t receptions = 0;
+  uint64_t chunks = 0;
+  uint64_t inAir = 0;               //!< sum over the receptions of the signals in the air
+  uint64_t retained = 0;            //!< sum over the receptions of the signals kept by scratch
+};
+
+/**
+ * Pass the signals in order to add, and call endReception at the end of
+ * each reception, before the first signal starting after it
+ */
+template <typename ADD, typename END>
+void
+Replay (const std::vector<Signal> &signals, ADD add, END endReception)
+{
+  bool receiving = false;
+  Time rxEnd;
+  for (const Signal &s : signals)
+    {
+      if (receiving && rxEnd <= s.start)
+        {
+          endReception (rxEnd);
+          receiving = false;
+        }
+      add (s);
+      if (s.receive)
+        {
+          receiving = true;
+          rxEnd = s.start + s.duration;
+        }
+    }
+  if (receiving)
+    {
+      endReception (rxEnd);
+    }
+}
+
+SinrResult
+RunSinr (const std::vector<Signal> &signals, double noiseW)
+{
+  SinrResult r;
+
+  // The chunks of every reception, to compare the two trackers
+  std::vector<incrementalinterference::Chunk> expected;
+  ScratchInterference scratch (noiseW);
+  Stopwatch scratchTime;
+  scratchTime.Start ();
+  Replay (signals,
+          [&scratch] (const Signal &s) { scratch.Add (s); },
+          [&scratch, &expected] (Time now)
+          {
+            const std::vector<incrementalinterference::Chunk> &chunks = scratch.EndReception (now);
+            expected.insert (expected.end (), chunks.begin (), chunks.end ());
+          });
+  scratchTime.Stop ();
+  r.scratchNs = scratchTime.GetNs ();
+  r.retained = scratch.GetRetained ();
+
+  IncrementalInterference incremental;
+  incremental.SetNoiseFloorW (noiseW);
+  std::size_t next = 0;
+  bool same = true;
+  Stopwatch incrementalTime;
+  incrementalTime.Start ();
+  Replay (signals,
+          [&incremental, &r] (const Signal &s)
+          {
+            incremental.Add (s.start, s.duration, s.powerW, s.receive);
+            if (s.receive)
+              {
+                r.inAir += incremental.GetNActive (s.start);
+              }
+          },
+          [&incremental, &expected, &next, &same] (Time now)
+          {
+            for (const incrementalinterference::Chunk &c : incremental.EndReception (now))
+              {
+                same = same && next < expected.size ()
+                  && c.start == expected[next].start && c.end == expected[next].end
+                  && std::abs (c.noiseInterferenceW - expected[next].noiseInterferenceW)
+                     <= 1e-9 * expected[next].noiseInterferenceW;
+                next++;
+              }
+          });
+  incrementalTime.Stop ();
+  r.incrementalNs = incrementalTime.GetNs ();
+  NS_ABORT_MSG_UNLESS (same && next == expected.size (), "The incremental chunks differ from the scratch ones");
+
+  r.receptions = incremental.GetStatistics ().receptions;
+  r.chunks = incremental.GetStatistics ().chunks;
+  NS_LOG_INFO (r.receptions << " receptions, at most " << incremental.GetStatistics ().maxActive
+                            << " signals in the air");
+  return r;
+}
+
+} // unnamed namespace
+
+int
+RunSinrBench (int argc, char *argv[])
+{
+  std::string transmitters = "10,100,1000";
+  SinrWorkload w;
+  w.nSignals = 100000;
+  w.minDurationUs = 40;
+  w.maxDurationUs = 2000;
+  w.idleUs = 5000;
+  w.minPowerDbm = -95;
+  w.maxPowerDbm = -50;
+  w.rxThresholdDbm = -82;
+  double noiseDbm = -94;
+
+  CommandLine cmd;
+  cmd.AddValue ("transmitters", "Comma-separated numbers of co-channel transmitters", transmitters);
+  cmd.AddValue ("signals", "Signals heard per configuration", w.nSignals);
+  cmd.AddValue ("minDuration", "Shortest frame [us]", w.minDurationUs);
+  cmd.AddValue ("maxDuration", "Longest frame [us]", w.maxDurationUs);
+  cmd.AddValue ("idle", "Mean idle time of a transmitter between frames [us]", w.idleUs);
+  cmd.AddValue ("minPower", "Lowest received power [dBm]", w.minPowerDbm);
+  cmd.AddValue ("maxPower", "Highest received power [dBm]", w.maxPowerDbm);
+  cmd.AddValue ("noise", "Noise floor [dBm]", noiseDbm);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (w.nSignals > 0, "At least one signal is needed");
+  NS_ABORT_MSG_UNLESS (w.minDurationUs > 0 && w.maxDurationUs >= w.minDurationUs, "Invalid frame durations");
+
+  std::cout << std::right << std::setw (12) << "transmitters" << std::setw (8) << "in air"
+            << std::setw (10) << "retained" << std::setw (12) << "chunks/rx"
+            << std::setw (12) << "ns/scratch" << std::setw (15) << "ns/incremental" << std::endl;
+  for (const std::string &count : SplitList (transmitters))
+    {
+      uint32_t nTransmitters = std::stoul (count);
+      NS_ABORT_MSG_UNLESS (nTransmitters > 0, "The number of transmitters must be positive");
+      std::vector<Signal> signals = MakeSignals (nTransmitters, w);
+      SinrResult r = RunSinr (signals, DbmToW (noiseDbm));
+      double receptions = std::max<uint64_t> (r.receptions, 1);
+      std::cout << std::setw (12) << nTransmitters << std::fixed << std::setprecision (1)
+                << std::setw (8) << r.inAir / receptions << std::setw (10) << r.retained / receptions
+                << std::setw (12) << r.chunks / receptions
+                << std::setw (12) << r.scratchNs / signals.size ()
+                << std::setw (15) << r.incrementalNs / signals.size () << std::endl;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
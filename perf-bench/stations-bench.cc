@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Remote station lookup benchmark (--bench=stations).
+//
+// An AP knows --stations associated stations and looks up the state of a
+// random one --lookups times, as it does for each frame sent or received:
+//
+//   manager  WifiRemoteStationManager::IsAssociated, which walks the
+//            station states of the manager of a Wi-Fi device,
+//   table    StationTable (see station-table.h), by address,
+//   id       StationTable, by the station ID,
+//
+// which must find the same stations.  Reported: ns per lookup of each.
+//
+// Example:
+//   ./waf --run "perf-bench --bench=stations --stations=20,100,500,2000"
+
+#include "perf-bench.h"
+#include "../station-table.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("StationsBench");
+
+namespace {
+
+struct StationState
+{
+  bool associated = false;
+};
+
+/// \returns the remote station manager of a new 802.11a device
+Ptr<WifiRemoteStationManager>
+CreateStationManager (void)
+{
+  NodeContainer node;
+  node.Create (1);
+  YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
+  YansWifiPhyHelper phy;
+  phy.SetChannel (channelHelper.Create ());
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_STANDARD_80211a);
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                "DataMode", StringValue ("OfdmRate54Mbps"),
+                                "ControlMode", StringValue ("OfdmRate6Mbps"));
+  WifiMacHelper mac;
+  mac.SetType ("ns3::AdhocWifiMac");
+  NetDeviceContainer devices = wifi.Install (phy, mac, node);
+  return DynamicCast<WifiNetDevice> (devices.Get (0))->GetRemoteStationManager ();
+}
+
+} // unnamed namespace
+
+int
+RunStationsBench (int argc, char *argv[])
+{
+  std::string stations = "20,100,500,2000";
+  uint32_t lookups = 1000000;
+
+  CommandLine cmd;
+  cmd.AddValue ("stations", "Comma-separated numbers of associated stations", stations);
+  cmd.AddValue ("lookups", "Lookups per number of stations", lookups);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (lookups > 0, "At least one lookup is needed");
+
+  Ptr<UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
+  std::cout << std::right << std::setw (9) << "stations" << std::setw (12) << "ns/manager"
+            << std::setw (10) << "ns/table" << std::setw (7) << "ns/id" << std::endl;
+  for (const std::string &value : SplitList (stations))
+    {
+      uint32_t nStations = std::stoul (value);
+      NS_ABORT_MSG_UNLESS (nStations > 0, "At least one station is needed");
+
+      Ptr<WifiRemoteStationManager> manager = CreateStationManager ();
+      StationTable<StationState> table;
+      std::vector<Mac48Address> addresses;
+      for (uint32_t i = 0; i < nStations; i++)
+        {
+          Mac48Address address = Mac48Address::Allocate ();
+          addresses.push_back (address);
+          manager->RecordWaitAssocTxOk (address);
+          manager->RecordGotAssocTxOk (address);
+          table.Get (table.Add (address)).associated = true;
+        }
+      std::vector<uint32_t> targets;
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          targets.push_back (rv->GetInteger (0, nStations - 1));
+        }
+
+      Stopwatch managerTime;
+      uint32_t managerFound = 0;
+      managerTime.Start ();
+      for (uint32_t target : targets)
+        {
+          managerFound += manager->IsAssociated (addresses[target]);
+        }
+      managerTime.Stop ();
+
+      Stopwatch tableTime;
+      uint32_t tableFound = 0;
+      tableTime.Start ();
+      for (uint32_t target : targets)
+        {
+          StationState *state = table.Lookup (addresses[target]);
+          tableFound += state != 0 && state->associated;
+        }
+      tableTime.Stop ();
+
+      // The IDs are those returned by Add, in the order of the addresses
+      Stopwatch idTime;
+      uint32_t idFound = 0;
+      idTime.Start ();
+      for (uint32_t target : targets)
+        {
+          idFound += table.Get (target).associated;
+        }
+      idTime.Stop ();
+
+      NS_ABORT_MSG_UNLESS (managerFound == lookups && tableFound == lookups && idFound == lookups,
+                           "Some stations were not found");
+      NS_ABORT_MSG_UNLESS (table.GetN () == nStations, "The table holds " << table.GetN () << " stations");
+      std::cout << std::setw (9) << nStations << std::fixed << std::setprecision (1)
+                << std::setw (12) << managerTime.GetNs () / lookups
+                << std::setw (10) << tableTime.GetNs () / lookups
+                << std::setw (7) << idTime.GetNs () / lookups << std::endl;
+    }
+  Simulator::Destroy ();
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
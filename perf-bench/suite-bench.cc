@@ -0,0 +1,333 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Cross-scenario benchmark suite (--bench=suite).
+//
+// Runs fixed-seed, fixed-duration variants of the scenarios of this
+// directory, each as its own program through waf, with the
+// BenchmarkSimulatorImpl (see benchmark-simulator-impl.h) reporting:
+//
+//   wall       setup + run wall time [s]
+//   setup      wall time before Simulator::Run [s]
+//   events/s   events executed per wall second of Simulator::Run
+//   sim/wall   simulated seconds per wall second of Simulator::Run
+//   peakRss    peak resident set size [MB]
+//
+// Each scenario is run --repetitions times and the fastest run is kept.
+// The figures are compared with the baselines file, and the scenarios
+// whose figures are worse than their baseline by more than --threshold
+// are flagged; the exit status is then 1.  The baselines depend on the
+// machine and on the build profile, so they are not kept in the
+// repository: store them first with --updateBaselines=1, e.g.
+//
+//   ./waf build && ./waf --run "perf-bench --bench=suite --updateBaselines=1"
+//   (change and rebuild)
+//   ./waf build && ./waf --run "perf-bench --bench=suite"
+//
+// The scenarios must have been built: they are run with --run-no-build.
+// Their own output goes to --log, and their output files (CSV, traces) to
+// the current directory.  --extraArgs are passed to every scenario, e.g.
+// --extraArgs=--SchedulerType=ns3::LadderScheduler.
+
+#include "perf-bench.h"
+
+#include "ns3/core-module.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("SuiteBench");
+
+namespace {
+
+struct SuiteScenario
+{
+  const char *name;
+  const char *arguments;
+};
+
+// Fixed seed and duration variants, with the optional output files off
+const SuiteScenario SUITE_SCENARIOS[] = {
+  { "ms-lab4", "--RngSeed=1 --RngRun=1 --simulationTime=5 --nWifi=10" },
+  { "ms-lab6", "--RngSeed=1 --RngRun=1 --simulationTime=5 --nWifi=10 --useCsv=0" },
+  { "ms-lab7-outdoor", "--RngSeed=1 --RngRun=1 --simulationTime=5 --layers=1 --stations=5 --partitions=0" },
+  { "anomaly2_6_54", "--seed=1 --simTime=5" },
+  { "tcp-validation", "--RngSeed=1 --RngRun=1 --stopTime=20s --partitions=0" },
+  { "myproject", "--RngSeed=1 --RngRun=1 --simulationTime=5 --useCsv=0" },
+  { "ms-lab7-queue", "--RngSeed=1 --RngRun=1 --simulationTime=100" },
+};
+
+struct SuiteResult
+{
+  double setup = 0;
+  double run = 0;
+  uint64_t events = 0;
+  double simulated = 0;
+  uint64_t peakRssKb = 0;
+
+  double GetWall (void) const
+  {
+    return setup + run;
+  }
+  double GetEventsPerSecond (void) const
+  {
+    return run > 0 ? events / run : 0;
+  }
+  double GetSimulatedPerWall (void) const
+  {
+    return run > 0 ? simulated / run : 0;
+  }
+};
+
+/// \returns the sum of the Simulator::Run reports of one scenario run
+SuiteResult
+ReadReport (const std::string &fileName)
+{
+  SuiteResult result;
+  std::ifstream file (fileName.c_str ());
+  std::string line;
+  bool found = false;
+  while (std::getline (file, line))
+    {
+      std::map<std::string, std::string> fields = ParseFields (line);
+      result.setup += std::stod (fields["setup"]);
+      result.run += std::stod (fields["run"]);
+      result.events += std::stoull (fields["events"]);
+      result.simulated += std::stod (fields["simulated"]);
+      result.peakRssKb = std::max<uint64_t> (result.peakRssKb, std::stoull (fields["peakRss"]));
+      found = true;
+    }
+  NS_ABORT_MSG_UNLESS (found, "No report in " << fileName);
+  return result;
+}
+
+SuiteResult
+RunScenario (const SuiteScenario &scenario, const std::string &waf, const std::string &extraArgs,
+             const std::string &reportFile, const std::string &logFile)
+{
+  std::remove (reportFile.c_str ());
+  std::ostringstream command;
+  command << waf << " --run-no-build \"" << scenario.name << " " << scenario.arguments
+          << " " << extraArgs
+          << " --SimulatorImplementationType=ns3::BenchmarkSimulatorImpl"
+          << " --ns3::BenchmarkSimulatorImpl::Scenario=" << scenario.name
+          << " --ns3::BenchmarkSimulatorImpl::ReportFile=" << reportFile << "\""
+          << " >> " << logFile << " 2>&1";
+  NS_LOG_INFO (command.str ());
+  int status = std::system (command.str ().c_str ());
+  NS_ABORT_MSG_UNLESS (status == 0, scenario.name << " failed, see " << logFile);
+  SuiteResult result = ReadReport (reportFile);
+  std::remove (reportFile.c_str ());
+  return result;
+}
+
+std::map<std::string, SuiteResult>
+LoadBaselines (const std::string &fileName)
+{
+  std::map<std::string, SuiteResult> baselines;
+  std::ifstream file (fileName.c_str ());
+  std::string line;
+  while (std::getline (file, line))
+    {
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      std::map<std::string, std::string> fields = ParseFields (line);
+      SuiteResult &b = baselines[fields["scenario"]];
+      b.setup = std::stod (fields["setup"]);
+      b.run = std::stod (fields["run"]);
+      b.events = std::stoull (fields["events"]);
+      b.simulated = std::stod (fields["simulated"]);
+      b.peakRssKb = std::stoull (fields["peakRss"]);
+    }
+  return baselines;
+}
+
+void
+StoreBaselines (const std::string &fileName, const std::map<std::string, SuiteResult> &baselines)
+{
+  std::ofstream file (fileName.c_str (), std::ofstream::out | std::ofstream::trunc);
+  NS_ABORT_MSG_UNLESS (file.is_open (), "Cannot write " << fileName);
+  file << "# perf-bench --bench=suite baselines" << std::endl;
+  for (const auto &entry : baselines)
+    {
+      const SuiteResult &b = entry.second;
+      file << "scenario=" << entry.first << " setup=" << b.setup << " run=" << b.run
+           << " events=" << b.events << " simulated=" << b.simulated
+           << " peakRss=" << b.peakRssKb << std::endl;
+    }
+}
+
+/**
+ * \returns the names of the figures of result worse than those of
+ * baseline by more than threshold (a fraction)
+ */
+std::string
+FindRegressions (const SuiteResult &result, const SuiteResult &baseline, double threshold)
+{
+  std::string regressions;
+  if (result.GetWall () > baseline.GetWall () * (1 + threshold))
+    {
+      regressions += " wall";
+    }
+  if (result.setup > baseline.setup * (1 + threshold))
+    {
+      regressions += " setup";
+    }
+  if (result.GetEventsPerSecond () < baseline.GetEventsPerSecond () * (1 - threshold))
+    {
+      regressions += " events/s";
+    }
+  if (result.GetSimulatedPerWall () < baseline.GetSimulatedPerWall () * (1 - threshold))
+    {
+      regressions += " sim/wall";
+    }
+  if (result.peakRssKb > baseline.peakRssKb * (1 + threshold))
+    {
+      regressions += " peakRss";
+    }
+  return regressions;
+}
+
+} // unnamed namespace
+
+int
+RunSuiteBench (int argc, char *argv[])
+{
+  std::string scenarios;
+  uint32_t repetitions = 3;
+  std::string baselinesFile = "perf-bench-suite.baselines";
+  bool updateBaselines = false;
+  double threshold = 0.1;
+  std::string waf = "./waf";
+  std::string extraArgs;
+  std::string logFile = "perf-bench-suite.log";
+
+  CommandLine cmd;
+  cmd.AddValue ("scenarios", "Comma-separated scenarios to run (default: all)", scenarios);
+  cmd.AddValue ("repetitions", "Runs per scenario; the fastest one is kept", repetitions);
+  cmd.AddValue ("baselines", "Baselines file", baselinesFile);
+  cmd.AddValue ("updateBaselines", "Store the figures as the new baselines", updateBaselines);
+  cmd.AddValue ("threshold", "Relative degradation flagged as a regression", threshold);
+  cmd.AddValue ("waf", "Path of waf, used to run the scenarios", waf);
+  cmd.AddValue ("extraArgs", "Arguments added to every scenario", extraArgs);
+  cmd.AddValue ("log", "File the scenarios' output is appended to", logFile);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (repetitions > 0, "At least one repetition is needed");
+  std::vector<SuiteScenario> selected;
+  std::vector<std::string> names = SplitList (scenarios);
+  for (const SuiteScenario &scenario : SUITE_SCENARIOS)
+    {
+      if (names.empty () || std::find (names.begin (), names.end (), scenario.name) != names.end ())
+        {
+          selected.push_back (scenario);
+        }
+    }
+  NS_ABORT_MSG_UNLESS (!selected.empty (), "No known scenario in " << scenarios);
+
+  char cwd[4096];
+  NS_ABORT_MSG_UNLESS (getcwd (cwd, sizeof (cwd)) != 0, "Cannot get the current directory");
+  std::string reportFile = std::string (cwd) + "/perf-bench-suite.report";
+
+  std::map<std::string, SuiteResult> baselines = LoadBaselines (baselinesFile);
+  std::map<std::string, SuiteResult> results;
+  uint32_t regressions = 0;
+
+  std::cout << std::left << std::setw (17) << "scenario"
+            << std::right << std::setw (9) << "wall[s]" << std::setw (10) << "setup[s]"
+            << std::setw (12) << "events/s" << std::setw (10) << "sim/wall"
+            << std::setw (13) << "peakRss[MB]" << "  vs baseline" << std::endl;
+
+  for (const SuiteScenario &scenario : selected)
+    {
+      SuiteResult best;
+      for (uint32_t i = 0; i < repetitions; i++)
+        {
+          SuiteResult r = RunScenario (scenario, waf, extraArgs, reportFile, logFile);
+          if (i == 0 || r.GetWall () < best.GetWall ())
+            {
+              best = r;
+            }
+        }
+      results[scenario.name] = best;
+
+      std::cout << std::left << std::setw (17) << scenario.name << std::right << std::fixed
+                << std::setprecision (2) << std::setw (9) << best.GetWall ()
+                << std::setw (10) << best.setup << std::setprecision (0)
+                << std::setw (12) << best.GetEventsPerSecond () << std::setprecision (2)
+                << std::setw (10) << best.GetSimulatedPerWall () << std::setprecision (1)
+                << std::setw (13) << best.peakRssKb / 1024.0 << "  ";
+
+      std::map<std::string, SuiteResult>::const_iterator b = baselines.find (scenario.name);
+      if (b == baselines.end ())
+        {
+          std::cout << "none";
+        }
+      else
+        {
+          std::cout << std::showpos << std::setprecision (1)
+                    << 100 * (best.GetWall () / b->second.GetWall () - 1) << "% wall" << std::noshowpos;
+          std::string worse = FindRegressions (best, b->second, threshold);
+          if (!worse.empty ())
+            {
+              std::cout << "  REGRESSION:" << worse;
+              regressions++;
+            }
+          if (best.events != b->second.events)
+            {
+              // Not a regression, but the figures are no longer comparable
+              std::cout << "  (events " << best.events << " vs " << b->second.events << ")";
+            }
+        }
+      std::cout << std::endl;
+    }
+
+  if (updateBaselines)
+    {
+      for (const auto &entry : results)
+        {
+          baselines[entry.first] = entry.second;
+        }
+      StoreBaselines (baselinesFile, baselines);
+      std::cout << "Baselines stored in " << baselinesFile << std::endl;
+      return 0;
+    }
+  if (regressions > 0)
+    {
+      std::cout << regressions << " scenario(s) worse than their baseline by more than "
+                << 100 * threshold << "%" << std::endl;
+      return 1;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
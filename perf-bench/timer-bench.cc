@@ -0,0 +1,213 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Restartable timer benchmark (--bench=timer).
+//
+// Models the retransmission timers of many connections: every timer is
+// restarted with the same delay each time an "ACK" arrives, about once
+// per interval, and rarely expires.  ACKs are delivered in batches, one
+// simulator event per step, so that the timers dominate the event queue.
+// Two implementations are compared:
+//
+//   - event: EventId::Cancel followed by Simulator::Schedule, as the TCP
+//            and Wi-Fi models do; cancelled events stay queued,
+//   - wheel: WheelTimer::Schedule (see timer-wheel.h).
+//
+// Reported per restart: CPU time including the time spent processing the
+// events in the queue, allocations, and events processed by the
+// simulator (cancelled ones included).
+//
+// Example:
+//   ./waf --run "perf-bench --bench=timer --timers=10000 --delay=200ms"
+
+#include "perf-bench.h"
+#include "../timer-wheel.h"
+
+#include "ns3/core-module.h"
+
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("TimerBench");
+
+namespace {
+
+struct TimerBenchResult
+{
+  uint64_t restarts = 0;
+  uint64_t expirations = 0;
+  uint64_t events = 0;
+  uint64_t allocations = 0;
+  double ns = 0;
+};
+
+class TimerBench
+{
+public:
+  TimerBench (bool wheel, uint32_t nTimers, Time delay, Time interval, Time step, Time duration);
+  TimerBenchResult Run (void);
+
+private:
+  void Step (void);
+  void Expire (void);
+
+  bool m_wheel;
+  uint32_t m_nTimers;
+  Time m_delay;
+  Time m_interval;
+  Time m_step;
+  Time m_duration;
+
+  std::vector<EventId> m_events;
+  std::deque<WheelTimer> m_timers;     //!< never moved, as the wheel links them
+  Ptr<UniformRandomVariable> m_rv;
+  double m_pending;                //!< ACKs due but not yet delivered
+  TimerBenchResult m_result;
+};
+
+TimerBench::TimerBench (bool wheel, uint32_t nTimers, Time delay, Time interval, Time step, Time duration)
+  : m_wheel (wheel),
+    m_nTimers (nTimers),
+    m_delay (delay),
+    m_interval (interval),
+    m_step (step),
+    m_duration (duration),
+    m_pending (0)
+{
+}
+
+void
+TimerBench::Expire (void)
+{
+  m_result.expirations++;
+}
+
+void
+TimerBench::Step (void)
+{
+  // On average every timer is restarted once per interval
+  m_pending += static_cast<double> (m_nTimers) * m_step.GetSeconds () / m_interval.GetSeconds ();
+  for (; m_pending >= 1; m_pending--)
+    {
+      uint32_t i = m_rv->GetInteger (0, m_nTimers - 1);
+      if (m_wheel)
+        {
+          m_timers[i].Schedule (m_delay);
+        }
+      else
+        {
+          m_events[i].Cancel ();
+          m_events[i] = Simulator::Schedule (m_delay, &TimerBench::Expire, this);
+        }
+      m_result.restarts++;
+    }
+  if (Simulator::Now () + m_step < m_duration)
+    {
+      Simulator::Schedule (m_step, &TimerBench::Step, this);
+    }
+}
+
+TimerBenchResult
+TimerBench::Run (void)
+{
+  m_rv = CreateObject<UniformRandomVariable> ();
+  if (m_wheel)
+    {
+      for (uint32_t i = 0; i < m_nTimers; i++)
+        {
+          m_timers.emplace_back ();
+          m_timers.back ().SetFunction (&TimerBench::Expire, this);
+        }
+    }
+  else
+    {
+      m_events.resize (m_nTimers);
+    }
+
+  Simulator::Schedule (m_step, &TimerBench::Step, this);
+  Stopwatch watch;
+  uint64_t allocations = GetAllocationCount ();
+  watch.Start ();
+  Simulator::Run ();
+  watch.Stop ();
+  m_result.ns = watch.GetNs ();
+  m_result.allocations = GetAllocationCount () - allocations;
+  m_result.events = Simulator::GetEventCount ();
+
+  m_timers.clear ();
+  Simulator::Destroy ();
+  return m_result;
+}
+
+} // unnamed namespace
+
+int
+RunTimerBench (int argc, char *argv[])
+{
+  std::string modes = "event,wheel";
+  std::string timers = "100,1000,10000";
+  Time delay = MilliSeconds (200);
+  Time interval = MilliSeconds (1);
+  Time step = MicroSeconds (100);
+  Time duration = Seconds (10);
+  Time resolution = MicroSeconds (100);
+
+  CommandLine cmd;
+  cmd.AddValue ("modes", "Comma-separated timer implementations (event, wheel)", modes);
+  cmd.AddValue ("timers", "Comma-separated numbers of timers", timers);
+  cmd.AddValue ("delay", "Timer delay", delay);
+  cmd.AddValue ("interval", "Mean time between restarts of a timer", interval);
+  cmd.AddValue ("step", "Simulated time between batches of restarts", step);
+  cmd.AddValue ("duration", "Simulated time per configuration", duration);
+  cmd.AddValue ("resolution", "Timer wheel slot span", resolution);
+  cmd.Parse (argc, argv);
+
+  TimerWheel::Get ().SetResolution (resolution);
+
+  std::cout << std::left << std::setw (7) << "mode"
+            << std::right << std::setw (8) << "timers" << std::setw (11) << "restarts"
+            << std::setw (11) << "ns/restart" << std::setw (13) << "allocs/rst"
+            << std::setw (13) << "events/rst" << std::setw (9) << "expired" << std::endl;
+
+  for (const std::string &mode : SplitList (modes))
+    {
+      NS_ABORT_MSG_UNLESS (mode == "event" || mode == "wheel", "Unknown mode " << mode);
+      for (const std::string &count : SplitList (timers))
+        {
+          uint32_t nTimers = std::stoul (count);
+          NS_ABORT_MSG_UNLESS (nTimers > 0, "The number of timers must be positive");
+          TimerBench bench (mode == "wheel", nTimers, delay, interval, step, duration);
+          TimerBenchResult r = bench.Run ();
+          std::cout << std::left << std::setw (7) << mode
+                    << std::right << std::setw (8) << nTimers << std::setw (11) << r.restarts
+                    << std::fixed << std::setprecision (1) << std::setw (11) << r.ns / r.restarts
+                    << std::setprecision (2) << std::setw (13) << static_cast<double> (r.allocations) / r.restarts
+                    << std::setw (13) << static_cast<double> (r.events) / r.restarts
+                    << std::setw (9) << r.expirations << std::endl;
+        }
+    }
+  TimerWheel::Get ().PrintStatistics (std::cout);
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
@@ -0,0 +1,251 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// PHY approximation validation (--bench=validate).
+//
+// Runs fixed-duration variants of the Wi-Fi scenarios twice per RngRun,
+// through waf: once as they are, with the YansWifiPhy of the detailed
+// reception, and once with the arguments of --approxArgs added.  By
+// default these select SharedDeliveryYansWifiPhy with FrameLevel (see
+// shared-delivery-yans-wifi-phy.h), which receives every frame with one
+// start and one end event per receiver.  The throughput and the mean
+// delay printed by the scenarios are averaged over the --runs runs; the
+// BenchmarkSimulatorImpl reports give the events and the Simulator::Run
+// wall time of each run:
+//
+//   thr    total throughput [Mb/s], detailed and approximated,
+//   delay  mean delay of the received packets [ms], detailed and approximated,
+//   events approximated over detailed events,
+//   speed  detailed over approximated Simulator::Run wall time.
+//
+// Scenarios whose approximated throughput or delay differ from the
+// detailed ones by more than --tolerance are flagged, and the exit status
+// is then 1.
+// The scenarios must have been built: they are run with --run-no-build.
+//
+// Example:
+//   ./waf build && ./waf --run "perf-bench --bench=validate --runs=5"
+
+#include "perf-bench.h"
+
+#include "ns3/core-module.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace perfbench {
+
+NS_LOG_COMPONENT_DEFINE ("ValidateBench");
+
+namespace {
+
+struct ValidateScenario
+{
+  const char *name;
+  const char *arguments;
+  const char *throughput;           //!< text before the total throughput in the output
+  const char *delay;                //!< text before the mean delay in the output
+};
+
+// The last line holding the text is used: anomaly2_6_54 prints the flows
+// first and the total last
+const ValidateScenario VALIDATE_SCENARIOS[] = {
+  { "ms-lab4", "--RngSeed=1 --simulationTime=5 --nWifi=10",
+    "Total throughput: ", "Mean delay: " },
+  { "ms-lab6", "--RngSeed=1 --simulationTime=5 --nWifi=10 --useCsv=0",
+    "- network throughput: ", "- mean delay: " },
+  { "anomaly2_6_54", "--seed=1 --simTime=5",
+    "  Throughput:\t", "  Mean delay:\t" },
+};
+
+struct ValidateResult
+{
+  double throughput = 0;
+  double delay = 0;
+  uint64_t events = 0;
+  double run = 0;
+
+  void Add (const ValidateResult &other)
+  {
+    throughput += other.throughput;
+    delay += other.delay;
+    events += other.events;
+    run += other.run;
+  }
+};
+
+/// \returns the number following the last occurrence of text in the file
+double
+ReadFigure (const std::string &fileName, const std::string &text)
+{
+  std::ifstream file (fileName.c_str ());
+  std::string line;
+  std::string value;
+  while (std::getline (file, line))
+    {
+      std::string::size_type pos = line.find (text);
+      if (pos != std::string::npos)
+        {
+          value = line.substr (pos + text.size ());
+        }
+    }
+  NS_ABORT_MSG_IF (value.empty (), "No \"" << text << "\" in " << fileName);
+  return std::stod (value);
+}
+
+ValidateResult
+RunScenario (const ValidateScenario &scenario, uint32_t run, const std::string &modeArgs,
+             const std::string &waf, const std::string &outputFile, const std::string &reportFile,
+             const std::string &logFile)
+{
+  std::remove (outputFile.c_str ());
+  std::remove (reportFile.c_str ());
+  std::ostringstream command;
+  command << waf << " --run-no-build \"" << scenario.name << " " << scenario.arguments
+          << " --RngRun=" << run << " " << modeArgs
+          << " --SimulatorImplementationType=ns3::BenchmarkSimulatorImpl"
+          << " --ns3::BenchmarkSimulatorImpl::Scenario=" << scenario.name
+          << " --ns3::BenchmarkSimulatorImpl::ReportFile=" << reportFile << "\""
+          << " > " << outputFile << " 2>> " << logFile;
+  NS_LOG_INFO (command.str ());
+  int status = std::system (command.str ().c_str ());
+  NS_ABORT_MSG_UNLESS (status == 0, scenario.name << " failed, see " << logFile << " and " << outputFile);
+
+  ValidateResult result;
+  result.throughput = ReadFigure (outputFile, scenario.throughput);
+  result.delay = ReadFigure (outputFile, scenario.delay);
+  std::ifstream report (reportFile.c_str ());
+  std::string line;
+  while (std::getline (report, line))
+    {
+      std::map<std::string, std::string> fields = ParseFields (line);
+      result.events += std::stoull (fields["events"]);
+      result.run += std::stod (fields["run"]);
+    }
+
+  // Keep the scenario output with the rest of the log
+  std::ifstream output (outputFile.c_str ());
+  std::ofstream log (logFile.c_str (), std::ofstream::out | std::ofstream::app);
+  log << output.rdbuf ();
+  std::remove (outputFile.c_str ());
+  std::remove (reportFile.c_str ());
+  return result;
+}
+
+/// \returns approximated relative to detailed, as a fraction
+double
+GetDifference (double detailed, double approximated)
+{
+  return detailed != 0 ? approximated / detailed - 1 : (approximated != 0 ? 1 : 0);
+}
+
+} // unnamed namespace
+
+int
+RunValidateBench (int argc, char *argv[])
+{
+  std::string scenarios;
+  uint32_t runs = 3;
+  std::string approxArgs = "--sharedDelivery=1 --ns3::SharedDeliveryYansWifiPhy::FrameLevel=1";
+  double tolerance = 0.05;
+  std::string waf = "./waf";
+  std::string logFile = "perf-bench-validate.log";
+
+  CommandLine cmd;
+  cmd.AddValue ("scenarios", "Comma-separated scenarios to run (default: all)", scenarios);
+  cmd.AddValue ("runs", "RngRun values per scenario, from 1", runs);
+  cmd.AddValue ("approxArgs", "Arguments selecting the approximated PHY", approxArgs);
+  cmd.AddValue ("tolerance", "Relative throughput or delay difference flagged", tolerance);
+  cmd.AddValue ("waf", "Path of waf, used to run the scenarios", waf);
+  cmd.AddValue ("log", "File the scenarios' output is appended to", logFile);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (runs > 0, "At least one run is needed");
+  std::vector<ValidateScenario> selected;
+  std::vector<std::string> names = SplitList (scenarios);
+  for (const ValidateScenario &scenario : VALIDATE_SCENARIOS)
+    {
+      if (names.empty () || std::find (names.begin (), names.end (), scenario.name) != names.end ())
+        {
+          selected.push_back (scenario);
+        }
+    }
+  NS_ABORT_MSG_UNLESS (!selected.empty (), "No known scenario in " << scenarios);
+
+  char cwd[4096];
+  NS_ABORT_MSG_UNLESS (getcwd (cwd, sizeof (cwd)) != 0, "Cannot get the current directory");
+  std::string outputFile = std::string (cwd) + "/perf-bench-validate.out";
+  std::string reportFile = std::string (cwd) + "/perf-bench-validate.report";
+  uint32_t mismatches = 0;
+
+  std::cout << "Approximation: " << approxArgs << std::endl
+            << std::left << std::setw (15) << "scenario" << std::right
+            << std::setw (22) << "thr detailed/approx" << std::setw (9) << "diff"
+            << std::setw (24) << "delay detailed/approx" << std::setw (9) << "diff"
+            << std::setw (8) << "events" << std::setw (8) << "speed" << std::endl;
+
+  for (const ValidateScenario &scenario : selected)
+    {
+      ValidateResult detailed;
+      ValidateResult approximated;
+      for (uint32_t run = 1; run <= runs; run++)
+        {
+          detailed.Add (RunScenario (scenario, run, "", waf, outputFile, reportFile, logFile));
+          approximated.Add (RunScenario (scenario, run, approxArgs, waf, outputFile, reportFile, logFile));
+        }
+      double throughputDifference = GetDifference (detailed.throughput, approximated.throughput);
+      double delayDifference = GetDifference (detailed.delay, approximated.delay);
+
+      std::cout << std::left << std::setw (15) << scenario.name << std::right << std::fixed
+                << std::setprecision (2) << std::setw (13) << detailed.throughput / runs
+                << std::setw (9) << approximated.throughput / runs << std::showpos << std::setprecision (1)
+                << std::setw (8) << 100 * throughputDifference << "%" << std::noshowpos
+                << std::setprecision (3) << std::setw (14) << detailed.delay / runs
+                << std::setw (10) << approximated.delay / runs << std::showpos << std::setprecision (1)
+                << std::setw (8) << 100 * delayDifference << "%" << std::noshowpos
+                << std::setprecision (2)
+                << std::setw (8) << (detailed.events > 0 ? static_cast<double> (approximated.events) / detailed.events : 0)
+                << std::setw (8) << (approximated.run > 0 ? detailed.run / approximated.run : 0);
+      if (std::abs (throughputDifference) > tolerance || std::abs (delayDifference) > tolerance)
+        {
+          std::cout << "  MISMATCH";
+          mismatches++;
+        }
+      std::cout << std::endl;
+    }
+
+  if (mismatches > 0)
+    {
+      std::cout << mismatches << " scenario(s) differ from the detailed PHY by more than "
+                << 100 * tolerance << "%" << std::endl;
+      return 1;
+    }
+  return 0;
+}
+
+} // namespace perfbench
+} // namespace ns3
@@ -0,0 +1,236 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef POOLED_EVENT_H
+#define POOLED_EVENT_H
+
+// Pooled event allocation for callbacks that reschedule themselves.
+//
+// Simulator::Schedule (delay, f, args...) allocates a new EventImpl holding
+// the bound arguments for every call, and frees it once the event has run.
+// SchedulePooled (delay, f, args...) takes the same arguments, but the
+// event is allocated from per-thread free lists, one per size class of 16
+// bytes up to eventpool::MAX_SIZE bytes.  Freed events are kept in their
+// free list, so once the number of pending events stops growing,
+// scheduling makes no heap allocations.
+//
+// eventpool::PrintStatistics prints how many events were allocated from
+// the heap and how many heap allocations were avoided by reusing events.
+
+#include "ns3/simulator.h"
+#include "ns3/event-impl.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+namespace ns3 {
+
+namespace eventpool {
+
+const std::size_t GRANULARITY = 16;
+const std::size_t MAX_SIZE = 256;
+const std::size_t N_CLASSES = MAX_SIZE / GRANULARITY;
+
+struct Statistics
+{
+  uint64_t heapAllocations = 0;     //!< events allocated with operator new
+  uint64_t reused = 0;              //!< events taken from a free list
+  uint64_t oversized = 0;           //!< events larger than MAX_SIZE, not pooled
+  uint64_t pooled = 0;              //!< events currently in the free lists
+};
+
+struct FreeBlock
+{
+  FreeBlock *next;
+};
+
+struct Pool
+{
+  FreeBlock *freeLists[N_CLASSES] = {};
+  Statistics stats;
+
+  ~Pool ()
+  {
+    for (std::size_t i = 0; i < N_CLASSES; i++)
+      {
+        while (freeLists[i] != 0)
+          {
+            FreeBlock *block = freeLists[i];
+            freeLists[i] = block->next;
+            ::operator delete (block);
+          }
+      }
+  }
+};
+
+inline Pool &
+GetPool (void)
+{
+  static thread_local Pool pool;
+  return pool;
+}
+
+inline void *
+Allocate (std::size_t size)
+{
+  Pool &pool = GetPool ();
+  if (size > MAX_SIZE)
+    {
+      pool.stats.oversized++;
+      return ::operator new (size);
+    }
+  std::size_t c = (size - 1) / GRANULARITY;
+  FreeBlock *block = pool.freeLists[c];
+  if (block != 0)
+    {
+      pool.freeLists[c] = block->next;
+      pool.stats.reused++;
+      pool.stats.pooled--;
+      return block;
+    }
+  pool.stats.heapAllocations++;
+  return ::operator new ((c + 1) * GRANULARITY);
+}
+
+inline void
+Release (void *p, std::size_t size)
+{
+  if (size > MAX_SIZE)
+    {
+      ::operator delete (p);
+      return;
+    }
+  Pool &pool = GetPool ();
+  std::size_t c = (size - 1) / GRANULARITY;
+  FreeBlock *block = static_cast<FreeBlock *> (p);
+  block->next = pool.freeLists[c];
+  pool.freeLists[c] = block;
+  pool.stats.pooled++;
+}
+
+/// \returns the counters of the calling thread's pool
+inline const Statistics &
+GetStatistics (void)
+{
+  return GetPool ().stats;
+}
+
+inline void
+PrintStatistics (std::ostream &os)
+{
+  const Statistics &stats = GetStatistics ();
+  uint64_t total = stats.heapAllocations + stats.reused + stats.oversized;
+  os << "Pooled events: " << total << " scheduled, "
+     << stats.heapAllocations << " heap allocations, "
+     << stats.reused << " avoided";
+  if (total > 0)
+    {
+      os << " (" << 100.0 * stats.reused / total << "%)";
+    }
+  if (stats.oversized > 0)
+    {
+      os << ", " << stats.oversized << " too large to pool";
+    }
+  os << std::endl;
+}
+
+} // namespace eventpool
+
+/**
+ * EventImpl running a bound callable, allocated from the event pool.
+ * Events are freed through EventImpl's virtual destructor when their last
+ * reference is released, so the sized operator delete returns them to the
+ * right free list.
+ */
+template <typename BOUND>
+class PooledEventImpl : public EventImpl
+{
+public:
+  explicit PooledEventImpl (BOUND &&bound)
+    : m_bound (std::move (bound))
+  {
+  }
+
+  static void *operator new (std::size_t size)
+  {
+    return eventpool::Allocate (size);
+  }
+
+  static void operator delete (void *p, std::size_t size)
+  {
+    eventpool::Release (p, size);
+  }
+
+private:
+  virtual void Notify (void)
+  {
+    m_bound ();
+  }
+
+  BOUND m_bound;
+};
+
+/**
+ * \returns an event invoking f (args...), allocated from the event pool.
+ * f may be a function or a member function followed by the object (raw
+ * pointer or Ptr); like Simulator::Schedule, the arguments are copied.
+ */
+template <typename F, typename... Ts>
+Ptr<EventImpl>
+MakePooledEvent (F f, Ts&&... args)
+{
+  typedef decltype (std::bind (f, std::forward<Ts> (args)...)) Bound;
+  return Ptr<EventImpl> (new PooledEventImpl<Bound> (std::bind (f, std::forward<Ts> (args)...)), false);
+}
+
+/// Simulator::Schedule with a pooled event
+template <typename F, typename... Ts>
+EventId
+SchedulePooled (Time const &delay, F f, Ts&&... args)
+{
+  return Simulator::Schedule (delay, MakePooledEvent (f, std::forward<Ts> (args)...));
+}
+
+/// Simulator::ScheduleNow with a pooled event
+template <typename F, typename... Ts>
+EventId
+SchedulePooledNow (F f, Ts&&... args)
+{
+  return Simulator::ScheduleNow (MakePooledEvent (f, std::forward<Ts> (args)...));
+}
+
+/// Simulator::ScheduleWithContext with a pooled event
+template <typename F, typename... Ts>
+void
+SchedulePooledWithContext (uint32_t context, Time const &delay, F f, Ts&&... args)
+{
+  // The simulator takes over the only reference of the new event, which
+  // is not touched once handed off: with a partitioned simulator it may
+  // already have run and been released on another thread
+  typedef decltype (std::bind (f, std::forward<Ts> (args)...)) Bound;
+  EventImpl *event = new PooledEventImpl<Bound> (std::bind (f, std::forward<Ts> (args)...));
+  Simulator::ScheduleWithContext (context, delay, event);
+}
+
+} // namespace ns3
+
+#endif /* POOLED_EVENT_H */
@@ -0,0 +1,388 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROFILING_SIMULATOR_IMPL_H
+#define PROFILING_SIMULATOR_IMPL_H
+
+// Default simulator that attributes the executed events and their wall
+// time to the code that scheduled them and to the node context they run in.
+//
+// Usage:
+//   --SimulatorImplementationType=ns3::ProfilingSimulatorImpl
+//   --ns3::ProfilingSimulatorImpl::TopN=20
+//   --ns3::ProfilingSimulatorImpl::FoldedStacks=profile.folded
+//
+// When Simulator::Run returns, the events are reported to std::clog in two
+// top-N tables, by call site and by node.  The call site of an event is
+// the return address of the Simulator::Schedule* call that scheduled it,
+// found by walking the stack past the Simulator frames, so two timers
+// calling the same member function are told apart.  It is shown as the
+// enclosing function and offset, as found by dladdr: functions of the
+// program itself only have a name when it is linked with -rdynamic, and
+// are otherwise shown as program+offset, which addr2line resolves.  With
+// FoldedStacks set, the time is also written as "node;call site ns" lines,
+// which can be turned into a flame graph with flamegraph.pl.
+//
+// Every event is wrapped when it is scheduled, which adds one allocation,
+// one stack walk and two clock reads per event: use it to compare where
+// the time goes, not to measure the total run time.
+
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class ProfilingSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  ProfilingSimulatorImpl ();
+  virtual ~ProfilingSimulatorImpl ();
+
+  // Inherited from SimulatorImpl
+  virtual void Run (void);
+  virtual EventId Schedule (const Time &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+
+  /// Print the top-N tables by call site and by node
+  void PrintReport (std::ostream &os) const;
+  /// Write the "node;call site ns" lines for flamegraph.pl
+  void WriteFoldedStacks (const std::string &fileName) const;
+
+private:
+  struct Key
+  {
+    const void *site;
+    uint32_t context;
+
+    bool operator == (const Key &other) const
+    {
+      return site == other.site && context == other.context;
+    }
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator () (const Key &key) const
+    {
+      return std::hash<const void *> () (key.site) * 31 + key.context;
+    }
+  };
+
+  struct Stats
+  {
+    uint64_t count = 0;
+    double ns = 0;
+  };
+
+  /// Runs the wrapped event and charges its time to the profiler
+  class ProfiledEvent : public EventImpl
+  {
+  public:
+    ProfiledEvent (ProfilingSimulatorImpl *profiler, EventImpl *event, const void *site)
+      : m_profiler (profiler),
+        m_event (event, false),
+        m_site (site)
+    {
+    }
+
+  private:
+    virtual void Notify (void)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      m_event->Invoke ();
+      std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+      m_profiler->Record (m_site, elapsed.count ());
+    }
+
+    ProfilingSimulatorImpl *m_profiler;
+    Ptr<EventImpl> m_event;
+    const void *m_site;
+  };
+
+  /// Frames looked at to find the call site, including the Simulator frames
+  static const int MAX_FRAMES = 12;
+
+  const void *CallSite (void);
+  bool IsSimulatorFrame (const void *address);
+  void Record (const void *site, double ns);
+  static std::string Demangle (const char *name);
+  static std::string SiteName (const void *site);
+  static std::string ContextName (uint32_t context);
+
+  uint32_t m_topN;
+  std::string m_foldedStacks;
+
+  std::unordered_map<Key, Stats, KeyHash> m_stats;
+  std::unordered_map<const void *, bool> m_simulatorFrames;
+  std::mutex m_simulatorFramesMutex;         //!< events may be scheduled with a context from other threads
+  double m_runNs;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingSimulatorImpl);
+
+inline TypeId
+ProfilingSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ProfilingSimulatorImpl")
+    .SetParent<DefaultSimulatorImpl> ()
+    .AddConstructor<ProfilingSimulatorImpl> ()
+    .AddAttribute ("TopN",
+                   "Number of rows of the report tables.",
+                   UintegerValue (15),
+                   MakeUintegerAccessor (&ProfilingSimulatorImpl::m_topN),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("FoldedStacks",
+                   "If not empty, write the folded stacks for flamegraph.pl to this file.",
+                   StringValue (""),
+                   MakeStringAccessor (&ProfilingSimulatorImpl::m_foldedStacks),
+                   MakeStringChecker ())
+  ;
+  return tid;
+}
+
+inline
+ProfilingSimulatorImpl::ProfilingSimulatorImpl ()
+  : m_topN (15),
+    m_runNs (0)
+{
+}
+
+inline
+ProfilingSimulatorImpl::~ProfilingSimulatorImpl ()
+{
+}
+
+inline EventId
+ProfilingSimulatorImpl::Schedule (const Time &delay, EventImpl *event)
+{
+  return DefaultSimulatorImpl::Schedule (delay, new ProfiledEvent (this, event, CallSite ()));
+}
+
+inline void
+ProfilingSimulatorImpl::ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event)
+{
+  DefaultSimulatorImpl::ScheduleWithContext (context, delay, new ProfiledEvent (this, event, CallSite ()));
+}
+
+inline EventId
+ProfilingSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  return DefaultSimulatorImpl::ScheduleNow (new ProfiledEvent (this, event, CallSite ()));
+}
+
+inline const void * __attribute__ ((noinline))
+ProfilingSimulatorImpl::CallSite (void)
+{
+  void *frames[MAX_FRAMES];
+  int n = backtrace (frames, MAX_FRAMES);
+  std::lock_guard<std::mutex> lock (m_simulatorFramesMutex);
+  // frames[0] is in this function and frames[1] in Schedule*, which is
+  // called through the SimulatorImpl vtable and thus never inlined
+  for (int i = 2; i < n; i++)
+    {
+      if (!IsSimulatorFrame (frames[i]))
+        {
+          return frames[i];
+        }
+    }
+  return 0;
+}
+
+inline bool
+ProfilingSimulatorImpl::IsSimulatorFrame (const void *address)
+{
+  std::unordered_map<const void *, bool>::iterator i = m_simulatorFrames.find (address);
+  if (i != m_simulatorFrames.end ())
+    {
+      return i->second;
+    }
+  // Simulator::DoSchedule* and, if not inlined, the Simulator::Schedule*
+  // templates, i.e. symbols starting with the mangled "ns3::Simulator::"
+  Dl_info info;
+  const char *prefix = "_ZN3ns39Simulator";
+  bool simulator = dladdr (address, &info) != 0 && info.dli_sname != 0
+    && std::strncmp (info.dli_sname, prefix, std::strlen (prefix)) == 0;
+  m_simulatorFrames[address] = simulator;
+  return simulator;
+}
+
+inline void
+ProfilingSimulatorImpl::Record (const void *site, double ns)
+{
+  Key key = {site, GetContext ()};
+  Stats &stats = m_stats[key];
+  stats.count++;
+  stats.ns += ns;
+}
+
+inline void
+ProfilingSimulatorImpl::Run (void)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  DefaultSimulatorImpl::Run ();
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+  m_runNs += elapsed.count ();
+
+  PrintReport (std::clog);
+  if (!m_foldedStacks.empty ())
+    {
+      WriteFoldedStacks (m_foldedStacks);
+    }
+}
+
+inline std::string
+ProfilingSimulatorImpl::Demangle (const char *name)
+{
+  int status = 0;
+  char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+  if (status != 0 || demangled == 0)
+    {
+      return name;
+    }
+  std::string result (demangled);
+  std::free (demangled);
+  // The namespace adds nothing but width to the tables
+  std::string::size_type pos;
+  while ((pos = result.find ("ns3::")) != std::string::npos)
+    {
+      result.erase (pos, 5);
+    }
+  return result;
+}
+
+inline std::string
+ProfilingSimulatorImpl::SiteName (const void *site)
+{
+  std::ostringstream name;
+  Dl_info info;
+  if (site == 0 || dladdr (site, &info) == 0)
+    {
+      name << "unknown";
+    }
+  else if (info.dli_sname != 0)
+    {
+      name << Demangle (info.dli_sname) << "+0x" << std::hex
+           << static_cast<const char *> (site) - static_cast<const char *> (info.dli_saddr);
+    }
+  else
+    {
+      const char *file = std::strrchr (info.dli_fname, '/');
+      name << (file != 0 ? file + 1 : info.dli_fname) << "+0x" << std::hex
+           << static_cast<const char *> (site) - static_cast<const char *> (info.dli_fbase);
+    }
+  return name.str ();
+}
+
+inline std::string
+ProfilingSimulatorImpl::ContextName (uint32_t context)
+{
+  if (context == Simulator::NO_CONTEXT)
+    {
+      return "no node";
+    }
+  return "node " + std::to_string (context);
+}
+
+inline void
+ProfilingSimulatorImpl::PrintReport (std::ostream &os) const
+{
+  std::map<const void *, Stats> bySite;
+  std::map<uint32_t, Stats> byContext;
+  Stats total;
+  for (const auto &entry : m_stats)
+    {
+      for (Stats *stats : {&bySite[entry.first.site], &byContext[entry.first.context], &total})
+        {
+          stats->count += entry.second.count;
+          stats->ns += entry.second.ns;
+        }
+    }
+
+  os << "*** Event profile ***" << std::endl
+     << "  " << total.count << " events, " << std::fixed << std::setprecision (3)
+     << total.ns * 1e-9 << " s in events, " << (m_runNs - total.ns) * 1e-9
+     << " s in the simulator (scheduling and profiling)" << std::endl;
+
+  std::vector<std::pair<std::string, Stats> > rows;
+  for (const auto &entry : bySite)
+    {
+      rows.push_back (std::make_pair (SiteName (entry.first), entry.second));
+    }
+  std::vector<std::pair<std::string, Stats> > nodeRows;
+  for (const auto &entry : byContext)
+    {
+      nodeRows.push_back (std::make_pair (ContextName (entry.first), entry.second));
+    }
+
+  for (auto *table : {&rows, &nodeRows})
+    {
+      std::sort (table->begin (), table->end (),
+                 [] (const std::pair<std::string, Stats> &a, const std::pair<std::string, Stats> &b)
+                 { return a.second.ns > b.second.ns; });
+      os << std::endl << std::right << std::setw (7) << "time%" << std::setw (12) << "events"
+         << std::setw (10) << "ns/event" << "  " << (table == &rows ? "call site" : "node") << std::endl;
+      for (std::size_t i = 0; i < table->size () && i < m_topN; i++)
+        {
+          const Stats &stats = (*table)[i].second;
+          os << std::setw (7) << std::setprecision (2) << (total.ns > 0 ? 100.0 * stats.ns / total.ns : 0)
+             << std::setw (12) << stats.count << std::setw (10) << std::setprecision (0)
+             << stats.ns / stats.count << "  " << (*table)[i].first << std::endl;
+        }
+    }
+  os << std::endl;
+}
+
+inline void
+ProfilingSimulatorImpl::WriteFoldedStacks (const std::string &fileName) const
+{
+  std::ofstream file (fileName.c_str (), std::ofstream::out);
+  NS_ABORT_MSG_UNLESS (file.is_open (), "Cannot open " << fileName);
+  for (const auto &entry : m_stats)
+    {
+      std::string site = SiteName (entry.first.site);
+      std::replace (site.begin (), site.end (), ';', ',');
+      file << ContextName (entry.first.context) << ";" << site << " "
+           << static_cast<uint64_t> (entry.second.ns) << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* PROFILING_SIMULATOR_IMPL_H */
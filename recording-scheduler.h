@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RECORDING_SCHEDULER_H
+#define RECORDING_SCHEDULER_H
+
+// Scheduler wrapper that forwards every operation to another scheduler and
+// records the sequence of operations to a binary file, so that a scenario's
+// event time distribution can be replayed against each scheduler by
+// "perf-bench --bench=sched".
+//
+// Usage:
+//   --SchedulerType=ns3::RecordingScheduler
+//   --ns3::RecordingScheduler::FileName=tcp-validation-events.bin
+//   --ns3::RecordingScheduler::Scheduler=ns3::MapScheduler
+//
+// The file is a sequence of little-endian int64 values, one per operation:
+// a value >= 0 is an Insert of an event that many time steps after the
+// current simulation time, RECORD_REMOVE_NEXT a RemoveNext and
+// RECORD_REMOVE a Remove, followed by the position of the removed event
+// among the recorded Inserts.
+
+#include "ns3/scheduler.h"
+#include "ns3/object-factory.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+namespace ns3 {
+
+namespace recording {
+
+const int64_t RECORD_REMOVE_NEXT = -1;
+const int64_t RECORD_REMOVE = -2;
+
+} // namespace recording
+
+class RecordingScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  RecordingScheduler ();
+  virtual ~RecordingScheduler ();
+
+  // Inherited from Scheduler
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  virtual void DoDispose (void);
+  void Record (int64_t value);
+
+  std::string m_fileName;
+  std::string m_schedulerType;
+  uint64_t m_maxOperations;
+
+  Ptr<Scheduler> m_scheduler;
+  std::ofstream m_file;
+  uint64_t m_operations;
+  uint64_t m_now;                          //!< timestamp of the last removed event
+  uint64_t m_inserts;
+  std::unordered_map<uint32_t, uint64_t> m_insertIndex; //!< uid -> Insert position
+};
+
+NS_OBJECT_ENSURE_REGISTERED (RecordingScheduler);
+
+inline TypeId
+RecordingScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RecordingScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<RecordingScheduler> ()
+    .AddAttribute ("FileName",
+                   "File the scheduler operations are recorded to.",
+                   StringValue ("scheduler-events.bin"),
+                   MakeStringAccessor (&RecordingScheduler::m_fileName),
+                   MakeStringChecker ())
+    .AddAttribute ("Scheduler",
+                   "TypeId of the scheduler the operations are forwarded to.",
+                   StringValue ("ns3::MapScheduler"),
+                   MakeStringAccessor (&RecordingScheduler::m_schedulerType),
+                   MakeStringChecker ())
+    .AddAttribute ("MaxOperations",
+                   "Stop recording after this many operations.",
+                   UintegerValue (20000000),
+                   MakeUintegerAccessor (&RecordingScheduler::m_maxOperations),
+                   MakeUintegerChecker<uint64_t> ())
+  ;
+  return tid;
+}
+
+inline
+RecordingScheduler::RecordingScheduler ()
+  : m_operations (0),
+    m_now (0),
+    m_inserts (0)
+{
+}
+
+inline
+RecordingScheduler::~RecordingScheduler ()
+{
+}
+
+inline void
+RecordingScheduler::DoDispose (void)
+{
+  if (m_file.is_open ())
+    {
+      m_file.close ();
+    }
+  m_scheduler = 0;
+  Scheduler::DoDispose ();
+}
+
+inline void
+RecordingScheduler::Record (int64_t value)
+{
+  // Attributes are only set once construction is complete, so both the
+  // file and the wrapped scheduler are created on the first operation
+  if (!m_scheduler)
+    {
+      ObjectFactory factory;
+      factory.SetTypeId (m_schedulerType);
+      m_scheduler = factory.Create<Scheduler> ();
+      m_file.open (m_fileName.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+      NS_ABORT_MSG_UNLESS (m_file.is_open (), "Cannot open " << m_fileName);
+    }
+  if (m_operations < m_maxOperations)
+    {
+      m_file.write (reinterpret_cast<const char *> (&value), sizeof (value));
+      m_operations++;
+    }
+}
+
+inline void
+RecordingScheduler::Insert (const Event &ev)
+{
+  Record (static_cast<int64_t> (ev.key.m_ts - m_now));
+  m_insertIndex[ev.key.m_uid] = m_inserts++;
+  m_scheduler->Insert (ev);
+}
+
+inline bool
+RecordingScheduler::IsEmpty (void) const
+{
+  return !m_scheduler || m_scheduler->IsEmpty ();
+}
+
+inline Scheduler::Event
+RecordingScheduler::PeekNext (void) const
+{
+  return m_scheduler->PeekNext ();
+}
+
+inline Scheduler::Event
+RecordingScheduler::RemoveNext (void)
+{
+  Record (recording::RECORD_REMOVE_NEXT);
+  Event ev = m_scheduler->RemoveNext ();
+  m_insertIndex.erase (ev.key.m_uid);
+  m_now = ev.key.m_ts;
+  return ev;
+}
+
+inline void
+RecordingScheduler::Remove (const Event &ev)
+{
+  std::unordered_map<uint32_t, uint64_t>::iterator i = m_insertIndex.find (ev.key.m_uid);
+  NS_ASSERT (i != m_insertIndex.end ());
+  Record (recording::RECORD_REMOVE);
+  Record (static_cast<int64_t> (i->second));
+  m_insertIndex.erase (i);
+  m_scheduler->Remove (ev);
+}
+
+} // namespace ns3
+
+#endif /* RECORDING_SCHEDULER_H */
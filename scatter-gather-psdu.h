@@ -0,0 +1,293 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCATTER_GATHER_PSDU_H
+#define SCATTER_GATHER_PSDU_H
+
+// A-MPDU and A-MSDU described by references to the queued packets.
+//
+// Aggregating MSDUs into an A-MSDU (WifiMacQueueItem::Aggregate) builds a
+// new packet, adding each MSDU and its subframe header at the end, and
+// the PSDU packet handed to the PHY traces and to pcap
+// (WifiPsdu::GetPacket) is built the same way from the MPDUs, with their
+// MAC headers, delimiters and padding.  With the 1 MB A-MPDUs of 7935 B
+// A-MSDUs of ms-lab7-maxthr, that is hundreds of buffer copies and
+// allocations per PSDU.
+//
+// ScatterGatherPsdu only records the layout of the aggregate: one segment
+// per A-MPDU delimiter, MAC header, A-MSDU subframe header, MSDU payload,
+// padding and FCS, the payload segments holding a reference to the queued
+// packet.  Sizes follow MpduAggregator and MsduAggregator: 4 B delimiters
+// and 14 B subframe headers, every subframe but the last padded to a
+// multiple of 4 B.  Clear releases the packets but keeps the storage, so
+// describing an aggregate does not allocate once the first one has been
+// built.
+//
+// "perf-bench --bench=aggregate" reports the allocations and the time per
+// A-MPDU of both constructions.
+
+#include "ns3/packet.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/mac48-address.h"
+#include "ns3/assert.h"
+
+#include <vector>
+
+namespace ns3 {
+
+namespace scattergather {
+
+const uint32_t DELIMITER_SIZE = 4;
+const uint32_t SUBFRAME_HEADER_SIZE = 14;
+const uint32_t FCS_SIZE = 4;
+
+/// \returns the padding after a subframe ending at size
+inline uint32_t
+GetPadding (uint32_t size)
+{
+  return (4 - size % 4) % 4;
+}
+
+enum SegmentType
+{
+  DELIMITER,
+  MAC_HEADER,
+  SUBFRAME_HEADER,
+  PAYLOAD,
+  PADDING,
+  FCS
+};
+
+struct Segment
+{
+  SegmentType type;
+  uint32_t size;
+  uint32_t mpdu;                    //!< index of the MPDU of the segment, see ScatterGatherPsdu::GetHeader
+  Ptr<const Packet> packet;         //!< PAYLOAD: the queued packet
+  Mac48Address source;              //!< SUBFRAME_HEADER: the addresses
+  Mac48Address destination;
+};
+
+} // namespace scattergather
+
+class ScatterGatherPsdu
+{
+public:
+  ScatterGatherPsdu ();
+
+  /// Forget the MPDUs and release their packets, keeping the storage
+  void Clear (void);
+
+  /**
+   * Start an MPDU, whose MSDUs are added next
+   *
+   * \param header the MAC header of the MPDU
+   * \param amsdu true if the MSDUs are A-MSDU subframes
+   */
+  void AddMpdu (const WifiMacHeader &header, bool amsdu);
+  /// Add an MSDU to the last MPDU
+  void AddMsdu (Ptr<const Packet> msdu, Mac48Address source, Mac48Address destination);
+
+  /// \returns the size of the A-MPDU, delimiters and padding included
+  uint32_t GetSize (void) const;
+  /// \returns the size of the MPDU, header and FCS included
+  uint32_t GetMpduSize (uint32_t mpdu) const;
+  uint32_t GetNMpdus (void) const;
+  /// \returns the MAC header of the MPDU
+  const WifiMacHeader &GetHeader (uint32_t mpdu) const;
+
+  /// \returns the segments, in transmission order; the A-MPDU padding
+  /// after the last MPDU is left out
+  const std::vector<scattergather::Segment> &GetSegments (void);
+
+private:
+  struct Mpdu
+  {
+    WifiMacHeader header;
+    bool amsdu;
+    uint32_t firstMsdu;             //!< index in m_msdus
+    uint32_t nMsdus;
+    uint32_t size;
+  };
+
+  struct Msdu
+  {
+    Ptr<const Packet> packet;
+    Mac48Address source;
+    Mac48Address destination;
+  };
+
+  std::vector<Mpdu> m_mpdus;
+  std::vector<Msdu> m_msdus;
+  uint32_t m_nMpdus;
+  uint32_t m_nMsdus;
+  std::vector<scattergather::Segment> m_segments;
+  uint32_t m_nSegments;             //!< m_segments built for the current MPDUs, else 0
+};
+
+inline
+ScatterGatherPsdu::ScatterGatherPsdu ()
+  : m_nMpdus (0),
+    m_nMsdus (0),
+    m_nSegments (0)
+{
+}
+
+inline void
+ScatterGatherPsdu::Clear (void)
+{
+  for (uint32_t i = 0; i < m_nMsdus; i++)
+    {
+      m_msdus[i].packet = 0;
+    }
+  m_nMpdus = 0;
+  m_nMsdus = 0;
+  m_segments.clear ();
+  m_nSegments = 0;
+}
+
+inline void
+ScatterGatherPsdu::AddMpdu (const WifiMacHeader &header, bool amsdu)
+{
+  if (m_nMpdus == m_mpdus.size ())
+    {
+      m_mpdus.push_back (Mpdu ());
+    }
+  Mpdu &mpdu = m_mpdus[m_nMpdus++];
+  mpdu.header = header;
+  mpdu.amsdu = amsdu;
+  mpdu.firstMsdu = m_nMsdus;
+  mpdu.nMsdus = 0;
+  mpdu.size = header.GetSize () + scattergather::FCS_SIZE;
+  m_nSegments = 0;
+}
+
+inline void
+ScatterGatherPsdu::AddMsdu (Ptr<const Packet> msdu, Mac48Address source, Mac48Address destination)
+{
+  NS_ASSERT (m_nMpdus > 0);
+  Mpdu &mpdu = m_mpdus[m_nMpdus - 1];
+  NS_ASSERT (mpdu.amsdu || mpdu.nMsdus == 0);
+  if (m_nMsdus == m_msdus.size ())
+    {
+      m_msdus.push_back (Msdu ());
+    }
+  Msdu &m = m_msdus[m_nMsdus++];
+  m.packet = msdu;
+  m.source = source;
+  m.destination = destination;
+
+  if (mpdu.amsdu)
+    {
+      uint32_t amsduSize = mpdu.size - mpdu.header.GetSize () - scattergather::FCS_SIZE;
+      if (mpdu.nMsdus > 0)
+        {
+          mpdu.size += scattergather::GetPadding (amsduSize);
+        }
+      mpdu.size += scattergather::SUBFRAME_HEADER_SIZE;
+    }
+  mpdu.size += msdu->GetSize ();
+  mpdu.nMsdus++;
+  m_nSegments = 0;
+}
+
+inline uint32_t
+ScatterGatherPsdu::GetSize (void) const
+{
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < m_nMpdus; i++)
+    {
+      if (i > 0)
+        {
+          size += scattergather::GetPadding (size);
+        }
+      size += scattergather::DELIMITER_SIZE + m_mpdus[i].size;
+    }
+  return size;
+}
+
+inline uint32_t
+ScatterGatherPsdu::GetMpduSize (uint32_t mpdu) const
+{
+  NS_ASSERT (mpdu < m_nMpdus);
+  return m_mpdus[mpdu].size;
+}
+
+inline uint32_t
+ScatterGatherPsdu::GetNMpdus (void) const
+{
+  return m_nMpdus;
+}
+
+inline const WifiMacHeader &
+ScatterGatherPsdu::GetHeader (uint32_t mpdu) const
+{
+  NS_ASSERT (mpdu < m_nMpdus);
+  return m_mpdus[mpdu].header;
+}
+
+inline const std::vector<scattergather::Segment> &
+ScatterGatherPsdu::GetSegments (void)
+{
+  if (m_nSegments > 0)
+    {
+      return m_segments;
+    }
+  m_segments.clear ();
+  uint32_t ampduSize = 0;
+  for (uint32_t i = 0; i < m_nMpdus; i++)
+    {
+      const Mpdu &mpdu = m_mpdus[i];
+      uint32_t padding = i > 0 ? scattergather::GetPadding (ampduSize) : 0;
+      if (padding > 0)
+        {
+          m_segments.push_back ({scattergather::PADDING, padding, i - 1, 0, Mac48Address (), Mac48Address ()});
+        }
+      m_segments.push_back ({scattergather::DELIMITER, scattergather::DELIMITER_SIZE, i, 0,
+                             Mac48Address (), Mac48Address ()});
+      m_segments.push_back ({scattergather::MAC_HEADER, mpdu.header.GetSize (), i, 0,
+                             Mac48Address (), Mac48Address ()});
+      uint32_t amsduSize = 0;
+      for (uint32_t j = mpdu.firstMsdu; j < mpdu.firstMsdu + mpdu.nMsdus; j++)
+        {
+          const Msdu &msdu = m_msdus[j];
+          if (mpdu.amsdu)
+            {
+              uint32_t subframePadding = j > mpdu.firstMsdu ? scattergather::GetPadding (amsduSize) : 0;
+              if (subframePadding > 0)
+                {
+                  m_segments.push_back ({scattergather::PADDING, subframePadding, i, 0,
+                                         Mac48Address (), Mac48Address ()});
+                }
+              m_segments.push_back ({scattergather::SUBFRAME_HEADER, scattergather::SUBFRAME_HEADER_SIZE, i, 0,
+                                     msdu.source, msdu.destination});
+              amsduSize += subframePadding + scattergather::SUBFRAME_HEADER_SIZE;
+            }
+          m_segments.push_back ({scattergather::PAYLOAD, msdu.packet->GetSize (), i, msdu.packet,
+                                 Mac48Address (), Mac48Address ()});
+          amsduSize += msdu.packet->GetSize ();
+        }
+      m_segments.push_back ({scattergather::FCS, scattergather::FCS_SIZE, i, 0,
+                             Mac48Address (), Mac48Address ()});
+      ampduSize += padding + scattergather::DELIMITER_SIZE + mpdu.size;
+    }
+  m_nSegments = m_segments.size ();
+  return m_segments;
+}
+
+} // namespace ns3
+
+#endif /* SCATTER_GATHER_PSDU_H */
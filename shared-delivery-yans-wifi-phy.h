@@ -0,0 +1,700 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SHARED_DELIVERY_YANS_WIFI_PHY_H
+#define SHARED_DELIVERY_YANS_WIFI_PHY_H
+
+// Yans PHY that delivers one shared PPDU to all the receivers of a frame.
+//
+// YansWifiChannel::Send copies the PPDU for every other PHY on the
+// channel and schedules its reception, and only then, when the reception
+// event runs, drops it if the received power is below the sensitivity of
+// the receiver.  SharedDeliveryYansWifiPhy does the fan-out itself when
+// it transmits: receivers below their sensitivity get no event at all,
+// and the others all get the same read-only PPDU.  The PSDU inside is
+// already shared by the channel, and the MAC copies the packet only when
+// it forwards it up the stack, so no copy is made for receivers that drop
+// the frame.
+//
+// The loss and delay models of the channel are called for every receiver
+// in the same order as YansWifiChannel does, so random loss models draw
+// the same values.  A LogDistance or Friis loss alone in its chain, and a
+// constant speed delay, are instead evaluated for all the receivers at
+// once by BatchPropagationLoss (see batch-propagation-loss.h), with the
+// same results.  The simulation results are unchanged; only the number
+// of executed events drops.
+//
+// With the FrameLevel attribute set, a SharedDeliveryYansWifiPhy receives
+// a frame with one event when it starts and one when it ends, instead of
+// the preamble detection, header and payload phases of WifiPhy.  When the
+// frame starts it is added to the interference, as in WifiPhy.  If the PHY
+// is idle, the preamble is detected when the RSSI and the SNR reach the
+// thresholds of the preamble detection model (DetectionThreshold and
+// DetectionSnrThreshold, which SharedDeliveryPhyHelper copies from the
+// model), and the PHY header is decoded, both with the interference known
+// at that time.  A decoded header switches the PHY to RX for the whole
+// frame, so the MAC sees the medium busy for the same time and gets the
+// frame, and its NAV, when it ends.  A frame that is not received keeps
+// the PHY CCA busy while its preamble was detected or while the energy
+// on the channel exceeds the CCA threshold.  When the frame ends, every
+// MPDU is decoded with all the interference over its share of the
+// payload, in proportion to its size.  Frames starting during the header
+// of another one are thus not seen by its header decoding, and the MPDU
+// boundaries are approximate, so the results change; "perf-bench
+// --bench=validate" measures by how much against YansWifiPhy.  MU PPDUs
+// are still received by WifiPhy.
+//
+// On PartitionedSimulatorImpl (see partitioned-simulator-impl.h) the
+// receivers of another partition run on another thread, so they cannot
+// share the PPDU, or any reference counted object, with the sender.
+// SharedDeliveryPhyHelper::SetPartitions resolves the receivers of every
+// PHY before the run, and the PHY then sends the PPDU to the receivers of
+// other partitions serialized, once per transmission: each of them
+// rebuilds it in its own partition.  Their reception starts one preamble
+// and header duration late, which is the lookahead that the scenario can
+// grant between its partitions on top of the propagation delay.  This is
+// an approximation: the frames of another partition are heard late,
+// which suits partitions that exchange no frames, only interference, as
+// the BSSs of ms-lab7-outdoor.  The loss and delay models must be
+// evaluated by BatchPropagationLoss.  The sender must not read the PHYs
+// and mobility models of other partitions while they run, so
+// SetPartitions takes a snapshot of the channel number, gain, sensitivity
+// and position of every receiver, and the nodes must not move: their
+// mobility models must be ConstantPositionMobilityModel.
+//
+// Scenarios use it by building their PHYs with SharedDeliveryPhyHelper
+// instead of YansWifiPhyHelper.  shareddelivery::PrintStatistics prints
+// how many receptions were scheduled and skipped.
+
+#include "ns3/yans-wifi-phy.h"
+#include "ns3/yans-wifi-channel.h"
+#include "ns3/yans-wifi-helper.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-ppdu.h"
+#include "ns3/wifi-psdu.h"
+#include "ns3/wifi-mac-queue-item.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/node-list.h"
+#include "ns3/wifi-utils.h"
+#include "ns3/interference-helper.h"
+#include "ns3/wifi-phy-state-helper.h"
+#include "ns3/preamble-detection-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/pointer.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/simulator.h"
+#include "ns3/abort.h"
+#include "batch-propagation-loss.h"
+#include "partitioned-simulator-impl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+namespace shareddelivery {
+
+// Updated by the threads of all the partitions
+struct Statistics
+{
+  std::atomic<uint64_t> transmissions {0};
+  std::atomic<uint64_t> deliveries {0};          //!< receptions scheduled with the shared PPDU
+  std::atomic<uint64_t> belowSensitivity {0};    //!< receptions not scheduled
+  std::atomic<uint64_t> frameReceptions {0};     //!< FrameLevel receptions of a decoded header
+  std::atomic<uint64_t> frameInterference {0};   //!< FrameLevel receptions kept as interference only
+  std::atomic<uint64_t> batchTransmissions {0};  //!< loss computed by BatchPropagationLoss
+  std::atomic<uint64_t> remoteDeliveries {0};    //!< receptions scheduled in other partitions
+};
+
+/// A PPDU sent to other partitions, with its MPDUs serialized
+struct RemotePpdu
+{
+  WifiTxVector txVector;
+  Time duration;
+  WifiPhyBand band;
+  uint64_t uid;
+  bool aggregate;
+  bool single;
+  std::vector<WifiMacHeader> headers;
+  std::vector<std::vector<uint8_t> > payloads;
+};
+
+inline Statistics &
+GetStatistics (void)
+{
+  static Statistics stats;
+  return stats;
+}
+
+inline void
+PrintStatistics (std::ostream &os)
+{
+  const Statistics &stats = GetStatistics ();
+  os << "Shared delivery: " << stats.transmissions.load () << " transmissions, " << stats.deliveries.load ()
+     << " receptions scheduled, " << stats.belowSensitivity.load () << " skipped below sensitivity, "
+     << stats.frameReceptions.load () << " frame-level receptions, " << stats.frameInterference.load ()
+     << " frame-level interference, " << stats.batchTransmissions.load ()
+     << " batch loss computations, " << stats.remoteDeliveries.load () << " receptions in other partitions" << std::endl;
+}
+
+} // namespace shareddelivery
+
+class SharedDeliveryYansWifiPhy : public YansWifiPhy
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SharedDeliveryYansWifiPhy ();
+  virtual ~SharedDeliveryYansWifiPhy ();
+
+  /**
+   * Resolve the receivers now, for a run on PartitionedSimulatorImpl, and
+   * send the PPDU serialized to those of other partitions.  Must be called
+   * before Simulator::Run, once all the devices are on the channel.
+   * \param impl the simulator implementation
+   */
+  void SetPartitions (Ptr<PartitionedSimulatorImpl> impl);
+
+  // Inherited from YansWifiPhy
+  virtual void StartTx (Ptr<WifiPpdu> ppdu);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Read the channel models on the first transmission, and refresh the
+  /// receiver list when devices were added to the channel
+  void UpdateReceivers (Ptr<YansWifiChannel> channel);
+  static void Receive (Ptr<WifiPhy> phy, Ptr<WifiPpdu> ppdu, double rxPowerDbm);
+  /// FrameLevel: add the frame to the interference, detect the preamble
+  /// and decode the header, and schedule the end of the frame if received
+  void StartReceiveFrame (Ptr<WifiPpdu> ppdu, double rxPowerDbm);
+  /// FrameLevel: decode the MPDUs and pass them to the MAC
+  void EndReceiveFrame (Ptr<Event> event);
+  /// Stay CCA busy while the energy on the channel exceeds the CCA threshold
+  void MaybeCcaBusy (void);
+  /// Serialize the PPDU for the receivers of other partitions
+  static std::shared_ptr<const shareddelivery::RemotePpdu> Serialize (Ptr<const WifiPpdu> ppdu, WifiPhyBand band);
+  /// Rebuild the PPDU in the partition of the receiver, and receive it
+  static void ReceiveRemote (WifiPhy *phy, bool frameLevel, std::shared_ptr<const shareddelivery::RemotePpdu> remote, double rxPowerDbm);
+
+  Ptr<PropagationLossModel> m_loss;
+  Ptr<PropagationDelayModel> m_delay;
+  BatchPropagationLoss m_batchLoss;
+  double m_delaySpeed;              //!< speed of a constant speed delay model, else 0
+  std::vector<Ptr<WifiPhy> > m_receivers;
+  std::vector<Ptr<MobilityModel> > m_receiverMobility;
+  std::vector<uint32_t> m_receiverNodes;
+  std::vector<bool> m_receiverRemote;   //!< in another partition
+  std::vector<bool> m_receiverFrameLevel;     //!< a SharedDeliveryYansWifiPhy with FrameLevel
+  // Taken by SetPartitions, since the receivers may run on other threads
+  std::vector<uint16_t> m_receiverChannels;
+  std::vector<double> m_receiverRxGainDb;
+  std::vector<double> m_receiverSensitivityDbm;
+  std::size_t m_nDevices;
+  bool m_partitioned;                   //!< receivers resolved by SetPartitions
+  bool m_frameLevel;
+  double m_detectionThresholdDbm;
+  double m_detectionSnrThresholdDb;
+
+  batchloss::Positions m_positions;
+  std::vector<double> m_distances;
+  std::vector<double> m_rxPowerDbm;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SharedDeliveryYansWifiPhy);
+
+inline TypeId
+SharedDeliveryYansWifiPhy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SharedDeliveryYansWifiPhy")
+    .SetParent<YansWifiPhy> ()
+    .AddConstructor<SharedDeliveryYansWifiPhy> ()
+    .AddAttribute ("FrameLevel",
+                   "Receive frames with one event when they start and one when they end: "
+                   "the preamble and header are decoded with the interference known when "
+                   "the frame starts, the MPDUs when it ends",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SharedDeliveryYansWifiPhy::m_frameLevel),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DetectionThreshold",
+                   "Minimum RSSI of the preamble detection model of the PHY (dBm), "
+                   "set by SharedDeliveryPhyHelper; used with FrameLevel",
+                   DoubleValue (-std::numeric_limits<double>::max ()),
+                   MakeDoubleAccessor (&SharedDeliveryYansWifiPhy::m_detectionThresholdDbm),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("DetectionSnrThreshold",
+                   "Minimum SNR of the preamble detection model of the PHY (dB), "
+                   "set by SharedDeliveryPhyHelper; used with FrameLevel",
+                   DoubleValue (-std::numeric_limits<double>::max ()),
+                   MakeDoubleAccessor (&SharedDeliveryYansWifiPhy::m_detectionSnrThresholdDb),
+                   MakeDoubleChecker<double> ())
+  ;
+  return tid;
+}
+
+inline
+SharedDeliveryYansWifiPhy::SharedDeliveryYansWifiPhy ()
+  : m_batchLoss (0),
+    m_delaySpeed (0),
+    m_nDevices (0),
+    m_partitioned (false),
+    m_frameLevel (false),
+    m_detectionThresholdDbm (-std::numeric_limits<double>::max ()),
+    m_detectionSnrThresholdDb (-std::numeric_limits<double>::max ())
+{
+}
+
+inline
+SharedDeliveryYansWifiPhy::~SharedDeliveryYansWifiPhy ()
+{
+}
+
+inline void
+SharedDeliveryYansWifiPhy::DoDispose (void)
+{
+  m_loss = 0;
+  m_delay = 0;
+  m_receivers.clear ();
+  m_receiverMobility.clear ();
+  m_receiverNodes.clear ();
+  m_receiverRemote.clear ();
+  m_receiverFrameLevel.clear ();
+  m_receiverChannels.clear ();
+  m_receiverRxGainDb.clear ();
+  m_receiverSensitivityDbm.clear ();
+  YansWifiPhy::DoDispose ();
+}
+
+inline void
+SharedDeliveryYansWifiPhy::UpdateReceivers (Ptr<YansWifiChannel> channel)
+{
+  if (m_loss == 0)
+    {
+      PointerValue loss;
+      channel->GetAttribute ("PropagationLossModel", loss);
+      m_loss = loss.Get<PropagationLossModel> ();
+      PointerValue delay;
+      channel->GetAttribute ("PropagationDelayModel", delay);
+      m_delay = delay.Get<PropagationDelayModel> ();
+      m_batchLoss = BatchPropagationLoss (m_loss);
+      if (DynamicCast<ConstantSpeedPropagationDelayModel> (m_delay) != 0)
+        {
+          DoubleValue speed;
+          m_delay->GetAttribute ("Speed", speed);
+          m_delaySpeed = speed.Get ();
+        }
+    }
+  if (m_nDevices == channel->GetNDevices ())
+    {
+      return;
+    }
+  m_nDevices = channel->GetNDevices ();
+  m_receivers.clear ();
+  m_receiverMobility.clear ();
+  m_receiverNodes.clear ();
+  m_receiverRemote.clear ();
+  m_receiverFrameLevel.clear ();
+  for (std::size_t i = 0; i < m_nDevices; i++)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (channel->GetDevice (i));
+      if (device != 0 && device->GetPhy () != this)
+        {
+          m_receivers.push_back (device->GetPhy ());
+          m_receiverMobility.push_back (device->GetPhy ()->GetMobility ());
+          m_receiverNodes.push_back (device->GetNode ()->GetId ());
+          m_receiverRemote.push_back (false);
+          Ptr<SharedDeliveryYansWifiPhy> phy = DynamicCast<SharedDeliveryYansWifiPhy> (device->GetPhy ());
+          m_receiverFrameLevel.push_back (phy != 0 && phy->m_frameLevel);
+        }
+    }
+  m_positions.Resize (m_receivers.size ());
+}
+
+inline void
+SharedDeliveryYansWifiPhy::SetPartitions (Ptr<PartitionedSimulatorImpl> impl)
+{
+  UpdateReceivers (DynamicCast<YansWifiChannel> (GetChannel ()));
+  // Other partitions must not see the reference counts of the models
+  NS_ABORT_MSG_UNLESS (m_batchLoss.IsSupported () && m_delaySpeed > 0,
+                       "Partitions need a loss model evaluated by BatchPropagationLoss and a constant speed delay");
+  uint32_t partition = impl->GetPartition (GetDevice ()->GetNode ()->GetId ());
+  m_receiverChannels.clear ();
+  m_receiverRxGainDb.clear ();
+  m_receiverSensitivityDbm.clear ();
+  for (std::size_t i = 0; i < m_receivers.size (); i++)
+    {
+      m_receiverRemote[i] = impl->GetPartition (m_receiverNodes[i]) != partition;
+      NS_ABORT_MSG_UNLESS (DynamicCast<ConstantPositionMobilityModel> (m_receiverMobility[i]) != 0,
+                           "Partitioned nodes must not move");
+      m_receiverChannels.push_back (m_receivers[i]->GetChannelNumber ());
+      m_receiverRxGainDb.push_back (m_receivers[i]->GetRxGain ());
+      m_receiverSensitivityDbm.push_back (m_receivers[i]->GetRxSensitivity ());
+      m_positions.Set (i, m_receiverMobility[i]->GetPosition ());
+    }
+  m_partitioned = true;
+}
+
+inline void
+SharedDeliveryYansWifiPhy::StartTx (Ptr<WifiPpdu> ppdu)
+{
+  if (!m_partitioned)
+    {
+      UpdateReceivers (DynamicCast<YansWifiChannel> (GetChannel ()));
+    }
+  shareddelivery::Statistics &stats = shareddelivery::GetStatistics ();
+  stats.transmissions++;
+
+  double txPowerDbm = GetTxPowerForTransmission (ppdu) + GetTxGain ();
+  Ptr<MobilityModel> senderMobility = GetMobility ();
+  bool batch = m_batchLoss.IsSupported ();
+  if (batch)
+    {
+      for (std::size_t i = 0; !m_partitioned && i < m_receivers.size (); i++)
+        {
+          m_positions.Set (i, m_receiverMobility[i]->GetPosition ());
+        }
+      m_batchLoss.CalcRxPower (txPowerDbm, senderMobility->GetPosition (), m_positions, m_distances, m_rxPowerDbm);
+      stats.batchTransmissions++;
+    }
+
+  std::shared_ptr<const shareddelivery::RemotePpdu> remote;
+  Time preamble;
+  for (std::size_t i = 0; i < m_receivers.size (); i++)
+    {
+      const Ptr<WifiPhy> &receiver = m_receivers[i];
+      uint16_t channel = m_partitioned ? m_receiverChannels[i] : receiver->GetChannelNumber ();
+      double rxGainDb = m_partitioned ? m_receiverRxGainDb[i] : receiver->GetRxGain ();
+      double sensitivityDbm = m_partitioned ? m_receiverSensitivityDbm[i] : receiver->GetRxSensitivity ();
+      // For now don't account for inter channel interference nor channel bonding
+      if (channel != GetChannelNumber ())
+        {
+          continue;
+        }
+      Time delay = batch && m_delaySpeed > 0
+        ? Seconds (m_distances[i] / m_delaySpeed)
+        : m_delay->GetDelay (senderMobility, m_receiverMobility[i]);
+      double rxPowerDbm = batch
+        ? m_rxPowerDbm[i]
+        : m_loss->CalcRxPower (txPowerDbm, senderMobility, m_receiverMobility[i]);
+      // The received power is constant over the PPDU, so the check done on
+      // reception can be done now
+      if (rxPowerDbm + rxGainDb < sensitivityDbm)
+        {
+          stats.belowSensitivity++;
+          continue;
+        }
+      if (m_receiverRemote[i])
+        {
+          if (!remote)
+            {
+              remote = Serialize (ppdu, GetPhyBand ());
+              preamble = CalculatePhyPreambleAndHeaderDuration (ppdu->GetTxVector ());
+            }
+          stats.remoteDeliveries++;
+          Simulator::ScheduleWithContext (m_receiverNodes[i], delay + preamble,
+                                          &SharedDeliveryYansWifiPhy::ReceiveRemote, PeekPointer (receiver),
+                                          m_receiverFrameLevel[i], remote, rxPowerDbm);
+          continue;
+        }
+      stats.deliveries++;
+      if (m_receiverFrameLevel[i])
+        {
+          Simulator::ScheduleWithContext (m_receiverNodes[i], delay,
+                                          &SharedDeliveryYansWifiPhy::StartReceiveFrame,
+                                          StaticCast<SharedDeliveryYansWifiPhy> (receiver), ppdu, rxPowerDbm);
+          continue;
+        }
+      Simulator::ScheduleWithContext (m_receiverNodes[i], delay,
+                                      &SharedDeliveryYansWifiPhy::Receive, receiver, ppdu, rxPowerDbm);
+    }
+}
+
+inline std::shared_ptr<const shareddelivery::RemotePpdu>
+SharedDeliveryYansWifiPhy::Serialize (Ptr<const WifiPpdu> ppdu, WifiPhyBand band)
+{
+  NS_ABORT_MSG_IF (ppdu->IsMu (), "MU PPDUs cannot be sent to other partitions");
+  Ptr<const WifiPsdu> psdu = ppdu->GetPsdu ();
+  std::shared_ptr<shareddelivery::RemotePpdu> remote = std::make_shared<shareddelivery::RemotePpdu> ();
+  remote->txVector = ppdu->GetTxVector ();
+  remote->duration = ppdu->GetTxDuration ();
+  remote->band = band;
+  remote->uid = ppdu->GetUid ();
+  remote->aggregate = psdu->IsAggregate ();
+  remote->single = psdu->IsSingle ();
+  for (std::size_t i = 0; i < psdu->GetNMpdus (); i++)
+    {
+      Ptr<const Packet> payload = psdu->GetPayload (i);
+      std::vector<uint8_t> bytes (payload->GetSerializedSize ());
+      NS_ABORT_MSG_UNLESS (payload->Serialize (bytes.data (), bytes.size ()), "Cannot serialize the MPDU");
+      remote->headers.push_back (psdu->GetHeader (i));
+      remote->payloads.push_back (bytes);
+    }
+  return remote;
+}
+
+inline void
+SharedDeliveryYansWifiPhy::ReceiveRemote (WifiPhy *phy, bool frameLevel, std::shared_ptr<const shareddelivery::RemotePpdu> remote, double rxPowerDbm)
+{
+  std::vector<Ptr<WifiMacQueueItem> > mpdus;
+  for (std::size_t i = 0; i < remote->headers.size (); i++)
+    {
+      const std::vector<uint8_t> &bytes = remote->payloads[i];
+      Ptr<Packet> packet = Create<Packet> (bytes.data (), bytes.size (), true);
+      mpdus.push_back (Create<WifiMacQueueItem> (packet, remote->headers[i]));
+    }
+  Ptr<WifiPsdu> psdu;
+  if (!remote->aggregate)
+    {
+      psdu = Create<WifiPsdu> (mpdus.front ()->GetPacket (), mpdus.front ()->GetHeader ());
+    }
+  else if (remote->single)
+    {
+      psdu = Create<WifiPsdu> (mpdus.front (), true);
+    }
+  else
+    {
+      psdu = Create<WifiPsdu> (mpdus);
+    }
+  Ptr<WifiPpdu> ppdu = Create<WifiPpdu> (psdu, remote->txVector, remote->duration, remote->band, remote->uid);
+  if (frameLevel)
+    {
+      static_cast<SharedDeliveryYansWifiPhy *> (phy)->StartReceiveFrame (ppdu, rxPowerDbm);
+      return;
+    }
+  Receive (phy, ppdu, rxPowerDbm);
+}
+
+inline void
+SharedDeliveryYansWifiPhy::Receive (Ptr<WifiPhy> phy, Ptr<WifiPpdu> ppdu, double rxPowerDbm)
+{
+  RxPowerWattPerChannelBand rxPowerW;
+  rxPowerW.insert ({std::make_pair (0, 0), DbmToW (rxPowerDbm + phy->GetRxGain ())}); //dummy band for YANS
+  phy->StartReceivePreamble (ppdu, rxPowerW);
+}
+
+inline void
+SharedDeliveryYansWifiPhy::StartReceiveFrame (Ptr<WifiPpdu> ppdu, double rxPowerDbm)
+{
+  shareddelivery::Statistics &stats = shareddelivery::GetStatistics ();
+  WifiSpectrumBand band = std::make_pair (0, 0); //dummy band for YANS
+  RxPowerWattPerChannelBand rxPowerW;
+  rxPowerW.insert ({band, DbmToW (rxPowerDbm + GetRxGain ())});
+  if (ppdu->IsMu ())
+    {
+      // Left to the reception of WifiPhy
+      StartReceivePreamble (ppdu, rxPowerW);
+      return;
+    }
+  WifiTxVector txVector = ppdu->GetTxVector ();
+  Time duration = ppdu->GetTxDuration ();
+  Ptr<Event> event = m_interference.Add (ppdu, txVector, duration, rxPowerW);
+  Ptr<const WifiPsdu> psdu = ppdu->GetPsdu ();
+
+  if (m_state->IsStateSleep () || m_state->IsStateOff ())
+    {
+      stats.frameInterference++;
+      NotifyRxDrop (psdu, SLEEPING);
+      return;
+    }
+  // A frame arriving during another one, including one received by
+  // WifiPhy from a plain YansWifiPhy, is only interference
+  if (!(m_state->IsStateIdle () || m_state->IsStateCcaBusy ())
+      || m_endRxEvent.IsRunning () || m_endPhyRxEvent.IsRunning () || m_endPreambleDetectionEvent.IsRunning ()
+      || txVector.GetChannelWidth () > GetChannelWidth ())
+    {
+      stats.frameInterference++;
+      NotifyRxDrop (psdu, m_state->IsStateTx () ? TXING : (m_state->IsStateSwitching () ? CHANNEL_SWITCHING : RXING));
+      MaybeCcaBusy ();
+      return;
+    }
+
+  // The preamble is sent on every 20 MHz channel
+  uint16_t measurementWidth = std::min<uint16_t> (txVector.GetChannelWidth (), 20);
+  double snrDb = RatioToDb (m_interference.CalculateSnr (event, measurementWidth, 1, band));
+  if (rxPowerDbm + GetRxGain () < m_detectionThresholdDbm || snrDb < m_detectionSnrThresholdDb)
+    {
+      stats.frameInterference++;
+      NotifyRxDrop (psdu, PREAMBLE_DETECT_FAILURE);
+      MaybeCcaBusy ();
+      return;
+    }
+  bool header = m_random->GetValue () > m_interference.CalculateNonHtPhyHeaderSnrPer (event, band).per;
+  if (header && txVector.GetMode ().GetModulationClass () >= WIFI_MOD_CLASS_HT)
+    {
+      header = m_random->GetValue () > m_interference.CalculateHtPhyHeaderSnrPer (event, band).per;
+    }
+  if (!header)
+    {
+      // The preamble was detected: CCA stays busy until the frame ends
+      stats.frameInterference++;
+      NotifyRxDrop (psdu, L_SIG_FAILURE);
+      m_state->SwitchMaybeToCcaBusy (duration);
+      return;
+    }
+
+  stats.frameReceptions++;
+  m_interference.NotifyRxStart ();
+  NotifyRxBegin (psdu, rxPowerW);
+  m_state->SwitchToRx (duration);
+  m_endRxEvent = Simulator::Schedule (duration, &SharedDeliveryYansWifiPhy::EndReceiveFrame, this, event);
+}
+
+inline void
+SharedDeliveryYansWifiPhy::EndReceiveFrame (Ptr<Event> event)
+{
+  WifiSpectrumBand band = std::make_pair (0, 0); //dummy band for YANS
+  Ptr<const WifiPpdu> ppdu = event->GetPpdu ();
+  Ptr<const WifiPsdu> psdu = ppdu->GetPsdu ();
+  WifiTxVector txVector = event->GetTxVector ();
+  int64_t payload = (ppdu->GetTxDuration () - CalculatePhyPreambleAndHeaderDuration (txVector)).GetTimeStep ();
+  // Each MPDU takes the share of the payload of its A-MPDU subframe
+  std::vector<bool> statusPerMpdu;
+  double snr = 0;
+  double total = psdu->GetSize ();
+  uint32_t offset = 0;
+  for (std::size_t i = 0; i < psdu->GetNMpdus (); i++)
+    {
+      uint32_t size = psdu->IsAggregate () ? psdu->GetAmpduSubframeSize (i) : psdu->GetSize ();
+      std::pair<Time, Time> window (TimeStep (static_cast<uint64_t> (payload * std::min (offset / total, 1.0))),
+                                    TimeStep (static_cast<uint64_t> (payload * std::min ((offset + size) / total, 1.0))));
+      offset += size;
+      InterferenceHelper::SnrPer snrPer = m_interference.CalculatePayloadSnrPer (event, txVector.GetChannelWidth (),
+                                                                                band, SU_STA_ID, window);
+      snr = snrPer.snr;
+      statusPerMpdu.push_back (m_random->GetValue () > snrPer.per);
+    }
+  m_interference.NotifyRxEnd ();
+
+  if (std::find (statusPerMpdu.begin (), statusPerMpdu.end (), true) != statusPerMpdu.end ())
+    {
+      RxSignalInfo rxSignalInfo;
+      rxSignalInfo.snr = snr;
+      rxSignalInfo.rssi = WToDbm (event->GetRxPowerW (band));
+      NotifyRxEnd (psdu);
+      m_state->SwitchFromRxEndOk (Copy (psdu), rxSignalInfo, txVector, SU_STA_ID, statusPerMpdu);
+    }
+  else
+    {
+      m_state->SwitchFromRxEndError (Copy (psdu), snr);
+    }
+  MaybeCcaBusy ();
+}
+
+inline void
+SharedDeliveryYansWifiPhy::MaybeCcaBusy (void)
+{
+  Time delay = m_interference.GetEnergyDuration (DbmToW (GetCcaEdThreshold ()), std::make_pair (0, 0));
+  if (!delay.IsZero ())
+    {
+      m_state->SwitchMaybeToCcaBusy (delay);
+    }
+}
+
+/**
+ * YansWifiPhyHelper creating SharedDeliveryYansWifiPhy objects, or plain
+ * YansWifiPhy objects when enable is false
+ */
+class SharedDeliveryPhyHelper : public YansWifiPhyHelper
+{
+public:
+  explicit SharedDeliveryPhyHelper (bool enable = true)
+    : m_enable (enable)
+  {
+    if (enable)
+      {
+        m_phy.SetTypeId ("ns3::SharedDeliveryYansWifiPhy");
+      }
+    UpdateDetectionThreshold ();
+  }
+
+  /// Forwarded to YansWifiPhyHelper, then the PHYs get the minimum RSSI
+  /// of the new model as DetectionThreshold
+  template <typename... Args>
+  void SetPreambleDetectionModel (std::string name, Args&&... args)
+  {
+    YansWifiPhyHelper::SetPreambleDetectionModel (name, std::forward<Args> (args)...);
+    UpdateDetectionThreshold ();
+  }
+
+  void DisablePreambleDetectionModel (void)
+  {
+    YansWifiPhyHelper::DisablePreambleDetectionModel ();
+    UpdateDetectionThreshold ();
+  }
+
+  /// Call SharedDeliveryYansWifiPhy::SetPartitions on the PHYs of all the nodes
+  static void SetPartitions (Ptr<PartitionedSimulatorImpl> impl)
+  {
+    for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+      {
+        for (uint32_t i = 0; i < (*node)->GetNDevices (); i++)
+          {
+            Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> ((*node)->GetDevice (i));
+            Ptr<SharedDeliveryYansWifiPhy> phy = device != 0 ? DynamicCast<SharedDeliveryYansWifiPhy> (device->GetPhy ()) : 0;
+            if (phy != 0)
+              {
+                phy->SetPartitions (impl);
+              }
+          }
+      }
+  }
+
+private:
+  /// Copy the MinimumRssi and Threshold of the preamble detection model
+  /// that the PHYs will get into their DetectionThreshold and
+  /// DetectionSnrThreshold.  Without such a model a PHY detects every
+  /// frame above its sensitivity.
+  void UpdateDetectionThreshold (void)
+  {
+    if (!m_enable)
+      {
+        return;
+      }
+    double threshold = -std::numeric_limits<double>::max ();
+    double snrThreshold = -std::numeric_limits<double>::max ();
+    if (m_preambleDetectionModel.IsTypeIdSet ())
+      {
+        Ptr<PreambleDetectionModel> model = m_preambleDetectionModel.Create<PreambleDetectionModel> ();
+        DoubleValue value;
+        if (model->GetAttributeFailSafe ("MinimumRssi", value))
+          {
+            threshold = value.Get ();
+          }
+        if (model->GetAttributeFailSafe ("Threshold", value))
+          {
+            snrThreshold = value.Get ();
+          }
+      }
+    m_phy.Set ("DetectionThreshold", DoubleValue (threshold));
+    m_phy.Set ("DetectionSnrThreshold", DoubleValue (snrThreshold));
+  }
+
+  bool m_enable;
+};
+
+} // namespace ns3
+
+#endif /* SHARED_DELIVERY_YANS_WIFI_PHY_H */
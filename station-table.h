@@ -0,0 +1,210 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATION_TABLE_H
+#define STATION_TABLE_H
+
+// Per-station state indexed by MAC address.
+//
+// WifiRemoteStationManager finds the state of a station by walking its
+// list of known stations and comparing addresses, for every frame sent or
+// received; an AP with hundreds of associated stations (the APs of
+// ms-lab7-outdoor, large nWifi in ms-lab4 and ms-lab6) pays for the whole
+// walk.  StationTable stores the states in a deque, in the order the
+// stations were added, and finds them through an open-addressing hash
+// table with linear probing, kept at most half full, whose slots hold the
+// index of the state.  That index is a small integer station ID: it never
+// changes, so a caller can keep it with a frame and reach the state with
+// Get, without hashing the address again.  Adding a station does not move
+// the other states, so the pointers and references returned by Lookup and
+// Get stay valid until Clear.
+//
+// Stations are never removed, as in WifiRemoteStationManager; Clear
+// forgets all of them.
+//
+// "perf-bench --bench=stations" compares it with the lookup of the
+// station manager.
+
+#include "ns3/mac48-address.h"
+#include "ns3/assert.h"
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+namespace ns3 {
+
+namespace stationtable {
+
+/// Slot of the hash table not holding a station
+const uint32_t EMPTY = 0xffffffff;
+
+/// \returns the 48 bits of the address
+inline uint64_t
+GetKey (Mac48Address address)
+{
+  uint8_t buffer[6];
+  address.CopyTo (buffer);
+  uint64_t key = 0;
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      key = (key << 8) | buffer[i];
+    }
+  return key;
+}
+
+} // namespace stationtable
+
+template <typename T>
+class StationTable
+{
+public:
+  StationTable ();
+
+  /**
+   * \returns the ID of the station, added with a default state if the
+   * address is new
+   */
+  uint32_t Add (Mac48Address address);
+  /// \returns the ID of the station, or stationtable::EMPTY if unknown
+  uint32_t Find (Mac48Address address) const;
+  /// \returns the state of the station, or 0 if unknown
+  T *Lookup (Mac48Address address);
+
+  /// \returns the state of the station with the given ID
+  T &Get (uint32_t id);
+  Mac48Address GetAddress (uint32_t id) const;
+  uint32_t GetN (void) const;
+  void Clear (void);
+
+private:
+  /// \returns the slot of key, or the empty slot where it would go
+  uint32_t Probe (uint64_t key) const;
+  void Grow (void);
+
+  std::vector<uint32_t> m_slots;    //!< station IDs, stationtable::EMPTY if free
+  uint32_t m_mask;                  //!< m_slots.size () - 1
+  std::vector<uint64_t> m_keys;     //!< by station ID
+  std::vector<Mac48Address> m_addresses;
+  std::deque<T> m_states;           //!< by station ID, never moved by Add
+};
+
+template <typename T>
+StationTable<T>::StationTable ()
+  : m_slots (16, stationtable::EMPTY),
+    m_mask (15)
+{
+}
+
+template <typename T>
+uint32_t
+StationTable<T>::Probe (uint64_t key) const
+{
+  // Fibonacci hashing: the high bits of the product mix all the address bytes
+  uint32_t slot = static_cast<uint32_t> ((key * 0x9e3779b97f4a7c15ULL) >> 32) & m_mask;
+  while (m_slots[slot] != stationtable::EMPTY && m_keys[m_slots[slot]] != key)
+    {
+      slot = (slot + 1) & m_mask;
+    }
+  return slot;
+}
+
+template <typename T>
+void
+StationTable<T>::Grow (void)
+{
+  m_slots.assign (m_slots.size () * 2, stationtable::EMPTY);
+  m_mask = m_slots.size () - 1;
+  for (uint32_t id = 0; id < m_keys.size (); id++)
+    {
+      m_slots[Probe (m_keys[id])] = id;
+    }
+}
+
+template <typename T>
+uint32_t
+StationTable<T>::Add (Mac48Address address)
+{
+  uint64_t key = stationtable::GetKey (address);
+  uint32_t slot = Probe (key);
+  if (m_slots[slot] != stationtable::EMPTY)
+    {
+      return m_slots[slot];
+    }
+  uint32_t id = m_keys.size ();
+  m_keys.push_back (key);
+  m_addresses.push_back (address);
+  m_states.push_back (T ());
+  m_slots[slot] = id;
+  if (2 * m_keys.size () > m_slots.size ())
+    {
+      Grow ();
+    }
+  return id;
+}
+
+template <typename T>
+uint32_t
+StationTable<T>::Find (Mac48Address address) const
+{
+  return m_slots[Probe (stationtable::GetKey (address))];
+}
+
+template <typename T>
+T *
+StationTable<T>::Lookup (Mac48Address address)
+{
+  uint32_t id = Find (address);
+  return id != stationtable::EMPTY ? &m_states[id] : 0;
+}
+
+template <typename T>
+T &
+StationTable<T>::Get (uint32_t id)
+{
+  NS_ASSERT (id < m_states.size ());
+  return m_states[id];
+}
+
+template <typename T>
+Mac48Address
+StationTable<T>::GetAddress (uint32_t id) const
+{
+  NS_ASSERT (id < m_addresses.size ());
+  return m_addresses[id];
+}
+
+template <typename T>
+uint32_t
+StationTable<T>::GetN (void) const
+{
+  return m_keys.size ();
+}
+
+template <typename T>
+void
+StationTable<T>::Clear (void)
+{
+  m_slots.assign (16, stationtable::EMPTY);
+  m_mask = 15;
+  m_keys.clear ();
+  m_addresses.clear ();
+  m_states.clear ();
+}
+
+} // namespace ns3
+
+#endif /* STATION_TABLE_H */
@@ -109,6 +109,43 @@
 //    --queueUseEcn:    use ECN on queue [false]
 //    --enablePcap:     enable Pcap [false]
 //    --validate:       validation case to run []
+//    --queueEventTrace: write per-event bottleneck drop/mark traces [true]
+//    --partitions:     run on the partitioned simulator (0, 1 or 2) [0]
+//
+// Every packet is tagged with its flow hash when it leaves the sending
+// end host.  FQ-CoDel (through a packet filter) and the bottleneck trace
+// sinks reuse the tagged hash instead of parsing the 5-tuple on each hop.
+//
+// With --partitions=2 the dumbbell is cut at the bottleneck link: the
+// servers and WR form one partition, LR and the clients the other, and the
+// one-way delay of the bottleneck link is used as lookahead (see
+// partitioned-simulator-impl.h), and the bottleneck link passes packets
+// between the partitions through a PartitionedPointToPointChannel.  Each
+// partition runs on its own thread if the network module is thread-safe
+// (PARTITIONED_THREAD_SAFE_NETWORK), else both run on one thread.
+// --partitions=1 is the sequential reference run: the same simulator with
+// a single partition, which executes the same events in the same order as
+// --partitions=2, so both produce bit-identical traces.  These may differ
+// from the traces of the default simulator, which breaks timestamp ties by
+// global scheduling order; partitioned-simulator-impl.h explains why that
+// order cannot be kept across threads.
+//
+// Per-flow drop and mark counters at the bottleneck, including the marks
+// seen in every marks sampling interval, are written to
+// tcp-validation-queue-flow-summary.dat with the other traces (that is,
+// unless validating); disabling queueEventTrace avoids the per-event
+// output in long ECN experiments.
+//
+// The event scheduler is chosen with the SchedulerType global value, e.g.
+// --SchedulerType=ns3::LadderScheduler (see ladder-scheduler.h).  Running
+// with --SchedulerType=ns3::RecordingScheduler records the event times for
+// "perf-bench --bench=sched" (see recording-scheduler.h).
+//
+// With --SimulatorImplementationType=ns3::FingerprintSimulatorImpl the
+// executed events, the cwnd and Rx traces and the bottleneck drops and
+// marks are hashed and checked against fingerprints.golden (see
+// fingerprint-simulator-impl.h); a mismatch is fatal, like a failed
+// validation.  Each set of command-line arguments has its own golden value.
 //
 // validation cases (and syntax of how to run):
 // ------------
@@ -144,6 +181,9 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/applications-module.h"
@@ -151,6 +191,12 @@
 #include "ns3/internet-module.h"
 #include "ns3/internet-apps-module.h"
 #include "ns3/point-to-point-module.h"
+#include "partitioned-simulator-impl.h"
+#include "partitioned-point-to-point-channel.h"
+#include "ladder-scheduler.h"
+#include "recording-scheduler.h"
+#include "fingerprint-simulator-impl.h"
+#include "benchmark-simulator-impl.h" // Figures for perf-bench --bench=suite
 
 using namespace ns3;
 
@@ -164,6 +210,240 @@ uint32_t g_marksObserved = 0;
 uint32_t g_dropsObserved = 0;
 std::string g_validate = "";  // Empty string disables this mode
 bool g_validationFailed = false;
+bool g_queueEventTrace = true; // Write one line per bottleneck drop/mark event
+bool g_fingerprint = false;    // Fold the traced values into the determinism fingerprint
+
+// Per-flow drop and mark counters at the bottleneck queue disc, keyed by
+// the flow hash of the packet.  marksPerInterval holds one entry per
+// marks sampling interval, starting from the beginning of the simulation;
+// the interval cut short by the end of the simulation is added by
+// WriteFlowQueueSummary.
+struct FlowQueueStats
+{
+  uint32_t drops = 0;
+  uint32_t marks = 0;
+  uint32_t intervalMarks = 0;
+  std::vector<uint32_t> marksPerInterval;
+};
+std::unordered_map<uint32_t, FlowQueueStats> g_flowQueueStats;
+uint32_t g_marksIntervals = 0;
+
+// Packet tag caching the flow hash, so that the 5-tuple is parsed out of
+// the headers once per packet rather than on every drop or mark event
+class FlowHashTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  void SetHash (uint32_t hash);
+  uint32_t GetHash (void) const;
+
+private:
+  uint32_t m_hash = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FlowHashTag);
+
+TypeId
+FlowHashTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FlowHashTag")
+    .SetParent<Tag> ()
+    .AddConstructor<FlowHashTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+FlowHashTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+FlowHashTag::GetSerializedSize (void) const
+{
+  return 4;
+}
+
+void
+FlowHashTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_hash);
+}
+
+void
+FlowHashTag::Deserialize (TagBuffer i)
+{
+  m_hash = i.ReadU32 ();
+}
+
+void
+FlowHashTag::Print (std::ostream &os) const
+{
+  os << "hash=" << m_hash;
+}
+
+void
+FlowHashTag::SetHash (uint32_t hash)
+{
+  m_hash = hash;
+}
+
+uint32_t
+FlowHashTag::GetHash (void) const
+{
+  return m_hash;
+}
+
+// Compute the flow hash of an outgoing IPv4 packet from its header and
+// transport payload.  The result is the same as Ipv4QueueDiscItem::Hash ()
+// with a zero perturbation, so that tagged and untagged packets of a
+// flow hash alike.
+uint32_t
+ComputeFlowHash (const Ipv4Header &header, Ptr<const Packet> payload)
+{
+  uint8_t prot = header.GetProtocol ();
+  uint16_t srcPort = 0;
+  uint16_t destPort = 0;
+  if ((prot == 6 || prot == 17) && header.GetFragmentOffset () == 0)
+    {
+      // TCP and UDP both carry the source and destination ports in the
+      // first four bytes of their header
+      uint8_t ports[4];
+      if (payload->CopyData (ports, 4) == 4)
+        {
+          srcPort = (ports[0] << 8) | ports[1];
+          destPort = (ports[2] << 8) | ports[3];
+        }
+    }
+
+  uint8_t buf[17];
+  header.GetSource ().Serialize (buf);
+  header.GetDestination ().Serialize (buf + 4);
+  buf[8] = prot;
+  buf[9] = (srcPort >> 8) & 0xff;
+  buf[10] = srcPort & 0xff;
+  buf[11] = (destPort >> 8) & 0xff;
+  buf[12] = destPort & 0xff;
+  buf[13] = 0;
+  buf[14] = 0;
+  buf[15] = 0;
+  buf[16] = 0;
+  return Hash32 ((char*) buf, 17);
+}
+
+// Tag every packet with its flow hash as it leaves the sending node, so
+// that the queue discs and trace sinks on every hop reuse it
+void
+TagFlowHashAtSender (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  FlowHashTag tag;
+  if (!packet->PeekPacketTag (tag))
+    {
+      tag.SetHash (ComputeFlowHash (header, packet));
+      packet->AddPacketTag (tag);
+    }
+}
+
+// Return the flow hash of the item, computing and caching it on the
+// packet if the sender did not tag it
+uint32_t
+GetFlowHash (Ptr<const QueueDiscItem> item)
+{
+  FlowHashTag tag;
+  if (item->GetPacket ()->PeekPacketTag (tag))
+    {
+      return tag.GetHash ();
+    }
+  uint32_t hash = item->Hash ();
+  tag.SetHash (hash);
+  item->GetPacket ()->AddPacketTag (tag);
+  return hash;
+}
+
+// Packet filter classifying items by their cached flow hash.  Installed on
+// FQ-CoDel, it replaces the per-hop 5-tuple parsing of Hash (); with the
+// default zero perturbation and a power-of-two number of flows, every
+// packet lands in the same flow queue as before.
+class FlowHashTagPacketFilter : public PacketFilter
+{
+public:
+  static TypeId GetTypeId (void);
+
+private:
+  virtual bool CheckProtocol (Ptr<QueueDiscItem> item) const;
+  virtual int32_t DoClassify (Ptr<QueueDiscItem> item) const;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FlowHashTagPacketFilter);
+
+TypeId
+FlowHashTagPacketFilter::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FlowHashTagPacketFilter")
+    .SetParent<PacketFilter> ()
+    .AddConstructor<FlowHashTagPacketFilter> ()
+  ;
+  return tid;
+}
+
+bool
+FlowHashTagPacketFilter::CheckProtocol (Ptr<QueueDiscItem> item) const
+{
+  return true;
+}
+
+int32_t
+FlowHashTagPacketFilter::DoClassify (Ptr<QueueDiscItem> item) const
+{
+  // Clear the top bit so that no hash collides with PF_NO_MATCH
+  return static_cast<int32_t> (GetFlowHash (item) & 0x7fffffff);
+}
+
+FlowQueueStats &
+GetFlowQueueStats (uint32_t hash)
+{
+  auto it = g_flowQueueStats.find (hash);
+  if (it == g_flowQueueStats.end ())
+    {
+      it = g_flowQueueStats.emplace (hash, FlowQueueStats ()).first;
+      // Flows first seen late still get a series aligned with the others
+      it->second.marksPerInterval.resize (g_marksIntervals, 0);
+    }
+  return it->second;
+}
+
+// One line per flow: hash, drops, marks, then the marks observed in
+// each marks sampling interval, the last one being partial
+void
+WriteFlowQueueSummary (std::ofstream* ofStream)
+{
+  std::vector<uint32_t> hashes;
+  hashes.reserve (g_flowQueueStats.size ());
+  for (auto &entry : g_flowQueueStats)
+    {
+      entry.second.marksPerInterval.push_back (entry.second.intervalMarks);
+      entry.second.intervalMarks = 0;
+      hashes.push_back (entry.first);
+    }
+  std::sort (hashes.begin (), hashes.end ());
+  for (uint32_t hash : hashes)
+    {
+      const FlowQueueStats &stats = g_flowQueueStats[hash];
+      *ofStream << std::hex << hash << std::dec << " " << stats.drops << " " << stats.marks;
+      for (uint32_t marks : stats.marksPerInterval)
+        {
+          *ofStream << " " << marks;
+        }
+      *ofStream << std::endl;
+    }
+}
 
 void
 TraceFirstCwnd (std::ofstream* ofStream, uint32_t oldCwnd, uint32_t newCwnd)
@@ -174,6 +454,10 @@ TraceFirstCwnd (std::ofstream* ofStream, uint32_t oldCwnd, uint32_t newCwnd)
     {
       *ofStream << Simulator::Now ().GetSeconds () << " " << static_cast<double> (newCwnd) / 1448 << std::endl;
     }
+  if (g_fingerprint)
+    {
+      fingerprint::AddTraceValue ("firstCwnd", newCwnd);
+    }
   // Validation checks; both the ECN enabled and disabled cases are similar
   if (g_validate == "cubic-50ms-no-ecn" || g_validate == "cubic-50ms-ecn")
     {
@@ -254,6 +538,10 @@ TraceSecondCwnd (std::ofstream* ofStream, uint32_t oldCwnd, uint32_t newCwnd)
     {
       *ofStream << Simulator::Now ().GetSeconds () << " " << static_cast<double> (newCwnd) / 1448 << std::endl;
     }
+  if (g_fingerprint)
+    {
+      fingerprint::AddTraceValue ("secondCwnd", newCwnd);
+    }
 }
 
 void
@@ -287,32 +575,54 @@ void
 TraceFirstRx (Ptr<const Packet> packet, const Address &address)
 {
   g_firstBytesReceived += packet->GetSize ();
+  if (g_fingerprint)
+    {
+      fingerprint::AddTraceValue ("firstRx", packet->GetSize ());
+    }
 }
 
 void
 TraceSecondRx (Ptr<const Packet> packet, const Address &address)
 {
   g_secondBytesReceived += packet->GetSize ();
+  if (g_fingerprint)
+    {
+      fingerprint::AddTraceValue ("secondRx", packet->GetSize ());
+    }
 }
 
 void
 TraceQueueDrop (std::ofstream* ofStream, Ptr<const QueueDiscItem> item)
 {
-  if (g_validate == "")
+  uint32_t hash = GetFlowHash (item);
+  if (g_validate == "" && g_queueEventTrace)
     {
-      *ofStream << Simulator::Now ().GetSeconds () << " " << std::hex << item->Hash () << std::endl;
+      *ofStream << Simulator::Now ().GetSeconds () << " " << std::hex << hash << std::endl;
     }
+  GetFlowQueueStats (hash).drops++;
   g_dropsObserved++;
+  if (g_fingerprint)
+    {
+      fingerprint::AddTraceValue ("queueDrop", hash);
+    }
 }
 
 void
 TraceQueueMark (std::ofstream* ofStream, Ptr<const QueueDiscItem> item, const char* reason)
 {
-  if (g_validate == "")
+  uint32_t hash = GetFlowHash (item);
+  if (g_validate == "" && g_queueEventTrace)
     {
-      *ofStream << Simulator::Now ().GetSeconds () << " " << std::hex << item->Hash () << std::endl;
+      *ofStream << Simulator::Now ().GetSeconds () << " " << std::hex << hash << std::endl;
     }
+  FlowQueueStats &stats = GetFlowQueueStats (hash);
+  stats.marks++;
+  stats.intervalMarks++;
   g_marksObserved++;
+  if (g_fingerprint)
+    {
+      fingerprint::AddTraceValue ("queueMark", hash);
+    }
 }
 
 void
@@ -333,6 +643,12 @@ TraceMarksFrequency (std::ofstream* ofStream, Time marksSamplingInterval)
       *ofStream << Simulator::Now ().GetSeconds () << " " << g_marksObserved << std::endl;
     }
   g_marksObserved = 0;
+  for (auto &entry : g_flowQueueStats)
+    {
+      entry.second.marksPerInterval.push_back (entry.second.intervalMarks);
+      entry.second.intervalMarks = 0;
+    }
+  g_marksIntervals++;
   Simulator::Schedule (marksSamplingInterval, &TraceMarksFrequency, ofStream, marksSamplingInterval);
 }
 
@@ -456,6 +772,7 @@ main (int argc, char *argv[])
   std::string queueDropTraceFile = "tcp-validation-queue-drop.dat";
   std::string queueMarksFrequencyTraceFile = "tcp-validation-queue-marks-frequency.dat";
   std::string queueLengthTraceFile = "tcp-validation-queue-length.dat";
+  std::string queueFlowSummaryFile = "tcp-validation-queue-flow-summary.dat";
 
   ////////////////////////////////////////////////////////////
   // variables configured at command line                   //
@@ -469,10 +786,12 @@ main (int argc, char *argv[])
   bool queueUseEcn = false;
   Time ceThreshold = MilliSeconds (1);
   bool enablePcap = false;
+  uint32_t partitions = 0;
 
   ////////////////////////////////////////////////////////////
   // Override ns-3 defaults                                 //
   ////////////////////////////////////////////////////////////
+  Config::SetDefault ("ns3::FingerprintSimulatorImpl::Scenario", StringValue ("tcp-validation"));
   Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1448));
   // Increase default buffer sizes to improve throughput over long delay paths
   //Config::SetDefault ("ns3::TcpSocket::SndBufSize",UintegerValue (8192000));
@@ -496,7 +815,18 @@ main (int argc, char *argv[])
   cmd.AddValue ("queueUseEcn", "use ECN on queue", queueUseEcn);
   cmd.AddValue ("enablePcap", "enable Pcap", enablePcap);
   cmd.AddValue ("validate", "validation case to run", g_validate);
+  cmd.AddValue ("queueEventTrace", "write per-event bottleneck drop/mark traces", g_queueEventTrace);
+  cmd.AddValue ("partitions", "partitioned simulator: 0 (off), 1 (reference) or 2 (cut at bottleneck)", partitions);
   cmd.Parse (argc, argv);
+  fingerprint::SetCommandLine (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (partitions <= 2, "partitions must be 0, 1 or 2");
+  if (partitions > 0)
+    {
+      // Must be selected before the first event is scheduled
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::PartitionedSimulatorImpl"));
+    }
+  g_fingerprint = fingerprint::IsEnabled ();
 
   // If validation is selected, perform some configuration checks
   if (g_validate != "")
@@ -644,6 +974,7 @@ main (int argc, char *argv[])
   std::ofstream queueMarkOfStream;
   std::ofstream queueMarksFrequencyOfStream;
   std::ofstream queueLengthOfStream;
+  std::ofstream queueFlowSummaryOfStream;
   if (g_validate == "")
     {
       pingOfStream.open (pingTraceFile.c_str (), std::ofstream::out);
@@ -664,10 +995,14 @@ main (int argc, char *argv[])
               secondTcpDctcpOfStream.open (secondDctcpTraceFile.c_str (), std::ofstream::out);
             }
         }
-      queueDropOfStream.open (queueDropTraceFile.c_str (), std::ofstream::out);
-      queueMarkOfStream.open (queueMarkTraceFile.c_str (), std::ofstream::out);
+      if (g_queueEventTrace)
+        {
+          queueDropOfStream.open (queueDropTraceFile.c_str (), std::ofstream::out);
+          queueMarkOfStream.open (queueMarkTraceFile.c_str (), std::ofstream::out);
+        }
       queueMarksFrequencyOfStream.open (queueMarksFrequencyTraceFile.c_str (), std::ofstream::out);
       queueLengthOfStream.open (queueLengthTraceFile.c_str (), std::ofstream::out);
+      queueFlowSummaryOfStream.open (queueFlowSummaryFile.c_str (), std::ofstream::out);
     }
 
   ////////////////////////////////////////////////////////////
@@ -682,6 +1017,22 @@ main (int argc, char *argv[])
   Ptr<Node> firstClient = CreateObject<Node> ();
   Ptr<Node> secondClient = CreateObject<Node> ();
 
+  Ptr<PartitionedSimulatorImpl> partitionedImpl;
+  if (partitions > 0)
+    {
+      partitionedImpl = DynamicCast<PartitionedSimulatorImpl> (Simulator::GetImplementation ());
+    }
+  if (partitions == 2)
+    {
+      // Servers and WR stay in partition 0; the bottleneck link is the
+      // only path between the partitions
+      partitionedImpl->SetPartition (lanRouter->GetId (), 1);
+      partitionedImpl->SetPartition (pingClient->GetId (), 1);
+      partitionedImpl->SetPartition (firstClient->GetId (), 1);
+      partitionedImpl->SetPartition (secondClient->GetId (), 1);
+      partitionedImpl->SetLookahead (oneWayDelay);
+    }
+
   // Device containers
   NetDeviceContainer pingServerDevices;
   NetDeviceContainer firstServerDevices;
@@ -701,6 +1052,10 @@ main (int argc, char *argv[])
   secondServerDevices = p2p.Install (wanRouter, secondServer);
   p2p.SetChannelAttribute ("Delay", TimeValue (oneWayDelay));
   wanLanDevices = p2p.Install (wanRouter, lanRouter);
+  if (partitions > 0)
+    {
+      PartitionedPointToPointChannel::Install (wanLanDevices);
+    }
   p2p.SetQueue ("ns3::DropTailQueue", "MaxSize", QueueSizeValue (QueueSize ("3p")));
   p2p.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (1)));
   pingClientDevices = p2p.Install (lanRouter, pingClient);
@@ -741,8 +1096,11 @@ main (int argc, char *argv[])
   // on all single device nodes.  The below code overrides the configuration
   // that is normally done by the Ipv4AddressHelper::Install() method by
   // instead explicitly configuring the queue discs we want on each device.
+  // FQ-CoDel classifies packets by the flow hash tagged at the sender
+  // rather than parsing the headers again on every hop.
   TrafficControlHelper tchFq;
-  tchFq.SetRootQueueDisc ("ns3::FqCoDelQueueDisc");
+  uint16_t fqHandle = tchFq.SetRootQueueDisc ("ns3::FqCoDelQueueDisc");
+  tchFq.AddPacketFilter (fqHandle, "ns3::FlowHashTagPacketFilter");
   tchFq.SetQueueLimits ("ns3::DynamicQueueLimits", "HoldTime", StringValue ("1ms"));
   tchFq.Install (pingServerDevices);
   tchFq.Install (firstServerDevices);
@@ -753,7 +1111,11 @@ main (int argc, char *argv[])
   tchFq.Install (secondClientDevices);
   // Install queue for bottleneck link
   TrafficControlHelper tchBottleneck;
-  tchBottleneck.SetRootQueueDisc (queueTypeId.GetName ());
+  uint16_t bottleneckHandle = tchBottleneck.SetRootQueueDisc (queueTypeId.GetName ());
+  if (queueTypeId == FqCoDelQueueDisc::GetTypeId ())
+    {
+      tchBottleneck.AddPacketFilter (bottleneckHandle, "ns3::FlowHashTagPacketFilter");
+    }
   tchBottleneck.SetQueueLimits ("ns3::DynamicQueueLimits", "HoldTime", StringValue ("1ms"));
   tchBottleneck.Install (wanLanDevices.Get (0));
 
@@ -775,6 +1137,19 @@ main (int argc, char *argv[])
 
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
+  // Compute the flow hash once at the end hosts; the routers only forward
+  NodeContainer endHosts;
+  endHosts.Add (pingServer);
+  endHosts.Add (firstServer);
+  endHosts.Add (secondServer);
+  endHosts.Add (pingClient);
+  endHosts.Add (firstClient);
+  endHosts.Add (secondClient);
+  for (NodeContainer::Iterator i = endHosts.Begin (); i != endHosts.End (); ++i)
+    {
+      (*i)->GetObject<Ipv4L3Protocol> ()->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&TagFlowHashAtSender));
+    }
+
   ////////////////////////////////////////////////////////////
   // application setup                                      //
   ////////////////////////////////////////////////////////////
@@ -866,6 +1241,11 @@ main (int argc, char *argv[])
 
   Simulator::Stop (stopTime);
   Simulator::Run ();
+  if (partitionedImpl)
+    {
+      partitionedImpl->PrintStatistics (std::cout);
+    }
+  partitionedImpl = 0;
   Simulator::Destroy ();
 
   if (g_validate == "")
@@ -888,15 +1268,24 @@ main (int argc, char *argv[])
               secondTcpDctcpOfStream.close ();
             }
         }
-      queueDropOfStream.close ();
-      queueMarkOfStream.close ();
+      if (g_queueEventTrace)
+        {
+          queueDropOfStream.close ();
+          queueMarkOfStream.close ();
+        }
       queueMarksFrequencyOfStream.close ();
       queueLengthOfStream.close ();
+      WriteFlowQueueSummary (&queueFlowSummaryOfStream);
+      queueFlowSummaryOfStream.close ();
     }
 
   if (g_validationFailed)
     {
       NS_FATAL_ERROR ("Validation failed");
     }
+  if (fingerprint::Failed ())
+    {
+      NS_FATAL_ERROR ("Fingerprint differs from the golden value");
+    }
 }
 
@@ -0,0 +1,595 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+// Hierarchical timer wheel for timers that are restarted much more often
+// than they expire (retransmission, delayed ACK, ACK timeout, ...).
+//
+// Restarting an ns3::Timer cancels its event and inserts a new one; the
+// cancelled event stays in the simulator's event queue until its time is
+// reached.  A WheelTimer instead sits in a slot of a per-thread
+// TimerWheel, and restarting it only moves it to another slot.  The wheel
+// keeps a single simulator event pending, for the next slot holding
+// timers.  When that slot is reached, its timers are handed to the
+// simulator as events at their exact expiry time, so a WheelTimer expires
+// at the same time as an ns3::Timer would.  Only timers that are still
+// running within one slot of their expiry reach the event queue.
+//
+// The wheel has LEVELS levels of SLOTS slots; a level 0 slot spans the
+// resolution (100 us by default), and each higher level slot spans a whole
+// lower level.  Timers beyond the last level are kept in an overflow list.
+
+#include "ns3/simulator.h"
+#include "ns3/event-impl.h"
+#include "ns3/make-event.h"
+#include "ns3/ptr.h"
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <ostream>
+
+namespace ns3 {
+
+class TimerWheel;
+
+namespace timerwheel {
+
+const uint32_t SLOT_BITS = 6;
+const uint32_t SLOTS = 1 << SLOT_BITS;
+const uint64_t SLOT_MASK = SLOTS - 1;
+const uint32_t LEVELS = 4;
+
+} // namespace timerwheel
+
+/**
+ * Restartable timer backed by the TimerWheel of the calling thread.
+ * The timer is cancelled when destroyed.  It expires in the context of
+ * the event that last started it, as an event scheduled by Simulator::Schedule
+ * would.  The wheel links running timers by address, so timers cannot be
+ * copied, and containers of them must not move their elements.
+ */
+class WheelTimer
+{
+public:
+  WheelTimer ();
+  ~WheelTimer ();
+
+  // Delete copy constructor and assignment operator to avoid misuse
+  WheelTimer (const WheelTimer &) = delete;
+  WheelTimer &operator = (const WheelTimer &) = delete;
+
+  /// Set the function called on expiry
+  void SetFunction (Callback<void> function);
+  /// Set the function called on expiry to obj->*memPtr ()
+  template <typename MEM_PTR, typename OBJ_PTR>
+  void SetFunction (MEM_PTR memPtr, OBJ_PTR objPtr)
+  {
+    SetFunction (MakeCallback (memPtr, objPtr));
+  }
+
+  /// Set the delay used by Schedule (void)
+  void SetDelay (const Time &delay);
+  Time GetDelay (void) const;
+
+  /// (Re)start the timer with the delay set by SetDelay
+  void Schedule (void);
+  /// (Re)start the timer, expiring after delay
+  void Schedule (const Time &delay);
+  void Cancel (void);
+
+  bool IsRunning (void) const;
+  bool IsExpired (void) const;
+  Time GetDelayLeft (void) const;
+
+private:
+  friend class TimerWheel;
+
+  enum State
+  {
+    IDLE,
+    IN_WHEEL,       //!< in a wheel slot
+    HANDED_OFF      //!< m_event is pending in the simulator
+  };
+
+  void Expire (void);
+
+  Callback<void> m_function;
+  Time m_delay;
+  State m_state;
+  uint64_t m_expiry;          //!< expiry time [time steps]
+  uint32_t m_context;         //!< context of the last Schedule call
+  WheelTimer **m_slot;        //!< list head of the slot the timer is in
+  WheelTimer *m_prev;
+  WheelTimer *m_next;
+  Ptr<EventImpl> m_event;    //!< expiry event, while HANDED_OFF
+};
+
+class TimerWheel
+{
+public:
+  struct Statistics
+  {
+    uint64_t starts = 0;          //!< Schedule calls
+    uint64_t restarts = 0;        //!< Schedule calls on a running timer
+    uint64_t cancels = 0;         //!< Cancel calls on a running timer
+    uint64_t handOffs = 0;        //!< timers inserted into the event queue
+    uint64_t tickEvents = 0;      //!< wheel events inserted into the event queue
+  };
+
+  /// \returns the wheel of the calling thread
+  static TimerWheel &Get (void);
+
+  /// Set the span of a level 0 slot; only allowed while no timer is running
+  void SetResolution (const Time &resolution);
+  const Statistics &GetStatistics (void) const;
+  void PrintStatistics (std::ostream &os) const;
+
+  void Start (WheelTimer *timer, uint64_t expiry);
+  void Stop (WheelTimer *timer);
+  void Expired (WheelTimer *timer);
+
+private:
+  TimerWheel ();
+
+  void Remove (WheelTimer *timer);
+  void StopAll (WheelTimer **slot);
+
+  void Place (WheelTimer *timer);
+  void HandOff (WheelTimer *timer);
+  void Link (WheelTimer *timer, WheelTimer **slot);
+  void Unlink (WheelTimer *timer);
+  void PlaceAll (WheelTimer **slot);
+  void Advance (uint64_t tick);
+  void Cascade (void);
+  void Tick (void);
+  void ScheduleTick (uint32_t context);
+  void Reset (void);
+  uint64_t NowTick (void) const;
+
+  int64_t m_resolution;                     //!< slot span [time steps]
+  uint64_t m_tick;                          //!< next level 0 slot to process
+  uint64_t m_count;                         //!< timers in the wheel
+  WheelTimer *m_slots[timerwheel::LEVELS][timerwheel::SLOTS];
+  WheelTimer *m_overflow;
+  WheelTimer *m_handedOff;                  //!< timers with an event pending
+  Ptr<EventImpl> m_tickEvent;              //!< pending wheel event, if any
+  uint64_t m_tickEventTick;
+  uint32_t m_tickEventContext;
+  bool m_destroyHooked;
+  Statistics m_stats;
+};
+
+// WheelTimer
+
+inline
+WheelTimer::WheelTimer ()
+  : m_delay (Seconds (0)),
+    m_state (IDLE),
+    m_expiry (0),
+    m_context (0),
+    m_slot (0),
+    m_prev (0),
+    m_next (0)
+{
+}
+
+inline
+WheelTimer::~WheelTimer ()
+{
+  Cancel ();
+}
+
+inline void
+WheelTimer::SetFunction (Callback<void> function)
+{
+  m_function = function;
+}
+
+inline void
+WheelTimer::SetDelay (const Time &delay)
+{
+  m_delay = delay;
+}
+
+inline Time
+WheelTimer::GetDelay (void) const
+{
+  return m_delay;
+}
+
+inline void
+WheelTimer::Schedule (void)
+{
+  Schedule (m_delay);
+}
+
+inline void
+WheelTimer::Schedule (const Time &delay)
+{
+  NS_ASSERT_MSG (!m_function.IsNull (), "WheelTimer: no function set");
+  NS_ASSERT (delay.IsPositive ());
+  m_context = Simulator::GetContext ();
+  TimerWheel::Get ().Start (this, Simulator::Now ().GetTimeStep () + delay.GetTimeStep ());
+}
+
+inline void
+WheelTimer::Cancel (void)
+{
+  if (m_state != IDLE)
+    {
+      TimerWheel::Get ().Stop (this);
+    }
+}
+
+inline bool
+WheelTimer::IsRunning (void) const
+{
+  return m_state != IDLE;
+}
+
+inline bool
+WheelTimer::IsExpired (void) const
+{
+  return m_state == IDLE;
+}
+
+inline Time
+WheelTimer::GetDelayLeft (void) const
+{
+  if (m_state == IDLE)
+    {
+      return Seconds (0);
+    }
+  return TimeStep (m_expiry - Simulator::Now ().GetTimeStep ());
+}
+
+inline void
+WheelTimer::Expire (void)
+{
+  TimerWheel::Get ().Expired (this);
+  m_function ();
+}
+
+// TimerWheel
+
+inline TimerWheel &
+TimerWheel::Get (void)
+{
+  static thread_local TimerWheel wheel;
+  return wheel;
+}
+
+inline
+TimerWheel::TimerWheel ()
+  : m_resolution (MicroSeconds (100).GetTimeStep ()),
+    m_tick (0),
+    m_count (0),
+    m_overflow (0),
+    m_handedOff (0),
+    m_tickEventTick (0),
+    m_tickEventContext (0),
+    m_destroyHooked (false)
+{
+  std::fill (&m_slots[0][0], &m_slots[0][0] + timerwheel::LEVELS * timerwheel::SLOTS,
+             static_cast<WheelTimer *> (0));
+}
+
+inline void
+TimerWheel::SetResolution (const Time &resolution)
+{
+  NS_ABORT_MSG_UNLESS (m_count == 0, "TimerWheel: resolution changed with timers running");
+  NS_ABORT_MSG_UNLESS (resolution.IsStrictlyPositive (), "TimerWheel: resolution must be positive");
+  m_resolution = resolution.GetTimeStep ();
+  m_tick = NowTick ();
+}
+
+inline const TimerWheel::Statistics &
+TimerWheel::GetStatistics (void) const
+{
+  return m_stats;
+}
+
+inline void
+TimerWheel::PrintStatistics (std::ostream &os) const
+{
+  uint64_t inserted = m_stats.handOffs + m_stats.tickEvents;
+  os << "Timer wheel: " << m_stats.starts << " starts (" << m_stats.restarts << " restarts, "
+     << m_stats.cancels << " cancels), " << m_stats.handOffs << " timer events, "
+     << m_stats.tickEvents << " wheel events";
+  if (m_stats.starts > inserted)
+    {
+      os << ", " << m_stats.starts - inserted << " event queue insertions avoided";
+    }
+  os << std::endl;
+}
+
+inline uint64_t
+TimerWheel::NowTick (void) const
+{
+  return Simulator::Now ().GetTimeStep () / m_resolution;
+}
+
+inline void
+TimerWheel::Link (WheelTimer *timer, WheelTimer **slot)
+{
+  timer->m_slot = slot;
+  timer->m_prev = 0;
+  timer->m_next = *slot;
+  if (*slot != 0)
+    {
+      (*slot)->m_prev = timer;
+    }
+  *slot = timer;
+}
+
+inline void
+TimerWheel::Unlink (WheelTimer *timer)
+{
+  if (timer->m_prev != 0)
+    {
+      timer->m_prev->m_next = timer->m_next;
+    }
+  else
+    {
+      *timer->m_slot = timer->m_next;
+    }
+  if (timer->m_next != 0)
+    {
+      timer->m_next->m_prev = timer->m_prev;
+    }
+  timer->m_slot = 0;
+  timer->m_prev = 0;
+  timer->m_next = 0;
+}
+
+inline void
+TimerWheel::HandOff (WheelTimer *timer)
+{
+  timer->m_state = WheelTimer::HANDED_OFF;
+  Link (timer, &m_handedOff);
+  // The simulator owns the reference made by MakeEvent; m_event is kept
+  // to cancel the event
+  timer->m_event = MakeEvent (&WheelTimer::Expire, timer);
+  Simulator::ScheduleWithContext (timer->m_context, TimeStep (timer->m_expiry - Simulator::Now ().GetTimeStep ()),
+                                  PeekPointer (timer->m_event));
+  m_stats.handOffs++;
+}
+
+inline void
+TimerWheel::Place (WheelTimer *timer)
+{
+  using namespace timerwheel;
+  uint64_t e = timer->m_expiry / m_resolution;
+  if (e <= NowTick ())
+    {
+      HandOff (timer);
+      return;
+    }
+  timer->m_state = WheelTimer::IN_WHEEL;
+  m_count++;
+  for (uint32_t level = 0; level < LEVELS; level++)
+    {
+      uint32_t shift = SLOT_BITS * (level + 1);
+      if ((e >> shift) == (m_tick >> shift))
+        {
+          Link (timer, &m_slots[level][(e >> (SLOT_BITS * level)) & SLOT_MASK]);
+          return;
+        }
+    }
+  Link (timer, &m_overflow);
+}
+
+inline void
+TimerWheel::PlaceAll (WheelTimer **slot)
+{
+  WheelTimer *timer = *slot;
+  *slot = 0;
+  while (timer != 0)
+    {
+      WheelTimer *next = timer->m_next;
+      timer->m_slot = 0;
+      timer->m_prev = 0;
+      timer->m_next = 0;
+      m_count--;
+      Place (timer);
+      timer = next;
+    }
+}
+
+inline void
+TimerWheel::Cascade (void)
+{
+  using namespace timerwheel;
+  // m_tick has just entered a new level 0 span: move the timers of the
+  // matching higher level slots down, continuing upwards while the index
+  // of the level wraps around as well
+  for (uint32_t level = 1; level < LEVELS; level++)
+    {
+      uint64_t index = (m_tick >> (SLOT_BITS * level)) & SLOT_MASK;
+      PlaceAll (&m_slots[level][index]);
+      if (index != 0)
+        {
+          return;
+        }
+    }
+  PlaceAll (&m_overflow);
+}
+
+inline void
+TimerWheel::Advance (uint64_t tick)
+{
+  while (m_tick < tick)
+    {
+      m_tick = std::min (tick, (m_tick | timerwheel::SLOT_MASK) + 1);
+      if ((m_tick & timerwheel::SLOT_MASK) == 0)
+        {
+          Cascade ();
+        }
+    }
+}
+
+inline void
+TimerWheel::Tick (void)
+{
+  m_tickEvent = 0;
+  uint64_t tick = m_tickEventTick;
+  if (tick < m_tick)
+    {
+      // Scheduled before the wheel went idle and was moved forward
+      ScheduleTick (m_tickEventContext);
+      return;
+    }
+  // No slot between m_tick and tick holds timers
+  Advance (tick);
+  PlaceAll (&m_slots[0][tick & timerwheel::SLOT_MASK]);
+  Advance (tick + 1);
+  ScheduleTick (m_tickEventContext);
+}
+
+inline void
+TimerWheel::ScheduleTick (uint32_t context)
+{
+  if (m_count == 0)
+    {
+      return;
+    }
+  // The next non-empty level 0 slot, or else the end of the level 0 span,
+  // where the higher levels are cascaded
+  uint64_t next = (m_tick | timerwheel::SLOT_MASK) + 1;
+  for (uint64_t t = m_tick; t < next; t++)
+    {
+      if (m_slots[0][t & timerwheel::SLOT_MASK] != 0)
+        {
+          next = t;
+          break;
+        }
+    }
+  if (m_tickEvent != 0)
+    {
+      if (m_tickEventTick <= next)
+        {
+          return;
+        }
+      m_tickEvent->Cancel ();
+    }
+  if (!m_destroyHooked)
+    {
+      Simulator::ScheduleDestroy (&TimerWheel::Reset, this);
+      m_destroyHooked = true;
+    }
+  int64_t delay = std::max<int64_t> (0, next * m_resolution - Simulator::Now ().GetTimeStep ());
+  m_tickEventTick = next;
+  m_tickEventContext = context;
+  m_tickEvent = MakeEvent (&TimerWheel::Tick, this);
+  Simulator::ScheduleWithContext (context, TimeStep (delay), PeekPointer (m_tickEvent));
+  m_stats.tickEvents++;
+}
+
+inline void
+TimerWheel::Start (WheelTimer *timer, uint64_t expiry)
+{
+  m_stats.starts++;
+  if (timer->m_state != WheelTimer::IDLE)
+    {
+      m_stats.restarts++;
+      Remove (timer);
+    }
+  if (m_count == 0)
+    {
+      // The wheel is empty: skip the slots passed in the meantime
+      m_tick = std::max (m_tick, NowTick ());
+    }
+  timer->m_expiry = expiry;
+  Place (timer);
+  if (timer->m_state == WheelTimer::IN_WHEEL)
+    {
+      ScheduleTick (timer->m_context);
+    }
+}
+
+inline void
+TimerWheel::Stop (WheelTimer *timer)
+{
+  m_stats.cancels++;
+  Remove (timer);
+}
+
+inline void
+TimerWheel::Remove (WheelTimer *timer)
+{
+  if (timer->m_state == WheelTimer::IN_WHEEL)
+    {
+      m_count--;
+    }
+  else if (timer->m_state == WheelTimer::HANDED_OFF)
+    {
+      timer->m_event->Cancel ();
+      timer->m_event = 0;
+    }
+  Unlink (timer);
+  timer->m_state = WheelTimer::IDLE;
+}
+
+inline void
+TimerWheel::Expired (WheelTimer *timer)
+{
+  NS_ASSERT (timer->m_state == WheelTimer::HANDED_OFF);
+  timer->m_event = 0;
+  Unlink (timer);
+  timer->m_state = WheelTimer::IDLE;
+}
+
+inline void
+TimerWheel::StopAll (WheelTimer **slot)
+{
+  while (*slot != 0)
+    {
+      WheelTimer *timer = *slot;
+      Unlink (timer);
+      timer->m_state = WheelTimer::IDLE;
+      timer->m_event = 0;
+    }
+}
+
+inline void
+TimerWheel::Reset (void)
+{
+  // Called by Simulator::Destroy: the timers still running are stopped
+  // and the next simulation starts at tick 0
+  using namespace timerwheel;
+  for (uint32_t level = 0; level < LEVELS; level++)
+    {
+      for (uint32_t i = 0; i < SLOTS; i++)
+        {
+          StopAll (&m_slots[level][i]);
+        }
+    }
+  StopAll (&m_overflow);
+  StopAll (&m_handedOff);
+  m_count = 0;
+  m_tick = 0;
+  m_tickEvent = 0;
+  m_destroyHooked = false;
+}
+
+} // namespace ns3
+
+#endif /* TIMER_WHEEL_H */